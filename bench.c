@@ -0,0 +1,318 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Benchmarks of the update stages and engines over grid sizes from
+ * L1 resident to DRAM bound, written as JSON to stdout. Bandwidth is
+ * computed from the compulsory traffic of each stage (every plane
+ * read or written once per call) and compared to a STREAM triad
+ * measured at startup. Usage: bench [mintime [maxdim]]
+ */
+
+#include "pfolsm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <err.h>
+
+#ifndef PFOLSM_CFLAGS
+# define PFOLSM_CFLAGS "unknown"
+#endif
+
+
+typedef void (*stage_t) (pfolsm_t * pp);
+
+
+static double mintime = 0.2;
+static double ceiling;
+static int first = 1;
+
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+
+/**
+   Best of five STREAM triad runs over arrays well beyond the last
+   level cache, in GB/s. Always optimized, so that the ceiling does
+   not depend on CFLAGS.
+*/
+__attribute__((optimize("O2")))
+static double stream_triad (void)
+{
+  size_t const nn = 1 << 22;
+  double * aa = malloc (nn * sizeof(double));
+  double * bb = malloc (nn * sizeof(double));
+  double * cc = malloc (nn * sizeof(double));
+  double best = 0.0;
+  size_t ii, rep;
+  
+  if (0 == aa || 0 == bb || 0 == cc) {
+    errx (EXIT_FAILURE, "out of memory");
+  }
+  for (ii = 0; ii < nn; ++ii) {
+    aa[ii] = 0.0;
+    bb[ii] = 1.0;
+    cc[ii] = 2.0;
+  }
+  for (rep = 0; rep < 5; ++rep) {
+    double const t0 = now ();
+    double dt;
+    for (ii = 0; ii < nn; ++ii) {
+      aa[ii] = bb[ii] + 3.0 * cc[ii];
+    }
+    dt = now () - t0;
+    if (3.0 * sizeof(double) * nn / dt > best) {
+      best = 3.0 * sizeof(double) * nn / dt;
+    }
+  }
+  if (aa[nn / 2] != 7.0) {
+    errx (EXIT_FAILURE, "STREAM triad is broken");
+  }
+  
+  free (aa);
+  free (bb);
+  free (cc);
+  return 1e-9 * best;
+}
+
+
+static void init (pfolsm_t * pp)
+{
+  double const rr = 0.25 * pp->dimx;
+  size_t ii, jj;
+  for (jj = 1; jj <= pp->dimy; ++jj) {
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      pfolsm_set (pp, ii, jj,
+		  sqrt (pow (ii - 0.5 * pp->dimx, 2.0) + pow (jj - 0.5 * pp->dimy, 2.0)) - rr);
+    }
+  }
+  _pfolsm_cbounds (pp);
+}
+
+
+static void stage_cbounds (pfolsm_t * pp)
+{
+  _pfolsm_cbounds (pp);
+}
+
+
+static void stage_diff (pfolsm_t * pp)
+{
+  _pfolsm_diff (pp);
+}
+
+
+static void stage_nabla (pfolsm_t * pp)
+{
+  _pfolsm_nabla (pp);
+}
+
+
+static void stage_cphinext (pfolsm_t * pp)
+{
+  _pfolsm_cphinext (pp, 0.1);
+}
+
+
+static void stage_update (pfolsm_t * pp)
+{
+  pfolsm_update (pp, 0.1);
+}
+
+
+static void stage_update_cfl (pfolsm_t * pp)
+{
+  pfolsm_update_cfl (pp, 0.1, 0);
+}
+
+
+static void stage_advance_n (pfolsm_t * pp)
+{
+  pfolsm_advance_n (pp, 0.1, 8);
+}
+
+
+/**
+   Time calls of fn, doubling their number until they take mintime,
+   and print the best of three such runs as a JSON object. Bytes is
+   the compulsory traffic per call, and cells the number of cell
+   updates (or visits) per call.
+*/
+static void run (char const * name, pfolsm_t * pp, stage_t fn,
+		 double bytes, double cells)
+{
+  size_t ncall = 1, rep, ii;
+  double best = INFINITY;
+  size_t nthreads = pp->pool ? _pfolsm_pool_size (pp->pool) : 1;
+  
+  for (;;) {
+    double const t0 = now ();
+    for (ii = 0; ii < ncall; ++ii) {
+      fn (pp);
+    }
+    if (now () - t0 >= mintime) {
+      break;
+    }
+    ncall *= 2;
+  }
+  for (rep = 0; rep < 3; ++rep) {
+    double const t0 = now ();
+    double dt;
+    for (ii = 0; ii < ncall; ++ii) {
+      fn (pp);
+    }
+    dt = (now () - t0) / ncall;
+    if (dt < best) {
+      best = dt;
+    }
+  }
+  
+  printf ("%s\n    {\"stage\": \"%s\", \"dimx\": %zu, \"dimy\": %zu, \"threads\": %zu,"
+	  " \"seconds_per_call\": %.6e, \"cells_per_s\": %.6e, \"gbs\": %.3f,"
+	  " \"ceiling_fraction\": %.3f}",
+	  first ? "" : ",", name, pp->dimx, pp->dimy, nthreads,
+	  best, cells / best,
+	  1e-9 * bytes / best, 1e-9 * bytes / best / ceiling);
+  first = 0;
+}
+
+
+static void create (pfolsm_t * pp, size_t dim, unsigned flags)
+{
+  if (0 != pfolsm_create_flags (pp, dim, dim, flags)) {
+    errx (EXIT_FAILURE, "failed to create %zux%zu grid with flags 0x%x", dim, dim, flags);
+  }
+  init (pp);
+}
+
+
+static void bench_size (size_t dim, size_t nthreads)
+{
+  double const cells = (double) dim * dim;
+  double const dd = sizeof(double);
+  double const ff = sizeof(float);
+  pfolsm_t obj;
+  
+  // the stages of the multi-pass debug engine
+  
+  create (&obj, dim, PFOLSM_DEBUG);
+  run ("cbounds", &obj, stage_cbounds, 2 * dd * 4.0 * dim, 4.0 * dim);
+  run ("diff", &obj, stage_diff, 3 * dd * cells, cells);
+  run ("nabla", &obj, stage_nabla, 6 * dd * cells, cells);
+  run ("cphinext", &obj, stage_cphinext, 4 * dd * cells, cells);
+  run ("update_debug", &obj, stage_update, 13 * dd * cells, cells);
+  pfolsm_destroy (&obj);
+  
+  // fused engines
+  
+  create (&obj, dim, 0);
+  run ("update", &obj, stage_update, 3 * dd * cells, cells);
+  run ("update_cfl", &obj, stage_update_cfl, 5 * dd * cells, cells);
+  run ("advance_n", &obj, stage_advance_n, 8 * 3 * dd * cells, 8 * cells);
+  if (nthreads > 1) {
+    if (0 != pfolsm_threads (&obj, nthreads)) {
+      errx (EXIT_FAILURE, "failed to start %zu threads", nthreads);
+    }
+    run ("update", &obj, stage_update, 3 * dd * cells, cells);
+    run ("advance_n", &obj, stage_advance_n, 8 * 3 * dd * cells, 8 * cells);
+  }
+  pfolsm_destroy (&obj);
+  
+  create (&obj, dim, PFOLSM_FLOAT);
+  run ("update_float", &obj, stage_update, 3 * ff * cells, cells);
+  pfolsm_destroy (&obj);
+  
+  create (&obj, dim, PFOLSM_MIXED);
+  run ("update_mixed", &obj, stage_update, 3 * ff * cells, cells);
+  pfolsm_destroy (&obj);
+  
+  create (&obj, dim, PFOLSM_WENO);
+  run ("update_weno", &obj, stage_update, 3 * 4 * dd * cells, cells);
+  pfolsm_destroy (&obj);
+  
+  // the band covers a small part of the grid, so traffic and cells
+  // are counted over the band only
+  
+  create (&obj, dim, 0);
+  if (0 != pfolsm_nband (&obj, 8.0)) {
+    errx (EXIT_FAILURE, "pfolsm_nband failed");
+  }
+  run ("update_nband", &obj, stage_update, 3 * dd * obj.nband->ncell, obj.nband->ncell);
+  pfolsm_destroy (&obj);
+}
+
+
+int main (int argc, char ** argv)
+{
+  static size_t const dims[] = { 32, 128, 512, 2048, 4096 };
+  size_t const ndims = sizeof(dims) / sizeof(*dims);
+  size_t maxdim = 2048;
+  size_t nthreads;
+  size_t ii;
+  long nproc;
+  
+  if (argc > 1) {
+    mintime = atof (argv[1]);
+  }
+  if (argc > 2) {
+    maxdim = strtoul (argv[2], 0, 10);
+  }
+  nproc = sysconf (_SC_NPROCESSORS_ONLN);
+  nthreads = nproc > 1 ? nproc : 1;
+  
+  ceiling = stream_triad ();
+  
+  printf ("{\n  \"cflags\": \"%s\",\n  \"nproc\": %zu,\n  \"mintime\": %g,\n"
+	  "  \"stream_triad_gbs\": %.3f,\n  \"results\": [",
+	  PFOLSM_CFLAGS, nthreads, mintime, ceiling);
+  for (ii = 0; ii < ndims && dims[ii] <= maxdim; ++ii) {
+    bench_size (dims[ii], nthreads);
+    fflush (stdout);
+  }
+  printf ("\n  ]\n}\n");
+  
+  return 0;
+}
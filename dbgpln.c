@@ -35,7 +35,9 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "pfolsm_profile.h"
 #include <gtk/gtk.h>
+#include <stdlib.h>
 #include <err.h>
 #include <math.h>
 #include <string.h>
@@ -148,72 +150,6 @@ static void update_boundaries ()
 }
 
 
-/**
-   C-spline with horizontal tangents between two interpolation points.
-   p0 is the value at x0, p1 is the value at x1, and the function
-   returns the interpolated value at xx.  The caller is responsible
-   for ensuring that x1 > x0.  Also, if xx lies outside that range,
-   you'll probably get useless values.
-*/
-static double hcspline (double p0, double p1, double x0, double x1, double xx)
-{
-  double const tt = (xx - x0) / (x1 - x0);
-  return (2 * tt - 3) * (p0 - p1) * tt * tt + p0;
-}
-
-
-/**
-   Symmetric polar piecewise-cubic interpolation based on hcspline.
-   The caller specifies a table of angles and values.  This function
-   only considers the absolute value of the angle.  For angles smaller
-   than the first atab value, it simply returns the first vtab value.
-   Likewise, if the angle is bigger than the last atab value, the last
-   vtab value is returned.
-   
-   \note Make sure that angle is in the range [-pi,+pi] otherwise
-   you'll probably get just the first or last table value.
-*/
-static double sym_polar_hcspline (double angle,
-			     double * atab,
-			     double * vtab,
-			     int tablen)
-{
-  int ii;
-  if (tablen < 1) {
-    return 0.0;
-  }
-  if (tablen < 2) {
-    return vtab[0];
-  }
-  
-  angle = fabs(angle);
-  if (angle < atab[0]) {
-    return vtab[0];
-  }
-  
-  for (ii = 1; ii < tablen; ++ii) {
-    if (angle <= atab[ii]) {
-      return hcspline(vtab[ii-1], vtab[ii], atab[ii-1], atab[ii], angle);
-    }
-  }
-  
-  return vtab[tablen - 1];
-}
-
-
-static double modangle (double angle)
-{
-  angle = fmod(angle, 2 * M_PI);
-  if (angle > M_PI) {
-    angle -= 2*M_PI;
-  }
-  else if (angle < -M_PI) {
-    angle += 2*M_PI;
-  }
-  return angle;
-}
-
-
 static double max_speed (double gradx, double grady)
 {
   /* gentle "egg" */
@@ -234,38 +170,32 @@ static double max_speed (double gradx, double grady)
   static double vtab_pen[] = {  1.0,        0.0      };
   static int const len_pen = sizeof(atab_pen) / sizeof(atab_pen[0]);
   
-  // first do a stupid brute force approximation, later implement
-  // something smarter like Newton's minimization or maybe we can even
-  // find a closed-form solution (influences choice of velocity
-  // diagram model).
-  double phi;
-  double gradl;
-  double fmax;
-  double alpha;
-  
-  gradl = sqrt(pow(gradx, 2) + pow(grady, 2));
-  if (gradl < 1e-4) {
-    return 0;
-  }
-  gradx /= gradl;
-  grady /= gradl;
-  alpha = atan2(grady, gradx);
-  
-  fmax
-    = sym_polar_hcspline(-M_PI, atab_vel, vtab_vel, len_vel)
-    * gradx
-    * sym_polar_hcspline(alpha + M_PI, atab_pen, vtab_pen, len_pen);
-  for (phi = -M_PI + M_PI/18; phi < M_PI; phi += M_PI/18) {
-    double ff
-      = sym_polar_hcspline(phi, atab_vel, vtab_vel, len_vel)
-      * (cos(phi) * gradx + sin(phi) * grady)
-      * sym_polar_hcspline(alpha - phi, atab_pen, vtab_pen, len_pen);
-    if (ff > fmax) {
-      fmax = ff;
+  // The maximization over headings only depends on the gradient
+  // angle, so compile it into a table once.
+  static pfolsm_profile_t profile;
+  static int have_profile = 0;
+  
+  if ( ! have_profile) {
+    pfolsm_spline_t vel, pen;
+    pfolsm_wulff_t wulff;
+    vel.atab = atab_vel;
+    vel.vtab = vtab_vel;
+    vel.tablen = len_vel;
+    pen.atab = atab_pen;
+    pen.vtab = vtab_pen;
+    pen.tablen = len_pen;
+    wulff.vel = pfolsm_spline_polar;
+    wulff.velarg = &vel;
+    wulff.pen = pfolsm_spline_polar;
+    wulff.penarg = &pen;
+    wulff.nheading = 36;
+    if (0 != pfolsm_profile_create_wulff (&profile, 512, &wulff)) {
+      errx (EXIT_FAILURE, "pfolsm_profile_create_wulff failed");
     }
+    have_profile = 1;
   }
   
-  return fmax;
+  return pfolsm_profile_eval (&profile, gradx, grady);
 }
 
 
@@ -285,18 +215,18 @@ static double simple_speed (double gradx, double grady)
   
   static int const len_vel = sizeof(atab_vel) / sizeof(atab_vel[0]);
   
-  double gradl;
-  double alpha;
+  /* tabulated once, so there is no atan2 or table search per cell */
+  static pfolsm_profile_t profile;
+  static int have_profile = 0;
   
-  gradl = sqrt(pow(gradx, 2) + pow(grady, 2));
-  if (gradl < 1e-4) {
-    return 0;
+  if ( ! have_profile) {
+    if (0 != pfolsm_profile_create_spline (&profile, 256, atab_vel, vtab_vel, len_vel)) {
+      errx (EXIT_FAILURE, "pfolsm_profile_create_spline failed");
+    }
+    have_profile = 1;
   }
-  gradx /= gradl;
-  grady /= gradl;
-  alpha = atan2(grady, gradx);
   
-  return sym_polar_hcspline(alpha, atab_vel, vtab_vel, len_vel);
+  return pfolsm_profile_eval (&profile, gradx, grady);
 }
 
 
@@ -230,7 +230,7 @@ int main (int argc, char ** argv)
   if ( ! lsm) {
     errx (EXIT_FAILURE, "out of memory");
   }
-  if (pfolsm_create (lsm, 40, 60)) {
+  if (pfolsm_create_flags (lsm, 40, 60, PFOLSM_DEBUG)) {
     errx (EXIT_FAILURE, "failed to create LSM");
   }
   init_circle (1.0 + lsm->dimx / 2.0, 1.0 + lsm->dimy / 2.0, lsm->dimx / 4.0, 1.0, 1.0);
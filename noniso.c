@@ -35,7 +35,10 @@
  * OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "pfolsm_profile.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
 #include <math.h>
 
 #define D2R (M_PI / 180.0)
@@ -144,18 +147,18 @@ static double simple_speed (double gradx, double grady)
   
   static int const len_vel = sizeof(atab_vel) / sizeof(atab_vel[0]);
   
-  double gradl;
-  double alpha;
+  /* tabulated once, so there is no atan2 or table search per cell */
+  static pfolsm_profile_t profile;
+  static int have_profile = 0;
   
-  gradl = sqrt(pow(gradx, 2) + pow(grady, 2));
-  if (gradl < 1e-4) {
-    return 0;
+  if ( ! have_profile) {
+    if (0 != pfolsm_profile_create_spline (&profile, 256, atab_vel, vtab_vel, len_vel)) {
+      errx (EXIT_FAILURE, "pfolsm_profile_create_spline failed");
+    }
+    have_profile = 1;
   }
-  gradx /= gradl;
-  grady /= gradl;
-  alpha = atan2(grady, gradx);
   
-  return sym_polar_hcspline(alpha, atab_vel, vtab_vel, len_vel);
+  return pfolsm_profile_eval (&profile, gradx, grady);
 }
 
 
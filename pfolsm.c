@@ -36,82 +36,402 @@
  */
 
 #include "pfolsm.h"
+#include "pfolsm_fmm.h"
+#include "pfolsm_stats.h"
 
 #include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 
 int pfolsm_create (pfolsm_t * pp,
 		   size_t dimx,
 		   size_t dimy)
 {
-  size_t ii;
-  double * dd;
+  return pfolsm_create_flags (pp, dimx, dimy, 0);
+}
+
+
+int pfolsm_create_flags (pfolsm_t * pp,
+			 size_t dimx,
+			 size_t dimy,
+			 unsigned flags)
+{
+  return pfolsm_create_ng (pp, dimx, dimy, flags, (flags & PFOLSM_WENO) ? 3 : 1);
+}
+
+
+size_t _pfolsm_layout (pfolsm_t * pp,
+		       size_t dimx,
+		       size_t dimy,
+		       unsigned flags,
+		       size_t ng)
+{
+  size_t const elsize = (flags & (PFOLSM_FLOAT | PFOLSM_MIXED)) ? sizeof(float) : sizeof(double);
+  size_t const line = PFOLSM_ALIGN / elsize;
+  
+  if (ng < 1) {
+    ng = 1;
+  }
+  if (dimx < ng + 1) {
+    dimx = ng + 1;
+  }
+  if (dimy < ng + 1) {
+    dimy = ng + 1;
+  }
+  
+  pp->dimx  = dimx;
+  pp->dimy  = dimy;
+  pp->ng    = ng;
+  pp->nx    = (dimx + 2 * ng + line - 1) / line * line;
+  pp->ny    = dimy + 2 * ng;
+  
+  // A stride of a multiple of 512 bytes maps the same column of
+  // neighboring rows into a handful of cache sets, and planes a
+  // multiple of 4 KiB apart put the same cell of every plane into
+  // one set. One more cache line per row, or one more row per plane,
+  // spreads them out.
+  
+  if (0 == pp->nx * elsize % 512) {
+    pp->nx += line;
+  }
+  if (0 == pp->nx * pp->ny * elsize % 4096) {
+    ++pp->ny;
+  }
+  pp->ntt   = pp->nx * pp->ny;
+  pp->flags = flags;
+  pp->row   = _pfolsm_row_kernel (_pfolsm_isa_best ());
+  pp->rowf  = 0;
+  pp->rate  = _pfolsm_rate_kernel (_pfolsm_isa_best ());
+  pp->weno  = 0;
+  pp->pool  = 0;
+  pp->nband = 0;
+  pp->speedfn  = 0;
+  pp->speedarg = 0;
+  pp->speedbuf = 0;
+  pp->drift    = 0.0;
+  pp->drift_max = 0.0;
+  pp->reinit_width = 0.0;
+  pp->nreinit  = 0;
+  pp->driftbuf = 0;
+  pp->fmm      = 0;
+  pp->time     = 0.0;
+  pp->dt       = 0.0;
+  pp->database = 0;
+  pp->mapbase  = 0;
+  pp->maplen   = 0;
+  pp->stats    = 0;
+  
+  pp->data    = 0;
+  pp->speed   = 0;
+  pp->phi     = 0;
+  pp->phinext = 0;
+  pp->phistage = 0;
+  pp->diffx   = 0;
+  pp->diffy   = 0;
+  pp->gradx   = 0;
+  pp->grady   = 0;
+  pp->nabla   = 0;
+  pp->fdata   = 0;
+  pp->fspeed  = 0;
+  pp->fphi    = 0;
+  pp->fphinext = 0;
+  
+  // Single and mixed precision store the three planes of the fused
+  // update as floats. There is no multi-pass path for them.
+  
+  if (flags & (PFOLSM_FLOAT | PFOLSM_MIXED)) {
+    if (flags & (PFOLSM_DEBUG | PFOLSM_WENO) || (flags & PFOLSM_FLOAT && flags & PFOLSM_MIXED)) {
+      return 0;
+    }
+    if (flags & PFOLSM_MIXED) {
+      pp->rowf = _pfolsm_rowm_kernel (_pfolsm_isa_best ());
+    }
+    else {
+      pp->rowf = _pfolsm_rowf_kernel (_pfolsm_isa_best ());
+    }
+    return 3;
+  }
+  
+  // The fused update only needs speed, phi, and phinext. The
+  // intermediate planes are only allocated in debug mode, and the
+  // WENO engine needs one more for its second Runge-Kutta stage.
+  
+  if (flags & PFOLSM_DEBUG && flags & PFOLSM_WENO) {
+    return 0;
+  }
+  
+  // The WENO5 stencil reaches three cells past the border.
   
-  if (dimx < 2) {
-    dimx = 2;
+  if (flags & PFOLSM_WENO && ng < 3) {
+    return 0;
   }
-  if (dimy < 2) {
-    dimy = 2;
+  if (flags & PFOLSM_WENO) {
+    pp->weno = _pfolsm_weno_kernel (_pfolsm_isa_best ());
+  }
+  return (flags & PFOLSM_DEBUG) ? 8 : (flags & PFOLSM_WENO) ? 4 : 3;
+}
+
+
+size_t _pfolsm_lead (pfolsm_t const * pp)
+{
+  size_t const elsize = pp->flags & (PFOLSM_FLOAT | PFOLSM_MIXED) ? sizeof(float) : sizeof(double);
+  size_t const line = PFOLSM_ALIGN / elsize;
+  
+  // Cell 1 of row jj is at org + 1 + jj * nx from the start of its
+  // plane, and both nx and ntt are multiples of line.
+  
+  size_t const first = ((pp->ng - 1) * (pp->nx + 1) + 1) % line;
+  return (line - first) % line * elsize;
+}
+
+
+/**
+   Anonymous mapping of at least bytes, aligned to a huge page so
+   that transparent huge pages can back all of it, or on explicit
+   huge pages if asked to and the system has enough of them.
+*/
+static void * map_huge (size_t bytes, int explicit, size_t * len)
+{
+  size_t const hlen = (bytes + PFOLSM_HUGE_PAGE - 1) / PFOLSM_HUGE_PAGE * PFOLSM_HUGE_PAGE;
+  char * mem, * start;
+  
+#ifdef MAP_HUGETLB
+  if (explicit) {
+    mem = mmap (0, hlen, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED != mem) {
+      *len = hlen;
+      return mem;
+    }
   }
+#endif
+  
+  // Map one huge page more than needed and trim both ends.
   
-  pp->dimx = dimx;
-  pp->dimy = dimy;
-  pp->nx   = dimx + 2;
-  pp->ny   = dimy + 2;
-  pp->ntt  = pp->nx * pp->ny;
+  mem = mmap (0, hlen + PFOLSM_HUGE_PAGE, PROT_READ | PROT_WRITE,
+	      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == mem) {
+    return 0;
+  }
+  start = mem + (PFOLSM_HUGE_PAGE - (uintptr_t) mem % PFOLSM_HUGE_PAGE) % PFOLSM_HUGE_PAGE;
+  if (start > mem) {
+    munmap (mem, start - mem);
+  }
+  munmap (start + hlen, mem + PFOLSM_HUGE_PAGE - start);
+#ifdef MADV_HUGEPAGE
+  madvise (start, hlen, MADV_HUGEPAGE);
+#endif
+  *len = hlen;
+  return start;
+}
+
+
+/**
+   Zeroed room for nplanes planes, with pp->data or pp->fdata placed
+   _pfolsm_lead bytes into a PFOLSM_ALIGN boundary. Grids of
+   PFOLSM_HUGE_PAGE or more get a mapping of their own.
+*/
+static int alloc_planes (pfolsm_t * pp, size_t nplanes)
+{
+  size_t const elsize = pp->flags & (PFOLSM_FLOAT | PFOLSM_MIXED) ? sizeof(float) : sizeof(double);
+  size_t const lead = _pfolsm_lead (pp);
+  size_t const bytes = lead + nplanes * pp->ntt * elsize;
+  char * base;
   
-  pp->data = calloc (8 * pp->ntt, sizeof(*(pp->data)));
-  if (0 == pp->data) {
+  if (bytes >= PFOLSM_HUGE_PAGE || (pp->flags & PFOLSM_HUGETLB)) {
+    base = map_huge (bytes, pp->flags & PFOLSM_HUGETLB, &pp->maplen);
+    pp->mapbase = base;
+  }
+  else {
+    void * mem;
+    if (0 != posix_memalign (&mem, PFOLSM_ALIGN, bytes)) {
+      return -1;
+    }
+    memset (mem, 0, bytes);
+    base = mem;
+    pp->database = mem;
+  }
+  if (0 == base) {
     return -1;
   }
-  dd = pp->data;
-  for (ii = 0; ii < 8 * pp->ntt; ++ii) {
-    *(dd++) = NAN;
+  
+  if (sizeof(float) == elsize) {
+    pp->fdata = (float *) (base + lead);
   }
+  else {
+    pp->data = (double *) (base + lead);
+  }
+  return 0;
+}
+
+
+void _pfolsm_planes (pfolsm_t * pp)
+{
+  // Plane pointers are offset so that interior cells keep their
+  // 1-based indices ii + jj * nx with more than one ghost layer.
+  
+  size_t const org = (pp->ng - 1) * (pp->nx + 1);
   
-  pp->speed   = pp->data;
-  pp->phi     = pp->data    + pp->ntt;
+  if (pp->fdata) {
+    pp->fspeed   = pp->fdata + org;
+    pp->fphi     = pp->fspeed + pp->ntt;
+    pp->fphinext = pp->fphi  + pp->ntt;
+    return;
+  }
+  
+  pp->speed   = pp->data    + org;
+  pp->phi     = pp->speed   + pp->ntt;
   pp->phinext = pp->phi     + pp->ntt;
-  pp->diffx   = pp->phinext + pp->ntt;
-  pp->diffy   = pp->diffx   + pp->ntt;
-  pp->gradx   = pp->diffy   + pp->ntt;
-  pp->grady   = pp->gradx   + pp->ntt;
-  pp->nabla   = pp->grady   + pp->ntt;
   
+  if (pp->flags & PFOLSM_WENO) {
+    pp->phistage = pp->phinext + pp->ntt;
+  }
+  
+  if (pp->flags & PFOLSM_DEBUG) {
+    pp->diffx = pp->phinext + pp->ntt;
+    pp->diffy = pp->diffx   + pp->ntt;
+    pp->gradx = pp->diffy   + pp->ntt;
+    pp->grady = pp->gradx   + pp->ntt;
+    pp->nabla = pp->grady   + pp->ntt;
+  }
+}
+
+
+int pfolsm_create_ng (pfolsm_t * pp,
+		      size_t dimx,
+		      size_t dimy,
+		      unsigned flags,
+		      size_t ng)
+{
+  size_t const nplanes = _pfolsm_layout (pp, dimx, dimy, flags, ng);
+  size_t ii;
+  double * dd;
+  float * ff;
+  
+  if (0 == nplanes) {
+    return -1;
+  }
+  
+  if (flags & (PFOLSM_FLOAT | PFOLSM_MIXED)) {
+    if (0 != alloc_planes (pp, nplanes)) {
+      return -1;
+    }
+    ff = pp->fdata;
+    for (ii = 0; ii < pp->ntt; ++ii) {
+      *(ff++) = 1.0f;
+    }
+    for (ii = pp->ntt; ii < nplanes * pp->ntt; ++ii) {
+      *(ff++) = NAN;
+    }
+  }
+  else {
+    if (0 != alloc_planes (pp, nplanes)) {
+      return -1;
+    }
+    dd = pp->data;
+    for (ii = 0; ii < pp->ntt; ++ii) {
+      *(dd++) = 1.0;
+    }
+    for (ii = pp->ntt; ii < nplanes * pp->ntt; ++ii) {
+      *(dd++) = NAN;
+    }
+  }
+  
+  _pfolsm_planes (pp);
   return 0;
 }
 
 
 void pfolsm_destroy (pfolsm_t * pp)
 {
-  free (pp->data);
+  pfolsm_reinit_lazy (pp, 0.0, 0.0);
+  _pfolsm_pool_destroy (pp->pool);
+  _pfolsm_nband_destroy (pp);
+  pfolsm_stats_disable (pp);
+  free (pp->speedbuf);
+  if (pp->mapbase) {
+    munmap (pp->mapbase, pp->maplen);
+  }
+  else {
+    free (pp->database);
+  }
+}
+
+
+double pfolsm_get (pfolsm_t const * pp, size_t ii, size_t jj)
+{
+  if (pp->fphi) {
+    return pp->fphi[ii + jj * pp->nx];
+  }
+  return pp->phi[ii + jj * pp->nx];
+}
+
+
+void pfolsm_set (pfolsm_t * pp, size_t ii, size_t jj, double phi)
+{
+  if (pp->fphi) {
+    pp->fphi[ii + jj * pp->nx] = phi;
+  }
+  else {
+    pp->phi[ii + jj * pp->nx] = phi;
+  }
+}
+
+
+void pfolsm_set_speed (pfolsm_t * pp, size_t ii, size_t jj, double speed)
+{
+  if (pp->fspeed) {
+    pp->fspeed[ii + jj * pp->nx] = speed;
+  }
+  else {
+    pp->speed[ii + jj * pp->nx] = speed;
+  }
 }
 
 
 void _pfolsm_cbounds (pfolsm_t * pp)
+{
+  _pfolsm_cbounds_rows (pp, 1, pp->dimy);
+}
+
+
+static void cbounds_rows_f (pfolsm_t * pp, size_t j0, size_t j1)
 {
   size_t ii;
+  float * dstbl;
+  float * srcbl;
+  float * srctr;
+  float * dsttr;
   
-  // go along bottom and top boundaries
-  
-  double * dstbl = pp->phi + 1;
-  double * srcbl = dstbl + 2 * pp->nx;
-  double * srctr = pp->phi + pp->nx * (pp->dimy - 1) + 1;
-  double * dsttr = srctr + 2 * pp->nx;
+  // go along bottom and top boundaries, if they are in range
   
-  for (ii = 1; ii <= pp->dimx; ++ii) {
-    *(dstbl++) = *(srcbl++);
-    *(dsttr++) = *(srctr++);
+  if (1 == j0) {
+    dstbl = pp->fphi + 1;
+    srcbl = dstbl + 2 * pp->nx;
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      *(dstbl++) = *(srcbl++);
+    }
+  }
+  if (pp->dimy == j1) {
+    srctr = pp->fphi + pp->nx * (pp->dimy - 1) + 1;
+    dsttr = srctr + 2 * pp->nx;
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      *(dsttr++) = *(srctr++);
+    }
   }
   
   // go along left and right boundaries
   
-  dstbl = pp->phi + pp->nx;
+  dstbl = pp->fphi + pp->nx * j0;
   srcbl = dstbl + 2;
   srctr = dstbl + pp->dimx - 1;
   dsttr = srctr + 2;
   
-  for (ii = 1; ii <= pp->dimy; ++ii) {
+  for (ii = j0; ii <= j1; ++ii) {
     *dstbl = *srcbl;
     *dsttr = *srctr;
     dstbl += pp->nx;
@@ -122,6 +442,56 @@ void _pfolsm_cbounds (pfolsm_t * pp)
 }
 
 
+void _pfolsm_cbounds_rows (pfolsm_t * pp, size_t j0, size_t j1)
+{
+  if (pp->fphi) {
+    cbounds_rows_f (pp, j0, j1);
+    return;
+  }
+  _pfolsm_cbounds_plane (pp, pp->phi, j0, j1);
+}
+
+
+void _pfolsm_cbounds_plane (pfolsm_t const * pp, double * plane, size_t j0, size_t j1)
+{
+  ptrdiff_t const nx = pp->nx;
+  ptrdiff_t const ng = pp->ng;
+  ptrdiff_t const dimx = pp->dimx;
+  ptrdiff_t const dimy = pp->dimy;
+  ptrdiff_t ii, jj, kk;
+  
+  // Ghost layer kk mirrors the cell kk cells inside of the border
+  // cell. Go along bottom and top boundaries, if they are in range.
+  
+  for (kk = 1; kk <= ng; ++kk) {
+    if (1 == j0) {
+      double * dst = plane + (1 - kk) * nx;
+      double const * src = plane + (1 + kk) * nx;
+      for (ii = 1; ii <= dimx; ++ii) {
+	dst[ii] = src[ii];
+      }
+    }
+    if (pp->dimy == j1) {
+      double * dst = plane + (dimy + kk) * nx;
+      double const * src = plane + (dimy - kk) * nx;
+      for (ii = 1; ii <= dimx; ++ii) {
+	dst[ii] = src[ii];
+      }
+    }
+  }
+  
+  // go along left and right boundaries
+  
+  for (jj = j0; jj <= (ptrdiff_t) j1; ++jj) {
+    double * row = plane + jj * nx;
+    for (kk = 1; kk <= ng; ++kk) {
+      row[1 - kk] = row[1 + kk];
+      row[dimx + kk] = row[dimx - kk];
+    }
+  }
+}
+
+
 void _pfolsm_diff (pfolsm_t * pp)
 {
   size_t ii, jj;
@@ -142,7 +512,7 @@ void _pfolsm_diff (pfolsm_t * pp)
   for (ii = 1; ii <= pp->dimx; ++ii) {
     double * dm = pp->phi + ii;
     double * dp = dm + pp->nx;
-    double * dst = pp->diffy + ii + 1;
+    double * dst = pp->diffy + ii + pp->nx;
     for (jj = 0; jj <= pp->dimy; ++jj) {
       *dst = *dp - *dm;
       dst += pp->nx;
@@ -166,21 +536,29 @@ void _pfolsm_nabla (pfolsm_t * pp)
 {
   size_t ii, jj;
   
-  // XXXX to do: reformulate with pointer arithmetic for faster
-  // computations.
-  
   for (jj = 1; jj <= pp->dimy; ++jj) {
+    size_t const off = jj * pp->nx + 1;
+    double const * speed = pp->speed + off;
+    double const * dx = pp->diffx + off;
+    double const * dy = pp->diffy + off;
+    double * gx = pp->gradx + off;
+    double * gy = pp->grady + off;
+    double * nn = pp->nabla + off;
     for (ii = 1; ii <= pp->dimx; ++ii) {
-      const size_t idx = ii + jj * pp->nx;
-      if (pp->speed[idx] > 0.0) {
-	pp->gradx[idx] = max3 (pp->diffx[idx], - pp->diffx[idx+1], 0.0);
-	pp->grady[idx] = max3 (pp->diffy[idx], - pp->diffy[idx+pp->nx], 0.0);
+      if (*speed > 0.0) {
+	*gx = max3 (dx[0], - dx[1], 0.0);
+	*gy = max3 (dy[0], - dy[pp->nx], 0.0);
       }
       else {
-	pp->gradx[idx] = max3 ( - pp->diffx[idx], pp->diffx[idx+1], 0.0);
-	pp->grady[idx] = max3 ( - pp->diffy[idx], pp->diffy[idx+pp->nx], 0.0);
+	*gx = max3 ( - dx[0], dx[1], 0.0);
+	*gy = max3 ( - dy[0], dy[pp->nx], 0.0);
       }
-      pp->nabla[idx] = sqrt (pow(pp->gradx[idx], 2.0) + pow(pp->grady[idx], 2.0));
+      *(nn++) = sqrt (*gx * *gx + *gy * *gy);
+      ++speed;
+      ++dx;
+      ++dy;
+      ++gx;
+      ++gy;
     }
   }
 }
@@ -192,98 +570,871 @@ void _pfolsm_cphinext (pfolsm_t * pp, double dt)
   for (jj = 1; jj <= pp->dimy; ++jj) {
     size_t const off = jj * pp->nx + 1;
     double * nn = pp->nabla + off;
+    double * speed = pp->speed + off;
     double * phi = pp->phi + off;
     double * next = pp->phinext + off;
     for (ii = 1; ii <= pp->dimx; ++ii) {
-      *(next++) = *(phi++) - dt * (*(nn++)); // unit speed... should come from outside via function or array
+      *(next++) = *(phi++) - dt * (*(speed++) * *(nn++));
     }
   }
 }
 
 
-void pfolsm_update (pfolsm_t * pp, double dt)
+void _pfolsm_row_scalar (double const * phi,
+			 double const * speed,
+			 double * next,
+			 size_t nn,
+			 size_t stride,
+			 double dt)
 {
-  double * tmp;
+  double const * dn = phi - stride;
+  double const * up = phi + stride;
+  size_t ii;
   
-  _pfolsm_cbounds (pp);
-  _pfolsm_diff (pp);
-  _pfolsm_nabla (pp);
-  _pfolsm_cphinext (pp, dt);
+  // Same arithmetic as _pfolsm_diff, _pfolsm_nabla, and
+  // _pfolsm_cphinext, but the differences never leave registers, so
+  // each cell reads phi and speed once and writes phinext once.
   
-  tmp = pp->phi;
-  pp->phi = pp->phinext;
-  pp->phinext = tmp;
+  for (ii = 0; ii < nn; ++ii) {
+    double const dxm = phi[ii] - phi[ii-1];
+    double const dxp = phi[ii+1] - phi[ii];
+    double const dym = phi[ii] - dn[ii];
+    double const dyp = up[ii] - phi[ii];
+    double gx, gy;
+    if (speed[ii] > 0.0) {
+      gx = max3 (dxm, - dxp, 0.0);
+      gy = max3 (dym, - dyp, 0.0);
+    }
+    else {
+      gx = max3 (- dxm, dxp, 0.0);
+      gy = max3 (- dym, dyp, 0.0);
+    }
+    next[ii] = phi[ii] - dt * (speed[ii] * sqrt (gx * gx + gy * gy));
+  }
+}
+
+
+double _pfolsm_rate_scalar (double const * phi,
+			    double const * speed,
+			    size_t nn,
+			    size_t stride)
+{
+  double const * dn = phi - stride;
+  double const * up = phi + stride;
+  double rmax = 0.0;
+  size_t ii;
+  
+  for (ii = 0; ii < nn; ++ii) {
+    double const dxm = phi[ii] - phi[ii-1];
+    double const dxp = phi[ii+1] - phi[ii];
+    double const dym = phi[ii] - dn[ii];
+    double const dyp = up[ii] - phi[ii];
+    double gx, gy, rr;
+    if (speed[ii] > 0.0) {
+      gx = max3 (dxm, - dxp, 0.0);
+      gy = max3 (dym, - dyp, 0.0);
+    }
+    else {
+      gx = max3 (- dxm, dxp, 0.0);
+      gy = max3 (- dym, dyp, 0.0);
+    }
+    rr = fabs (speed[ii] * sqrt (gx * gx + gy * gy));
+    if (rr > rmax) {
+      rmax = rr;
+    }
+  }
+  return rmax;
+}
+
+
+static float max3f (float aa, float bb, float cc)
+{
+  if (aa > bb) {
+    return aa > cc ? aa : cc;
+  }
+  return bb > cc ? bb : cc;
 }
 
 
-void _pfolsm_pnum5 (FILE * fp, double num)
+void _pfolsm_rowf_scalar (float const * phi,
+			  float const * speed,
+			  float * next,
+			  size_t nn,
+			  size_t stride,
+			  double dt)
 {
-  if (isinf(num)) {
-    fprintf(fp, "  inf");
+  float const * dn = phi - stride;
+  float const * up = phi + stride;
+  float const fdt = dt;
+  size_t ii;
+  
+  for (ii = 0; ii < nn; ++ii) {
+    float const dxm = phi[ii] - phi[ii-1];
+    float const dxp = phi[ii+1] - phi[ii];
+    float const dym = phi[ii] - dn[ii];
+    float const dyp = up[ii] - phi[ii];
+    float gx, gy;
+    if (speed[ii] > 0.0f) {
+      gx = max3f (dxm, - dxp, 0.0f);
+      gy = max3f (dym, - dyp, 0.0f);
+    }
+    else {
+      gx = max3f (- dxm, dxp, 0.0f);
+      gy = max3f (- dym, dyp, 0.0f);
+    }
+    next[ii] = phi[ii] - fdt * (speed[ii] * sqrtf (gx * gx + gy * gy));
   }
-  else if (isnan(num)) {
-    fprintf(fp, "  nan");
+}
+
+
+void _pfolsm_rowm_scalar (float const * phi,
+			  float const * speed,
+			  float * next,
+			  size_t nn,
+			  size_t stride,
+			  double dt)
+{
+  float const * dn = phi - stride;
+  float const * up = phi + stride;
+  size_t ii;
+  
+  // Stored as float, computed as double.
+  
+  for (ii = 0; ii < nn; ++ii) {
+    double const cc = phi[ii];
+    double const dxm = cc - (double) phi[ii-1];
+    double const dxp = (double) phi[ii+1] - cc;
+    double const dym = cc - (double) dn[ii];
+    double const dyp = (double) up[ii] - cc;
+    double gx, gy;
+    if (speed[ii] > 0.0f) {
+      gx = max3 (dxm, - dxp, 0.0);
+      gy = max3 (dym, - dyp, 0.0);
+    }
+    else {
+      gx = max3 (- dxm, dxp, 0.0);
+      gy = max3 (- dym, dyp, 0.0);
+    }
+    next[ii] = cc - dt * ((double) speed[ii] * sqrt (gx * gx + gy * gy));
   }
-  else if (fabs(fmod(num, 1)) < 1e-6) {
-    fprintf(fp, " % 2d  ", (int) rint(num));
+}
+
+
+/**
+   Rate of change of _pfolsm_rowf_scalar, in float arithmetic.
+*/
+static double rate_f (float const * phi, float const * speed, size_t nn, size_t stride)
+{
+  float const * dn = phi - stride;
+  float const * up = phi + stride;
+  float rmax = 0.0f;
+  size_t ii;
+  
+  for (ii = 0; ii < nn; ++ii) {
+    float const dxm = phi[ii] - phi[ii-1];
+    float const dxp = phi[ii+1] - phi[ii];
+    float const dym = phi[ii] - dn[ii];
+    float const dyp = up[ii] - phi[ii];
+    float gx, gy, rr;
+    if (speed[ii] > 0.0f) {
+      gx = max3f (dxm, - dxp, 0.0f);
+      gy = max3f (dym, - dyp, 0.0f);
+    }
+    else {
+      gx = max3f (- dxm, dxp, 0.0f);
+      gy = max3f (- dym, dyp, 0.0f);
+    }
+    rr = fabsf (speed[ii] * sqrtf (gx * gx + gy * gy));
+    if (rr > rmax) {
+      rmax = rr;
+    }
   }
-  else {
-    fprintf(fp, " % 4.1f", num);
+  return rmax;
+}
+
+
+/**
+   Rate of change of _pfolsm_rowm_scalar, in double arithmetic.
+*/
+static double rate_m (float const * phi, float const * speed, size_t nn, size_t stride)
+{
+  float const * dn = phi - stride;
+  float const * up = phi + stride;
+  double rmax = 0.0;
+  size_t ii;
+  
+  for (ii = 0; ii < nn; ++ii) {
+    double const cc = phi[ii];
+    double const dxm = cc - (double) phi[ii-1];
+    double const dxp = (double) phi[ii+1] - cc;
+    double const dym = cc - (double) dn[ii];
+    double const dyp = (double) up[ii] - cc;
+    double gx, gy, rr;
+    if (speed[ii] > 0.0f) {
+      gx = max3 (dxm, - dxp, 0.0);
+      gy = max3 (dym, - dyp, 0.0);
+    }
+    else {
+      gx = max3 (- dxm, dxp, 0.0);
+      gy = max3 (- dym, dyp, 0.0);
+    }
+    rr = fabs ((double) speed[ii] * sqrt (gx * gx + gy * gy));
+    if (rr > rmax) {
+      rmax = rr;
+    }
   }
+  return rmax;
 }
 
 
-void _pfolsm_pnum6 (FILE * fp, double num)
+double _pfolsm_rate_span (pfolsm_t const * pp, size_t idx, size_t nn)
 {
-  if (isinf(num)) {
-    fprintf(fp, "   inf");
+  if (pp->flags & PFOLSM_WENO) {
+    return _pfolsm_weno_rate_span (pp, idx, nn);
   }
-  else if (isnan(num)) {
-    fprintf(fp, "   nan");
+  if (pp->flags & PFOLSM_FLOAT) {
+    return rate_f (pp->fphi + idx, pp->fspeed + idx, nn, pp->nx);
   }
-  else if (fabs(fmod(num, 1)) < 1e-6) {
-    fprintf(fp, " % 3d  ", (int) rint(num));
+  if (pp->flags & PFOLSM_MIXED) {
+    return rate_m (pp->fphi + idx, pp->fspeed + idx, nn, pp->nx);
+  }
+  return pp->rate (pp->phi + idx, pp->speed + idx, nn, pp->nx);
+}
+
+
+void _pfolsm_fused (pfolsm_t * pp, double dt)
+{
+  _pfolsm_fused_rows (pp, 1, pp->dimy, dt, pp->driftbuf);
+}
+
+
+void _pfolsm_speed_span (pfolsm_t * pp, size_t idx, size_t nn, double * scratch)
+{
+  double * gx = scratch;
+  double * gy = scratch + nn;
+  double * speed = scratch + 2 * nn;
+  size_t ii;
+  
+  if (pp->fphi) {
+    for (ii = 0; ii < nn; ++ii) {
+      float const * phi = pp->fphi + idx + ii;
+      gx[ii] = 0.5 * ((double) phi[1] - (double) phi[-1]);
+      gy[ii] = 0.5 * ((double) phi[pp->nx] - (double) phi[- (ptrdiff_t) pp->nx]);
+    }
+    pp->speedfn (pp->speedarg, idx % pp->nx, idx / pp->nx, nn, gx, gy, speed);
+    for (ii = 0; ii < nn; ++ii) {
+      pp->fspeed[idx + ii] = speed[ii];
+    }
+    return;
+  }
+  
+  // The model writes straight into the speed plane.
+  
+  for (ii = 0; ii < nn; ++ii) {
+    double const * phi = pp->phi + idx + ii;
+    gx[ii] = 0.5 * (phi[1] - phi[-1]);
+    gy[ii] = 0.5 * (phi[pp->nx] - phi[- (ptrdiff_t) pp->nx]);
+  }
+  pp->speedfn (pp->speedarg, idx % pp->nx, idx / pp->nx, nn, gx, gy, pp->speed + idx);
+}
+
+
+void _pfolsm_speed_rows (pfolsm_t * pp, size_t j0, size_t j1, double * scratch)
+{
+  size_t jj;
+  for (jj = j0; jj <= j1; ++jj) {
+    _pfolsm_speed_span (pp, 1 + jj * pp->nx, pp->dimx, scratch);
+  }
+}
+
+
+void _pfolsm_fused_rows (pfolsm_t * pp, size_t j0, size_t j1, double dt,
+			 double * drift)
+{
+  size_t jj;
+  for (jj = j0; jj <= j1; ++jj) {
+    size_t const off = jj * pp->nx + 1;
+    if (pp->fphi) {
+      pp->rowf (pp->fphi + off, pp->fspeed + off, pp->fphinext + off, pp->dimx, pp->nx, dt);
+    }
+    else {
+      pp->row (pp->phi + off, pp->speed + off, pp->phinext + off, pp->dimx, pp->nx, dt);
+    }
+    if (drift) {
+      _pfolsm_drift_span (pp, off, pp->dimx, drift);
+    }
+  }
+}
+
+
+/**
+   Upwind nabla of a cell next to the zero level, or -1 for other
+   cells.
+*/
+static double drift_cell (double cc, double xm, double xp, double ym, double yp, double speed)
+{
+  int const pos = cc > 0.0;
+  double gx, gy;
+  
+  if (pos == (xm > 0.0) && pos == (xp > 0.0) && pos == (ym > 0.0) && pos == (yp > 0.0)) {
+    return -1.0;
+  }
+  if (speed > 0.0) {
+    gx = max3 (cc - xm, cc - xp, 0.0);
+    gy = max3 (cc - ym, cc - yp, 0.0);
   }
   else {
-    fprintf(fp, " % 5.1f", num);
+    gx = max3 (xm - cc, xp - cc, 0.0);
+    gy = max3 (ym - cc, yp - cc, 0.0);
   }
+  return sqrt (gx * gx + gy * gy);
 }
 
 
-void _pfolsm_pdata (pfolsm_t * pp,
-		    FILE * fp,
-		    double * dbase,
-		    void (*pfunc)(FILE *, double))
+void _pfolsm_drift_span (pfolsm_t const * pp, size_t idx, size_t nn, double * drift)
 {
-  size_t ii, jj;
-  double * dd;
+  size_t const nx = pp->nx;
+  size_t ii;
+  
+  for (ii = idx; ii < idx + nn; ++ii) {
+    double nabla;
+    if (pp->fphi) {
+      float const * phi = pp->fphi;
+      nabla = drift_cell (phi[ii], phi[ii-1], phi[ii+1], phi[ii-nx], phi[ii+nx], pp->fspeed[ii]);
+    }
+    else {
+      double const * phi = pp->phi;
+      nabla = drift_cell (phi[ii], phi[ii-1], phi[ii+1], phi[ii-nx], phi[ii+nx], pp->speed[ii]);
+    }
+    if (nabla >= 0.0) {
+      drift[0] += fabs (nabla - 1.0);
+      drift[1] += 1.0;
+    }
+  }
+}
+
+
+struct pfolsm_pool_s {
+  pthread_t * thread;
+  size_t nthreads;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  size_t arrived;
+  unsigned long generation;
+  pfolsm_task_t task;
+  void * arg;
+  int quit;
+};
+
+
+static void barrier_wait (pfolsm_pool_t * pool)
+{
+  unsigned long gen;
+  
+  pthread_mutex_lock (&pool->mutex);
+  gen = pool->generation;
+  if (++pool->arrived >= pool->nthreads) {
+    pool->arrived = 0;
+    ++pool->generation;
+    pthread_cond_broadcast (&pool->cond);
+  }
+  else {
+    while (gen == pool->generation) {
+      pthread_cond_wait (&pool->cond, &pool->mutex);
+    }
+  }
+  pthread_mutex_unlock (&pool->mutex);
+}
+
+
+struct worker_s {
+  pfolsm_pool_t * pool;
+  size_t iw;
+};
+
+
+static void * worker (void * arg)
+{
+  pfolsm_pool_t * pool = ((struct worker_s *) arg)->pool;
+  size_t const iw = ((struct worker_s *) arg)->iw;
+  free (arg);
+  
+  for (;;) {
+    barrier_wait (pool);
+    if (pool->quit) {
+      break;
+    }
+    pool->task (pool->arg, iw, pool->nthreads);
+    barrier_wait (pool);
+  }
+  
+  return 0;
+}
+
+
+pfolsm_pool_t * _pfolsm_pool_create (size_t nthreads)
+{
+  pfolsm_pool_t * pool;
+  struct worker_s * ws;
+  size_t ii;
+  
+  if (nthreads < 1) {
+    nthreads = 1;
+  }
+  pool = calloc (1, sizeof(*pool));
+  if (0 == pool) {
+    return 0;
+  }
+  pool->thread = calloc (nthreads, sizeof(*pool->thread));
+  if (0 == pool->thread) {
+    free (pool);
+    return 0;
+  }
+  pthread_mutex_init (&pool->mutex, 0);
+  pthread_cond_init (&pool->cond, 0);
+  
+  // The calling thread acts as worker zero, so only nthreads-1
+  // threads get spawned.
+  
+  pool->nthreads = nthreads;
+  for (ii = 1; ii < nthreads; ++ii) {
+    ws = malloc (sizeof(*ws));
+    if (0 == ws) {
+      break;
+    }
+    ws->pool = pool;
+    ws->iw = ii;
+    if (0 != pthread_create (pool->thread + ii, 0, worker, ws)) {
+      free (ws);
+      break;
+    }
+  }
+  
+  if (ii < nthreads) {
+    // Shrink the barrier to the workers that did start, so that
+    // destroying the pool releases them.
+    pthread_mutex_lock (&pool->mutex);
+    pool->nthreads = ii;
+    pthread_mutex_unlock (&pool->mutex);
+    _pfolsm_pool_destroy (pool);
+    return 0;
+  }
+  
+  return pool;
+}
+
+
+void _pfolsm_pool_run (pfolsm_pool_t * pool,
+		       pfolsm_task_t task,
+		       void * arg)
+{
+  pool->task = task;
+  pool->arg = arg;
+  barrier_wait (pool);
+  task (arg, 0, pool->nthreads);
+  barrier_wait (pool);
+}
+
+
+size_t _pfolsm_pool_size (pfolsm_pool_t const * pool)
+{
+  return pool->nthreads;
+}
+
+
+void _pfolsm_pool_sync (pfolsm_pool_t * pool)
+{
+  barrier_wait (pool);
+}
+
+
+void _pfolsm_pool_destroy (pfolsm_pool_t * pool)
+{
+  size_t ii;
+  
+  if (0 == pool) {
+    return;
+  }
+  pool->quit = 1;
+  barrier_wait (pool);
+  for (ii = 1; ii < pool->nthreads; ++ii) {
+    pthread_join (pool->thread[ii], 0);
+  }
+  pthread_cond_destroy (&pool->cond);
+  pthread_mutex_destroy (&pool->mutex);
+  free (pool->thread);
+  free (pool);
+}
+
+
+void _pfolsm_split (size_t nn, size_t iw, size_t nw, size_t * i0, size_t * i1)
+{
+  *i0 = 1 + nn * iw / nw;
+  *i1 = nn * (iw + 1) / nw;
+}
+
+
+struct update_s {
+  pfolsm_t * pp;
+  double dt;
+  int prepared;
+  double * rate;		/* one per thread */
+};
+
+
+/**
+   Ghost cells and speeds of rows j0 to j1, as seen by thread iw.
+*/
+static void prepare_rows (pfolsm_t * pp, size_t j0, size_t j1, size_t iw)
+{
+  PFOLSM_STATS_BEGIN (cb);
+  _pfolsm_cbounds_rows (pp, j0, j1);
+  PFOLSM_STATS_END (pp, cb, PFOLSM_STAGE_CBOUNDS, iw, 2 * (j1 - j0 + 1));
+  if (pp->speedfn) {
+    PFOLSM_STATS_BEGIN (sp);
+    _pfolsm_speed_rows (pp, j0, j1, pp->speedbuf + 3 * pp->dimx * iw);
+    PFOLSM_STATS_END (pp, sp, PFOLSM_STAGE_SPEED, iw, (j1 - j0 + 1) * pp->dimx);
+  }
+}
+
+
+static void update_band (void * arg, size_t iw, size_t nw)
+{
+  struct update_s const * up = arg;
+  pfolsm_t * pp = up->pp;
+  size_t j0, j1;
+  
+  // Each band only reads the ghost cells of its own rows, plus the
+  // bottom or top ghost row if it owns the first or last row, so it
+  // can fill them in itself without waiting for the other bands.
+  
+  _pfolsm_split (pp->dimy, iw, nw, &j0, &j1);
+  if (j0 > j1) {
+    return;
+  }
+  if ( ! up->prepared) {
+    prepare_rows (pp, j0, j1, iw);
+  }
+  PFOLSM_STATS_BEGIN (fu);
+  _pfolsm_fused_rows (pp, j0, j1, up->dt, pp->driftbuf ? pp->driftbuf + 2 * iw : 0);
+  PFOLSM_STATS_END (pp, fu, PFOLSM_STAGE_FUSED, iw, (j1 - j0 + 1) * pp->dimx);
+}
+
+
+static void rate_band (void * arg, size_t iw, size_t nw)
+{
+  struct update_s const * up = arg;
+  pfolsm_t * pp = up->pp;
+  size_t j0, j1, jj;
+  
+  up->rate[iw] = 0.0;
+  _pfolsm_split (pp->dimy, iw, nw, &j0, &j1);
+  if (j0 <= j1) {
+    prepare_rows (pp, j0, j1, iw);
+  }
+  
+  // The WENO stencil reaches three rows into the neighboring bands,
+  // whose ghost cells have to be filled first.
   
-  for (jj = pp->dimy + 1; jj <= pp->dimy + 1 /* until overflow */; --jj) {
-    dd = dbase + pp->nx * jj;
-    for (ii = 0; ii < pp->nx; ++ii) {
-      pfunc (fp, *(dd++));
+  if (pp->flags & PFOLSM_WENO && nw > 1) {
+    _pfolsm_pool_sync (pp->pool);
+  }
+  if (j0 > j1) {
+    return;
+  }
+  PFOLSM_STATS_BEGIN (ra);
+  for (jj = j0; jj <= j1; ++jj) {
+    double const rr = _pfolsm_rate_span (pp, 1 + jj * pp->nx, pp->dimx);
+    if (rr > up->rate[iw]) {
+      up->rate[iw] = rr;
     }
-    fprintf (fp, "\n");
   }
+  PFOLSM_STATS_END (pp, ra, PFOLSM_STAGE_RATE, iw, (j1 - j0 + 1) * pp->dimx);
+}
+
+
+/**
+   One set of speed model buffers per thread of the pool.
+*/
+static int alloc_speedbuf (pfolsm_t * pp)
+{
+  size_t const nw = pp->pool ? _pfolsm_pool_size (pp->pool) : 1;
+  free (pp->speedbuf);
+  pp->speedbuf = 0;
+  if (0 == pp->speedfn) {
+    return 0;
+  }
+  pp->speedbuf = malloc (3 * pp->dimx * nw * sizeof(double));
+  if (0 == pp->speedbuf) {
+    return -1;
+  }
+  return 0;
+}
+
+
+/**
+   Drift sum and count per thread of the pool.
+*/
+static int alloc_driftbuf (pfolsm_t * pp)
+{
+  size_t const nw = pp->pool ? _pfolsm_pool_size (pp->pool) : 1;
+  free (pp->driftbuf);
+  pp->driftbuf = 0;
+  if (pp->drift_max <= 0.0) {
+    return 0;
+  }
+  pp->driftbuf = calloc (2 * nw, sizeof(double));
+  if (0 == pp->driftbuf) {
+    return -1;
+  }
+  return 0;
 }
 
 
-void pfolsm_dump (pfolsm_t * pp,
-		  FILE * fp)
+int pfolsm_threads (pfolsm_t * pp, size_t nthreads)
 {
-  fprintf (fp, "==================================================\n");
-  fprintf (fp, "phi\n");
-  _pfolsm_pdata (pp, fp, pp->phi, _pfolsm_pnum6);
+  _pfolsm_pool_destroy (pp->pool);
+  pp->pool = 0;
+  if (nthreads >= 2) {
+    pp->pool = _pfolsm_pool_create (nthreads);
+    if (0 == pp->pool) {
+      return -1;
+    }
+  }
+  if (0 != alloc_driftbuf (pp)) {
+    return -1;
+  }
+  if (pp->stats && 0 != pfolsm_stats_enable (pp, pp->stats->tracecap)) {
+    return -1;
+  }
+  return alloc_speedbuf (pp);
+}
+
+
+int pfolsm_speed_fn (pfolsm_t * pp, pfolsm_speedfn_t fn, void * arg)
+{
+  pp->speedfn = fn;
+  pp->speedarg = arg;
+  if (0 != alloc_speedbuf (pp)) {
+    pp->speedfn = 0;
+    return -1;
+  }
+  return 0;
+}
+
+
+/**
+   Ghost cells and speeds of the cells that advance() is going to
+   update, unless a pool takes care of them.
+*/
+static void prepare (pfolsm_t * pp)
+{
+  PFOLSM_STATS_BEGIN (cb);
+  _pfolsm_cbounds (pp);
+  PFOLSM_STATS_END (pp, cb, PFOLSM_STAGE_CBOUNDS, 0, 2 * (pp->dimx + pp->dimy));
+  if (pp->speedfn) {
+    PFOLSM_STATS_BEGIN (sp);
+    if (pp->nband && ! (pp->flags & PFOLSM_DEBUG)) {
+      _pfolsm_nband_speed (pp);
+      PFOLSM_STATS_END (pp, sp, PFOLSM_STAGE_SPEED, 0, pp->nband->ncell);
+    }
+    else {
+      _pfolsm_speed_rows (pp, 1, pp->dimy, pp->speedbuf);
+      PFOLSM_STATS_END (pp, sp, PFOLSM_STAGE_SPEED, 0, pp->dimx * pp->dimy);
+    }
+  }
+}
+
+
+/**
+   Redistance phi for pfolsm_reinit_lazy.
+*/
+static int reinit (pfolsm_t * pp)
+{
+  int status;
+  PFOLSM_STATS_BEGIN (re);
+  status = pfolsm_fmm_reinit (pp->fmm, pp, pp->reinit_width);
+  PFOLSM_STATS_END (pp, re, PFOLSM_STAGE_REINIT, 0, pp->dimx * pp->dimy);
+  return status;
+}
+
+
+static void advance (pfolsm_t * pp, double dt, int prepared)
+{
+  size_t const nw = pp->pool ? _pfolsm_pool_size (pp->pool) : 1;
+  double * tmp;
+  size_t iw;
+  PFOLSM_STATS_BEGIN (total);
+  
+  if (pp->driftbuf) {
+    memset (pp->driftbuf, 0, 2 * nw * sizeof(double));
+  }
+  
+  if (pp->flags & PFOLSM_DEBUG) {
+    if ( ! prepared) {
+      prepare (pp);
+    }
+    PFOLSM_STATS_BEGIN (df);
+    _pfolsm_diff (pp);
+    PFOLSM_STATS_END (pp, df, PFOLSM_STAGE_DIFF, 0, pp->dimx * pp->dimy);
+    PFOLSM_STATS_BEGIN (na);
+    _pfolsm_nabla (pp);
+    PFOLSM_STATS_END (pp, na, PFOLSM_STAGE_NABLA, 0, pp->dimx * pp->dimy);
+    PFOLSM_STATS_BEGIN (cp);
+    _pfolsm_cphinext (pp, dt);
+    PFOLSM_STATS_END (pp, cp, PFOLSM_STAGE_CPHINEXT, 0, pp->dimx * pp->dimy);
+    if (pp->driftbuf) {
+      for (iw = 1; iw <= pp->dimy; ++iw) {
+	_pfolsm_drift_span (pp, 1 + iw * pp->nx, pp->dimx, pp->driftbuf);
+      }
+    }
+  }
+  else if (pp->flags & PFOLSM_WENO) {
+    PFOLSM_STATS_BEGIN (we);
+    _pfolsm_weno_update (pp, dt, prepared);
+    PFOLSM_STATS_END (pp, we, PFOLSM_STAGE_WENO, 0, pp->dimx * pp->dimy);
+  }
+  else if (pp->nband) {
+    if ( ! prepared) {
+      prepare (pp);
+    }
+    PFOLSM_STATS_BEGIN (nb);
+    _pfolsm_nband_fused (pp, dt);
+    PFOLSM_STATS_END (pp, nb, PFOLSM_STAGE_NBAND, 0, pp->nband->ncell);
+  }
+  else if (pp->pool) {
+    struct update_s arg;
+    arg.pp = pp;
+    arg.dt = dt;
+    arg.prepared = prepared;
+    arg.rate = 0;
+    PFOLSM_STATS_FORK (pp);
+    _pfolsm_pool_run (pp->pool, update_band, &arg);
+    PFOLSM_STATS_PARALLEL (pp);
+  }
+  else {
+    if ( ! prepared) {
+      prepare (pp);
+    }
+    PFOLSM_STATS_BEGIN (fu);
+    _pfolsm_fused (pp, dt);
+    PFOLSM_STATS_END (pp, fu, PFOLSM_STAGE_FUSED, 0, pp->dimx * pp->dimy);
+  }
+  
+  tmp = pp->phi;
+  pp->phi = pp->phinext;
+  pp->phinext = tmp;
+  
+  if (pp->fphi) {
+    float * ftmp = pp->fphi;
+    pp->fphi = pp->fphinext;
+    pp->fphinext = ftmp;
+  }
   
-  fprintf (fp, "--------------------------------------------------\n");
-  fprintf (fp, "diffx\n");
-  _pfolsm_pdata (pp, fp, pp->diffx, _pfolsm_pnum6);
+  pp->time += dt;
+  pp->dt = dt;
   
-  fprintf (fp, "--------------------------------------------------\n");
-  fprintf (fp, "diffy\n");
-  _pfolsm_pdata (pp, fp, pp->diffy, _pfolsm_pnum6);
+  if (pp->driftbuf) {
+    double sum = 0.0, count = 0.0;
+    for (iw = 0; iw < nw; ++iw) {
+      sum += pp->driftbuf[2 * iw];
+      count += pp->driftbuf[2 * iw + 1];
+    }
+    pp->drift = count > 0.0 ? sum / count : 0.0;
+    if (pp->drift > pp->drift_max && 0 == reinit (pp)) {
+      ++pp->nreinit;
+      if (pp->nband) {
+	_pfolsm_nband_build (pp);
+	PFOLSM_STATS_END (pp, total, PFOLSM_STAGE_UPDATE, 0, pp->dimx * pp->dimy);
+	return;
+      }
+    }
+  }
   
-  fprintf (fp, "--------------------------------------------------\n");
-  fprintf (fp, "nabla\n");
-  _pfolsm_pdata (pp, fp, pp->nabla, _pfolsm_pnum6);
+  if (pp->nband) {
+    _pfolsm_nband_check (pp);
+  }
+  PFOLSM_STATS_END (pp, total, PFOLSM_STAGE_UPDATE, 0, pp->dimx * pp->dimy);
+}
+
+
+void pfolsm_update (pfolsm_t * pp, double dt)
+{
+  advance (pp, dt, 0);
+}
+
+
+int pfolsm_update_cfl (pfolsm_t * pp, double cfl, double * dt_out)
+{
+  double rmax = 0.0;
+  double dt;
+  size_t jj;
+  
+  if (pp->pool && ! pp->nband && ! (pp->flags & PFOLSM_DEBUG)) {
+    size_t const nw = _pfolsm_pool_size (pp->pool);
+    struct update_s arg;
+    arg.pp = pp;
+    arg.dt = 0.0;
+    arg.prepared = 1;
+    arg.rate = malloc (nw * sizeof(double));
+    if (0 == arg.rate) {
+      return -1;
+    }
+    _pfolsm_pool_run (pp->pool, rate_band, &arg);
+    for (jj = 0; jj < nw; ++jj) {
+      if (arg.rate[jj] > rmax) {
+	rmax = arg.rate[jj];
+      }
+    }
+    free (arg.rate);
+  }
+  else {
+    prepare (pp);
+    if (pp->nband) {
+      rmax = _pfolsm_nband_rate (pp);
+    }
+    else {
+      for (jj = 1; jj <= pp->dimy; ++jj) {
+	double const rr = _pfolsm_rate_span (pp, 1 + jj * pp->nx, pp->dimx);
+	if (rr > rmax) {
+	  rmax = rr;
+	}
+      }
+    }
+  }
+  
+  dt = rmax > 0.0 ? cfl / rmax : cfl;
+  advance (pp, dt, 1);
+  if (dt_out) {
+    *dt_out = dt;
+  }
+  return 0;
+}
+
+
+int pfolsm_reinit_lazy (pfolsm_t * pp, double threshold, double width)
+{
+  if (pp->fmm) {
+    pfolsm_fmm_destroy (pp->fmm);
+    free (pp->fmm);
+    pp->fmm = 0;
+  }
+  pp->drift = 0.0;
+  pp->drift_max = threshold > 0.0 ? threshold : 0.0;
+  pp->reinit_width = width;
+  if (0 != alloc_driftbuf (pp)) {
+    pp->drift_max = 0.0;
+    return -1;
+  }
+  if (pp->drift_max <= 0.0) {
+    return 0;
+  }
+  pp->fmm = malloc (sizeof(*pp->fmm));
+  if (0 == pp->fmm || 0 != pfolsm_fmm_create (pp->fmm, pp)) {
+    free (pp->fmm);
+    pp->fmm = 0;
+    pfolsm_reinit_lazy (pp, 0.0, 0.0);
+    return -1;
+  }
+  return 0;
 }
@@ -42,19 +42,148 @@
 #include <stdio.h>
 
 
+#define PFOLSM_DEBUG 0x01	/* multi-pass update, fills diffx..nabla */
+#define PFOLSM_FLOAT 0x02	/* float planes, float arithmetic */
+#define PFOLSM_MIXED 0x04	/* float planes, double arithmetic */
+#define PFOLSM_WENO  0x08	/* WENO5 in space, TVD-RK3 in time */
+#define PFOLSM_HUGETLB 0x10	/* explicit huge pages, if the system has any */
+
+/** The first interior cell of every row starts on this many bytes. */
+#define PFOLSM_ALIGN 64
+
+/** Planes of this many bytes or more get mapped on huge pages. */
+#define PFOLSM_HUGE_PAGE (2 * 1024 * 1024)
+
+#define PFOLSM_ISA_SCALAR 0
+#define PFOLSM_ISA_SSE2   1
+#define PFOLSM_ISA_AVX2   2
+#define PFOLSM_ISA_AVX512 3
+#define PFOLSM_NISA       4
+
+
+/**
+   Fused update of nn consecutive cells: reads phi[-1..nn] and the
+   rows at +/- stride, writes next[0..nn-1].
+*/
+typedef void (*pfolsm_row_t) (double const * phi,
+			      double const * speed,
+			      double * next,
+			      size_t nn,
+			      size_t stride,
+			      double dt);
+
+/** Same as pfolsm_row_t, for the float planes. */
+typedef void (*pfolsm_rowf_t) (float const * phi,
+			       float const * speed,
+			       float * next,
+			       size_t nn,
+			       size_t stride,
+			       double dt);
+
+/**
+   Largest |speed| * nabla over nn consecutive cells, computed exactly
+   as in pfolsm_row_t. Used to pick a stable time step.
+*/
+typedef double (*pfolsm_rate_t) (double const * phi,
+				 double const * speed,
+				 size_t nn,
+				 size_t stride);
+
+/**
+   One Runge-Kutta stage of the WENO engine on nn consecutive cells:
+   dst = aa * base + bb * (src - dt * speed * |grad src|), with the
+   gradient from fifth order WENO differences, which read src at up
+   to 3 cells or rows away.
+*/
+typedef void (*pfolsm_weno_t) (double const * src,
+			       double const * base,
+			       double const * speed,
+			       double * dst,
+			       size_t nn,
+			       size_t stride,
+			       double dt,
+			       double aa,
+			       double bb);
+
+typedef struct pfolsm_pool_s pfolsm_pool_t;
+
+struct pfolsm_fmm_s;
+
+/** Work item run by every thread of a pool; iw is in [0, nw). */
+typedef void (*pfolsm_task_t) (void * arg, size_t iw, size_t nw);
+
+/**
+   Row-batched speed model, see pfolsm_speed_fn(). Writes the speeds
+   of the nn cells (i0, jj) ... (i0+nn-1, jj) into speed[0..nn-1],
+   given the central difference gradient (gx, gy) of phi there.
+*/
+typedef void (*pfolsm_speedfn_t) (void * arg, size_t i0, size_t jj, size_t nn,
+				  double const * gx, double const * gy,
+				  double * speed);
+
+/**
+   Narrow band bookkeeping, see pfolsm_nband(). Cells are given as
+   offsets into the planes.
+*/
+struct pfolsm_nband_s {
+  size_t radius;		/* band half width, in cells */
+  unsigned char * dist;		/* per cell distance to the front, or marker */
+  size_t * cell;		/* active cells, sorted */
+  size_t ncell, cellcap;
+  size_t * next;		/* scratch list for rebuilding */
+  size_t nextcap;
+  size_t * span;		/* (offset, length) runs of active cells */
+  size_t nspan, spancap;
+  size_t * edge;		/* active cells near the outside of the band */
+  size_t nedge, edgecap;
+  size_t nbuild;		/* how many times the band was (re)built */
+};
+
+typedef struct pfolsm_nband_s pfolsm_nband_t;
+
 struct pfolsm_s {
   double * speed;
   double * phi;
   double * phinext;
+  double * phistage;		/* second Runge-Kutta stage, PFOLSM_WENO only */
   double * diffx;
   double * diffy;
   double * gradx;
   double * grady;
   double * nabla;
   double * data;
+  float * fspeed;		/* PFOLSM_FLOAT and PFOLSM_MIXED use these */
+  float * fphi;			/* planes instead of the double ones, */
+  float * fphinext;		/* which are then left at zero */
+  float * fdata;
   size_t dimx;
   size_t dimy;
-  size_t nx, ny, ntt;
+  size_t ng;			/* number of ghost layers */
+  size_t nx;			/* row stride, at least dimx + 2 ng, padded */
+  size_t ny;			/* rows per plane, at least dimy + 2 ng */
+  size_t ntt;			/* nx * ny entries per plane */
+  unsigned flags;
+  pfolsm_row_t row;
+  pfolsm_rowf_t rowf;
+  pfolsm_rate_t rate;
+  pfolsm_weno_t weno;
+  pfolsm_pool_t * pool;
+  pfolsm_nband_t * nband;
+  pfolsm_speedfn_t speedfn;
+  void * speedarg;
+  double * speedbuf;		/* 3 * dimx per thread, for speedfn */
+  double drift;			/* mean |nabla - 1| at the front, last update */
+  double drift_max;		/* reinitialize above this, 0 to never */
+  double reinit_width;
+  size_t nreinit;
+  double * driftbuf;		/* sum and count per thread */
+  struct pfolsm_fmm_s * fmm;
+  double time;			/* sum of all dt so far */
+  double dt;			/* of the last update */
+  void * database;		/* allocation that holds the planes, or */
+  void * mapbase;		/* mapping that does, see pfolsm_ckpt_load */
+  size_t maplen;
+  struct pfolsm_stats_s * stats; /* see pfolsm_stats.h */
 };
 
 typedef struct pfolsm_s pfolsm_t;
@@ -64,22 +193,299 @@ int pfolsm_create (pfolsm_t * pp,
 		   size_t dimx,
 		   size_t dimy);
 
+int pfolsm_create_flags (pfolsm_t * pp,
+			 size_t dimx,
+			 size_t dimy,
+			 unsigned flags);
+
+/**
+   Same as pfolsm_create_flags, with ng layers of ghost cells instead
+   of the minimum that the chosen engine needs. Interior cells are
+   still addressed as ii + jj * nx with 1-based ii and jj, ghost cells
+   at 1-ng to 0 and dim+1 to dim+ng. Both dimensions are at least
+   ng+1. The rows are padded to whole cache lines, and a bit more
+   where the stride would be a multiple of 512 bytes, so nx can be
+   larger than dimx + 2 ng. Fails for fewer ghost layers than the
+   engine needs, which is 3 for PFOLSM_WENO and 1 otherwise.
+*/
+int pfolsm_create_ng (pfolsm_t * pp,
+		      size_t dimx,
+		      size_t dimy,
+		      unsigned flags,
+		      size_t ng);
+
 void pfolsm_destroy (pfolsm_t * pp);
 
+/**
+   Access phi and speed at a cell regardless of the precision chosen
+   at creation. Interior cells are 1-based, ghost cells are at 0 and
+   dim+1. Speeds start out at 1. The front moves along the outward
+   normal of the phi < 0 region where the speed is positive, and
+   against it where the speed is negative.
+*/
+double pfolsm_get (pfolsm_t const * pp, size_t ii, size_t jj);
+
+void pfolsm_set (pfolsm_t * pp, size_t ii, size_t jj, double phi);
+
+void pfolsm_set_speed (pfolsm_t * pp, size_t ii, size_t jj, double speed);
+
+/**
+   Start a persistent pool of nthreads threads (including the caller)
+   which pfolsm_update uses to process interior rows in bands. Results
+   are identical to the serial update. Passing 0 or 1 stops the pool.
+*/
+int pfolsm_threads (pfolsm_t * pp, size_t nthreads);
+
+/**
+   Switch to narrow band mode, where pfolsm_update only touches cells
+   within width (4 to 126) cells of the zero level of phi, and
+   rebuilds the band when the front gets within two cells of its
+   edge. Cells outside the band are never updated, so phi there keeps
+   its initial value. Call this again after modifying phi from the
+   outside. Passing width <= 0 goes back to updating all cells. Only
+   available with the first order double precision engine.
+*/
+int pfolsm_nband (pfolsm_t * pp, double width);
+
+/**
+   Have pfolsm_update ask fn for the speed of each row just before
+   advancing it, instead of using the speeds set with
+   pfolsm_set_speed. Passing a null fn switches back to those.
+*/
+int pfolsm_speed_fn (pfolsm_t * pp, pfolsm_speedfn_t fn, void * arg);
+
 void pfolsm_update (pfolsm_t * pp, double dt);
 
+/**
+   Same as pfolsm_update, but with the largest dt for which phi
+   changes by at most cfl anywhere, which is returned in dt_out
+   unless that is null. The rate of change is found in a read-only
+   pass right before the update, so the result is identical to
+   calling pfolsm_update with that dt. If phi does not change at all,
+   dt is cfl. The WENO engine takes its rate from the WENO gradient
+   of phi, which bounds the change of the first Runge-Kutta stage;
+   the later stages can change phi by a little more.
+*/
+int pfolsm_update_cfl (pfolsm_t * pp, double cfl, double * dt_out);
+
+/**
+   Monitor how far phi is from a signed distance function and
+   reinitialize it with pfolsm_fmm_reinit (with the given width) only
+   once that gets bad. The measure is the mean of |nabla - 1| over the
+   cells next to the zero level, computed row by row right after the
+   update kernel while the row is still in cache, and kept in
+   pp->drift. Reinitialization happens after an update that finds a
+   drift above threshold, and is counted in pp->nreinit. Passing
+   threshold <= 0 switches this off.
+*/
+int pfolsm_reinit_lazy (pfolsm_t * pp, double threshold, double width);
+
+/**
+   Equivalent to nsteps calls of pfolsm_update (pp, dt) as far as the
+   interior of phi is concerned, but advances several steps per cache
+   sized tile, which reduces memory traffic accordingly. Afterwards,
+   phinext and the ghost cells hold no meaningful state. Falls back
+   to calling pfolsm_update in debug, float, WENO, and narrow band
+   modes, with a speed model, and with lazy reinitialization.
+*/
+int pfolsm_advance_n (pfolsm_t * pp, double dt, size_t nsteps);
+
 void pfolsm_dump (pfolsm_t * pp,
 		  FILE * fp);
 
+/** Layout of pfolsm_dump, ghost cells included, top row first. */
+#define PFOLSM_DUMP_TEXT    0
+/** Interior only, bottom row first, for gnuplot's matrix mode. */
+#define PFOLSM_DUMP_GNUPLOT 1
+/** Interior only, bottom row first, comma separated. */
+#define PFOLSM_DUMP_CSV     2
+
+/**
+   Write phi in one of the PFOLSM_DUMP_xxx formats, with prec digits
+   after the decimal point for the gnuplot and CSV formats. Rows are
+   formatted into a large buffer that goes out in chunks. Returns -1
+   if writing fails.
+*/
+int pfolsm_dump_phi (pfolsm_t const * pp,
+		     FILE * fp,
+		     int format,
+		     int prec);
+
+
+/**
+   Set all fields of pp to their defaults for the given size, without
+   allocating planes. Returns how many planes of ntt entries the
+   flags need, or 0 if they are not a valid combination.
+*/
+size_t _pfolsm_layout (pfolsm_t * pp,
+		       size_t dimx,
+		       size_t dimy,
+		       unsigned flags,
+		       size_t ng);
+
+/**
+   Bytes to put in front of pp->data or pp->fdata so that the first
+   interior cell of each row lands on PFOLSM_ALIGN, given that the
+   planes start on PFOLSM_ALIGN themselves.
+*/
+size_t _pfolsm_lead (pfolsm_t const * pp);
+
+/**
+   Point the planes into pp->data, or pp->fdata if that is set, in the
+   order speed, phi, phinext, and then the planes of the engine.
+*/
+void _pfolsm_planes (pfolsm_t * pp);
 
 void _pfolsm_cbounds (pfolsm_t * pp);
 
+void _pfolsm_cbounds_rows (pfolsm_t * pp, size_t j0, size_t j1);
+
+/**
+   Fill all ghost layers of a plane of pp along rows j0 to j1, plus
+   the bottom or top ghost rows if j0 is 1 or j1 is dimy.
+*/
+void _pfolsm_cbounds_plane (pfolsm_t const * pp, double * plane, size_t j0, size_t j1);
+
 void _pfolsm_diff (pfolsm_t * pp);
 
 void _pfolsm_nabla (pfolsm_t * pp);
 
 void _pfolsm_cphinext (pfolsm_t * pp, double dt);
 
+void _pfolsm_fused (pfolsm_t * pp, double dt);
+
+/**
+   Refresh the speed of the nn cells starting at index idx (all in
+   one row) by calling pp->speedfn. Needs 3*nn doubles of scratch.
+*/
+void _pfolsm_speed_span (pfolsm_t * pp, size_t idx, size_t nn, double * scratch);
+
+/** _pfolsm_speed_span for entire rows j0 to j1. */
+void _pfolsm_speed_rows (pfolsm_t * pp, size_t j0, size_t j1, double * scratch);
+
+/**
+   Fused update of rows j0 to j1. Also accumulates the drift of these
+   rows into drift[0] (sum) and drift[1] (count) if lazy
+   reinitialization is on.
+*/
+void _pfolsm_fused_rows (pfolsm_t * pp, size_t j0, size_t j1, double dt,
+			 double * drift);
+
+/**
+   Add |nabla - 1| of the cells next to the zero level among the nn
+   cells from index idx on to drift[0], and their number to drift[1].
+*/
+void _pfolsm_drift_span (pfolsm_t const * pp, size_t idx, size_t nn, double * drift);
+
+/** Largest |speed| * nabla among the nn cells from index idx on. */
+double _pfolsm_rate_span (pfolsm_t const * pp, size_t idx, size_t nn);
+
+pfolsm_pool_t * _pfolsm_pool_create (size_t nthreads);
+
+/** Run task on all threads of the pool and wait for them to finish. */
+void _pfolsm_pool_run (pfolsm_pool_t * pool, pfolsm_task_t task, void * arg);
+
+size_t _pfolsm_pool_size (pfolsm_pool_t const * pool);
+
+/** Barrier among the threads of a pool, only valid inside a task. */
+void _pfolsm_pool_sync (pfolsm_pool_t * pool);
+
+void _pfolsm_pool_destroy (pfolsm_pool_t * pool);
+
+/** Split [1, nn] into nw bands and return band iw as [*i0, *i1]. */
+void _pfolsm_split (size_t nn, size_t iw, size_t nw, size_t * i0, size_t * i1);
+
+void _pfolsm_row_scalar (double const * phi, double const * speed,
+			 double * next, size_t nn, size_t stride, double dt);
+
+void _pfolsm_row_sse2 (double const * phi, double const * speed,
+		       double * next, size_t nn, size_t stride, double dt);
+
+void _pfolsm_row_avx2 (double const * phi, double const * speed,
+		       double * next, size_t nn, size_t stride, double dt);
+
+void _pfolsm_row_avx512 (double const * phi, double const * speed,
+			 double * next, size_t nn, size_t stride, double dt);
+
+int _pfolsm_nband_build (pfolsm_t * pp);
+
+/** Fused update restricted to the spans of the narrow band. */
+void _pfolsm_nband_fused (pfolsm_t * pp, double dt);
+
+/** Call the speed model on the spans of the narrow band. */
+void _pfolsm_nband_speed (pfolsm_t * pp);
+
+/** _pfolsm_rate_span over the spans of the narrow band. */
+double _pfolsm_nband_rate (pfolsm_t const * pp);
+
+/** Rebuild the band if the front has reached its edge zone. */
+int _pfolsm_nband_check (pfolsm_t * pp);
+
+void _pfolsm_nband_destroy (pfolsm_t * pp);
+
+void _pfolsm_rowf_scalar (float const * phi, float const * speed,
+			  float * next, size_t nn, size_t stride, double dt);
+
+void _pfolsm_rowf_sse2 (float const * phi, float const * speed,
+			float * next, size_t nn, size_t stride, double dt);
+
+void _pfolsm_rowf_avx2 (float const * phi, float const * speed,
+			float * next, size_t nn, size_t stride, double dt);
+
+void _pfolsm_rowf_avx512 (float const * phi, float const * speed,
+			  float * next, size_t nn, size_t stride, double dt);
+
+void _pfolsm_rowm_scalar (float const * phi, float const * speed,
+			  float * next, size_t nn, size_t stride, double dt);
+
+void _pfolsm_rowm_avx2 (float const * phi, float const * speed,
+			float * next, size_t nn, size_t stride, double dt);
+
+double _pfolsm_rate_scalar (double const * phi, double const * speed,
+			    size_t nn, size_t stride);
+
+double _pfolsm_rate_avx2 (double const * phi, double const * speed,
+			  size_t nn, size_t stride);
+
+void _pfolsm_weno_scalar (double const * src, double const * base,
+			  double const * speed, double * dst, size_t nn,
+			  size_t stride, double dt, double aa, double bb);
+
+void _pfolsm_weno_avx2 (double const * src, double const * base,
+			double const * speed, double * dst, size_t nn,
+			size_t stride, double dt, double aa, double bb);
+
+/** WENO kernel, the widest one not above isa. */
+pfolsm_weno_t _pfolsm_weno_kernel (int isa);
+
+/**
+   Three-stage TVD Runge-Kutta step of the WENO engine from phi into
+   phinext. Unless prepared is set, ghost cells and speeds of phi are
+   filled in first.
+*/
+void _pfolsm_weno_update (pfolsm_t * pp, double dt, int prepared);
+
+/**
+   Largest |speed| * nabla among the nn cells from index idx on, with
+   the WENO gradient of the first Runge-Kutta stage.
+*/
+double _pfolsm_weno_rate_span (pfolsm_t const * pp, size_t idx, size_t nn);
+
+/** Highest PFOLSM_ISA_xxx supported by the compiler and this CPU. */
+int _pfolsm_isa_best (void);
+
+/** Row kernel for the given ISA, or 0 if it is not available. */
+pfolsm_row_t _pfolsm_row_kernel (int isa);
+
+/** Rate kernel, the widest one not above isa. */
+pfolsm_rate_t _pfolsm_rate_kernel (int isa);
+
+/** Float row kernel for the given ISA, or 0 if it is not available. */
+pfolsm_rowf_t _pfolsm_rowf_kernel (int isa);
+
+/** Mixed precision row kernel, the widest one not above isa. */
+pfolsm_rowf_t _pfolsm_rowm_kernel (int isa);
+
 void _pfolsm_pdata (pfolsm_t * pp,
 		    FILE * fp,
 		    double * dbase,
@@ -87,6 +493,22 @@ void _pfolsm_pdata (pfolsm_t * pp,
 
 void _pfolsm_pnum5 (FILE * fp, double num);
 
+/** Buffer size that the _pfolsm_fmt_xxx functions need. */
+#define PFOLSM_FMT_MAX 512
+
+/**
+   Format num into buf like printf with "% *.*f" (space nonzero) or
+   "%*.*f", without the trailing nul, and return the length. Width is
+   at most 64 and prec at most 17.
+*/
+size_t _pfolsm_fmt_fixed (char * buf, double num, int width, int prec, int space);
+
+/**
+   Format num into buf as _pfolsm_pnum6 (width 5) or _pfolsm_pnum5
+   (width 4) print it, and return the length.
+*/
+size_t _pfolsm_fmt_num (char * buf, double num, int width);
+
 void _pfolsm_pnum6 (FILE * fp, double num);
 
 
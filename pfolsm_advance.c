@@ -0,0 +1,232 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Temporal blocking: each tile of the grid is copied into a scratch
+ * area together with a halo of depth cells, then advanced depth
+ * steps without touching the full planes. The halo shrinks by one
+ * cell per step, so after depth steps the tile interior holds exactly
+ * what depth calls of pfolsm_update would have computed.
+ */
+
+#include "pfolsm.h"
+#include "pfolsm_stats.h"
+
+#include <string.h>
+
+#define TILEX 128
+#define TILEY 64
+#define DEPTH 8
+
+#define SCRATCHX (TILEX + 2 * DEPTH + 2)
+#define SCRATCHY (TILEY + 2 * DEPTH + 2)
+#define SCRATCH  (SCRATCHX * SCRATCHY)
+
+
+struct advance_s {
+  pfolsm_t * pp;
+  double dt;
+  size_t depth;
+  size_t ntx, nty;
+  double * scratch;		/* 3 * SCRATCH doubles per thread */
+};
+
+
+static size_t smax (size_t aa, size_t bb)
+{
+  return aa > bb ? aa : bb;
+}
+
+
+static size_t smin (size_t aa, size_t bb)
+{
+  return aa < bb ? aa : bb;
+}
+
+
+/**
+   Advance one tile. The scratch planes cover global columns
+   [ex0, ex1] and rows [ey0, ey1], which include the domain ghost
+   cells where the tile touches the border.
+*/
+static void advance_tile (struct advance_s const * arg,
+			  size_t i0, size_t i1,
+			  size_t j0, size_t j1,
+			  double * scratch)
+{
+  pfolsm_t * pp = arg->pp;
+  size_t const kk = arg->depth;
+  size_t const ex0 = i0 > kk ? i0 - kk : 0;
+  size_t const ex1 = smin (i1 + kk, pp->dimx + 1);
+  size_t const ey0 = j0 > kk ? j0 - kk : 0;
+  size_t const ey1 = smin (j1 + kk, pp->dimy + 1);
+  size_t const sw = ex1 - ex0 + 1;
+  double * speed = scratch;
+  double * cur = scratch + SCRATCH;
+  double * nxt = cur + SCRATCH;
+  double * tmp;
+  size_t ss, ii, jj;
+  
+  for (jj = ey0; jj <= ey1; ++jj) {
+    memcpy (cur + (jj - ey0) * sw, pp->phi + jj * pp->nx + ex0, sw * sizeof(double));
+    memcpy (speed + (jj - ey0) * sw, pp->speed + jj * pp->nx + ex0, sw * sizeof(double));
+  }
+  
+  for (ss = 1; ss <= kk; ++ss) {
+    
+    // Cells [x0, x1] x [y0, y1] are still valid from the previous
+    // step, and [x0+1, x1-1] x [y0+1, y1-1] can be computed from them
+    // (minus the rims that are domain ghosts).
+    
+    size_t const x0 = smax (1, i0 > kk - ss + 1 ? i0 - (kk - ss + 1) : 1);
+    size_t const x1 = smin (pp->dimx, i1 + (kk - ss + 1));
+    size_t const y0 = smax (1, j0 > kk - ss + 1 ? j0 - (kk - ss + 1) : 1);
+    size_t const y1 = smin (pp->dimy, j1 + (kk - ss + 1));
+    size_t const cx0 = smax (1, i0 > kk - ss ? i0 - (kk - ss) : 1);
+    size_t const cx1 = smin (pp->dimx, i1 + (kk - ss));
+    size_t const cy0 = smax (1, j0 > kk - ss ? j0 - (kk - ss) : 1);
+    size_t const cy1 = smin (pp->dimy, j1 + (kk - ss));
+    
+    // same reflection as _pfolsm_cbounds
+    
+    if (0 == ex0) {
+      for (jj = y0; jj <= y1; ++jj) {
+	cur[(jj - ey0) * sw] = cur[(jj - ey0) * sw + 2];
+      }
+    }
+    if (pp->dimx + 1 == ex1) {
+      for (jj = y0; jj <= y1; ++jj) {
+	cur[(jj - ey0) * sw + pp->dimx + 1 - ex0] = cur[(jj - ey0) * sw + pp->dimx - 1 - ex0];
+      }
+    }
+    if (0 == ey0) {
+      for (ii = x0; ii <= x1; ++ii) {
+	cur[ii - ex0] = cur[2 * sw + ii - ex0];
+      }
+    }
+    if (pp->dimy + 1 == ey1) {
+      for (ii = x0; ii <= x1; ++ii) {
+	cur[(pp->dimy + 1 - ey0) * sw + ii - ex0] = cur[(pp->dimy - 1 - ey0) * sw + ii - ex0];
+      }
+    }
+    
+    for (jj = cy0; jj <= cy1; ++jj) {
+      size_t const off = (jj - ey0) * sw + cx0 - ex0;
+      pp->row (cur + off, speed + off, nxt + off, cx1 - cx0 + 1, sw, arg->dt);
+    }
+    
+    tmp = cur;
+    cur = nxt;
+    nxt = tmp;
+  }
+  
+  for (jj = j0; jj <= j1; ++jj) {
+    memcpy (pp->phinext + jj * pp->nx + i0, cur + (jj - ey0) * sw + i0 - ex0,
+	    (i1 - i0 + 1) * sizeof(double));
+  }
+}
+
+
+static void advance_tiles (void * varg, size_t iw, size_t nw)
+{
+  struct advance_s const * arg = varg;
+  pfolsm_t const * pp = arg->pp;
+  size_t t0, t1, tt, ncell = 0;
+  PFOLSM_STATS_BEGIN (fu);
+  
+  _pfolsm_split (arg->ntx * arg->nty, iw, nw, &t0, &t1);
+  for (tt = t0 - 1; tt < t1; ++tt) {
+    size_t const i0 = 1 + (tt % arg->ntx) * TILEX;
+    size_t const j0 = 1 + (tt / arg->ntx) * TILEY;
+    size_t const i1 = smin (i0 + TILEX - 1, pp->dimx);
+    size_t const j1 = smin (j0 + TILEY - 1, pp->dimy);
+    advance_tile (arg, i0, i1, j0, j1, arg->scratch + 3 * SCRATCH * iw);
+    ncell += (i1 - i0 + 1) * (j1 - j0 + 1);
+  }
+  PFOLSM_STATS_END (pp, fu, PFOLSM_STAGE_FUSED, iw, arg->depth * ncell);
+  (void) ncell;
+}
+
+
+int pfolsm_advance_n (pfolsm_t * pp, double dt, size_t nsteps)
+{
+  struct advance_s arg;
+  size_t nthreads;
+  double * tmp;
+  
+  if (pp->flags & (PFOLSM_DEBUG | PFOLSM_WENO) || pp->nband || pp->fphi
+      || pp->speedfn || pp->driftbuf) {
+    for (; nsteps > 0; --nsteps) {
+      pfolsm_update (pp, dt);
+    }
+    return 0;
+  }
+  
+  nthreads = pp->pool ? _pfolsm_pool_size (pp->pool) : 1;
+  arg.pp = pp;
+  arg.dt = dt;
+  arg.ntx = (pp->dimx + TILEX - 1) / TILEX;
+  arg.nty = (pp->dimy + TILEY - 1) / TILEY;
+  arg.scratch = malloc (3 * SCRATCH * nthreads * sizeof(double));
+  if (0 == arg.scratch) {
+    return -1;
+  }
+  
+  while (nsteps > 0) {
+    PFOLSM_STATS_BEGIN (total);
+    arg.depth = smin (nsteps, DEPTH);
+    if (pp->pool) {
+      PFOLSM_STATS_FORK (pp);
+      _pfolsm_pool_run (pp->pool, advance_tiles, &arg);
+      PFOLSM_STATS_PARALLEL (pp);
+    }
+    else {
+      advance_tiles (&arg, 0, 1);
+    }
+    PFOLSM_STATS_END (pp, total, PFOLSM_STAGE_UPDATE, 0,
+		      arg.depth * pp->dimx * pp->dimy);
+    tmp = pp->phi;
+    pp->phi = pp->phinext;
+    pp->phinext = tmp;
+    pp->time += arg.depth * dt;
+    pp->dt = dt;
+    nsteps -= arg.depth;
+  }
+  
+  free (arg.scratch);
+  return 0;
+}
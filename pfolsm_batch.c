@@ -0,0 +1,380 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pfolsm_batch.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# define PFOLSM_HAVE_X86
+# include <immintrin.h>
+#endif
+
+
+static double max3 (double aa, double bb, double cc)
+{
+  if (aa > bb) {
+    return aa > cc ? aa : cc;
+  }
+  return bb > cc ? bb : cc;
+}
+
+
+void _pfolsm_lanes_scalar (double const * phi,
+			   double const * speed,
+			   double * next,
+			   double const * dt,
+			   size_t nn,
+			   size_t nlane,
+			   size_t stride)
+{
+  double const * dn = phi - stride;
+  double const * up = phi + stride;
+  size_t ii, kk;
+  
+  for (ii = 0; ii < nn * nlane; ii += nlane) {
+    for (kk = ii; kk < ii + nlane; ++kk) {
+      double const dxm = phi[kk] - phi[kk - nlane];
+      double const dxp = phi[kk + nlane] - phi[kk];
+      double const dym = phi[kk] - dn[kk];
+      double const dyp = up[kk] - phi[kk];
+      double gx, gy;
+      if (speed[kk] > 0.0) {
+	gx = max3 (dxm, - dxp, 0.0);
+	gy = max3 (dym, - dyp, 0.0);
+      }
+      else {
+	gx = max3 (- dxm, dxp, 0.0);
+	gy = max3 (- dym, dyp, 0.0);
+      }
+      next[kk] = phi[kk] - dt[kk - ii] * (speed[kk] * sqrt (gx * gx + gy * gy));
+    }
+  }
+}
+
+
+#ifdef PFOLSM_HAVE_X86
+
+
+/**
+   Same as _pfolsm_row_avx2, except that the x neighbours are nlane
+   entries away and dt is loaded per lane.
+*/
+__attribute__((target("avx2")))
+static void lanes_avx2 (double const * phi,
+			double const * speed,
+			double * next,
+			double const * dt,
+			size_t nn,
+			size_t nlane,
+			size_t stride)
+{
+  double const * dn = phi - stride;
+  double const * up = phi + stride;
+  __m256d const zero = _mm256_setzero_pd ();
+  __m256d const sign = _mm256_set1_pd (-0.0);
+  size_t ii, kk;
+  
+  for (ii = 0; ii < nn * nlane; ii += nlane) {
+    for (kk = ii; kk < ii + nlane; kk += 4) {
+      __m256d const cc = _mm256_loadu_pd (phi + kk);
+      __m256d const dxm = _mm256_sub_pd (cc, _mm256_loadu_pd (phi + kk - nlane));
+      __m256d const dxp = _mm256_sub_pd (_mm256_loadu_pd (phi + kk + nlane), cc);
+      __m256d const dym = _mm256_sub_pd (cc, _mm256_loadu_pd (dn + kk));
+      __m256d const dyp = _mm256_sub_pd (_mm256_loadu_pd (up + kk), cc);
+      __m256d const ss = _mm256_loadu_pd (speed + kk);
+      __m256d const pos = _mm256_cmp_pd (ss, zero, _CMP_GT_OQ);
+      __m256d const flip = _mm256_andnot_pd (pos, sign);
+      __m256d const gx = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dxm, flip),
+						       _mm256_xor_pd (dxp, _mm256_xor_pd (flip, sign))),
+					zero);
+      __m256d const gy = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dym, flip),
+						       _mm256_xor_pd (dyp, _mm256_xor_pd (flip, sign))),
+					zero);
+      __m256d const nabla = _mm256_sqrt_pd (_mm256_add_pd (_mm256_mul_pd (gx, gx),
+							   _mm256_mul_pd (gy, gy)));
+      __m256d const vdt = _mm256_loadu_pd (dt + kk - ii);
+      _mm256_storeu_pd (next + kk, _mm256_sub_pd (cc, _mm256_mul_pd (vdt, _mm256_mul_pd (ss, nabla))));
+    }
+  }
+}
+
+
+__attribute__((target("avx512f")))
+static __m512d neg512 (__m512d aa)
+{
+  return _mm512_castsi512_pd (_mm512_xor_si512 (_mm512_castpd_si512 (aa),
+						_mm512_castpd_si512 (_mm512_set1_pd (-0.0))));
+}
+
+
+__attribute__((target("avx512f")))
+static void lanes_avx512 (double const * phi,
+			  double const * speed,
+			  double * next,
+			  double const * dt,
+			  size_t nn,
+			  size_t nlane,
+			  size_t stride)
+{
+  double const * dn = phi - stride;
+  double const * up = phi + stride;
+  __m512d const zero = _mm512_setzero_pd ();
+  size_t ii, kk;
+  
+  for (ii = 0; ii < nn * nlane; ii += nlane) {
+    for (kk = ii; kk < ii + nlane; kk += 8) {
+      __m512d const cc = _mm512_loadu_pd (phi + kk);
+      __m512d const dxm = _mm512_sub_pd (cc, _mm512_loadu_pd (phi + kk - nlane));
+      __m512d const dxp = _mm512_sub_pd (_mm512_loadu_pd (phi + kk + nlane), cc);
+      __m512d const dym = _mm512_sub_pd (cc, _mm512_loadu_pd (dn + kk));
+      __m512d const dyp = _mm512_sub_pd (_mm512_loadu_pd (up + kk), cc);
+      __m512d const ss = _mm512_loadu_pd (speed + kk);
+      __mmask8 const pos = _mm512_cmp_pd_mask (ss, zero, _CMP_GT_OQ);
+      __m512d const gx = _mm512_max_pd (_mm512_max_pd (_mm512_mask_blend_pd (pos, neg512 (dxm), dxm),
+						       _mm512_mask_blend_pd (pos, dxp, neg512 (dxp))),
+					zero);
+      __m512d const gy = _mm512_max_pd (_mm512_max_pd (_mm512_mask_blend_pd (pos, neg512 (dym), dym),
+						       _mm512_mask_blend_pd (pos, dyp, neg512 (dyp))),
+					zero);
+      __m512d const nabla = _mm512_sqrt_pd (_mm512_add_pd (_mm512_mul_pd (gx, gx),
+							   _mm512_mul_pd (gy, gy)));
+      __m512d const vdt = _mm512_loadu_pd (dt + kk - ii);
+      _mm512_storeu_pd (next + kk, _mm512_sub_pd (cc, _mm512_mul_pd (vdt, _mm512_mul_pd (ss, nabla))));
+    }
+  }
+}
+
+
+#endif // PFOLSM_HAVE_X86
+
+
+pfolsm_lanes_t _pfolsm_lanes_kernel (int isa)
+{
+  if (isa < 0 || isa > _pfolsm_isa_best ()) {
+    return 0;
+  }
+  switch (isa) {
+#ifdef PFOLSM_HAVE_X86
+  case PFOLSM_ISA_AVX2:
+    return lanes_avx2;
+  case PFOLSM_ISA_AVX512:
+    return lanes_avx512;
+#endif
+  default:
+    return _pfolsm_lanes_scalar;
+  }
+}
+
+
+int pfolsm_batch_create (pfolsm_batch_t * pb,
+			 size_t dimx,
+			 size_t dimy,
+			 size_t ninst)
+{
+  size_t nn;
+  
+  if (dimx < 2) {
+    dimx = 2;
+  }
+  if (dimy < 2) {
+    dimy = 2;
+  }
+  if (ninst < 1) {
+    ninst = 1;
+  }
+  
+  pb->ninst = ninst;
+  pb->nlane = (ninst + PFOLSM_BATCH_WIDTH - 1) / PFOLSM_BATCH_WIDTH * PFOLSM_BATCH_WIDTH;
+  pb->dimx  = dimx;
+  pb->dimy  = dimy;
+  pb->nx    = dimx + 2;
+  pb->ny    = dimy + 2;
+  pb->ntt   = pb->nx * pb->ny;
+  pb->lanes = _pfolsm_lanes_kernel (_pfolsm_isa_best ());
+  pb->pool  = 0;
+  
+  // padding lanes keep speed, dt, and phi at zero, which leaves them
+  // at zero forever
+  
+  nn = pb->ntt * pb->nlane;
+  pb->data = calloc (3 * nn + pb->nlane, sizeof(double));
+  if (0 == pb->data) {
+    return -1;
+  }
+  pb->speed   = pb->data;
+  pb->phi     = pb->data + nn;
+  pb->phinext = pb->data + 2 * nn;
+  pb->dt      = pb->data + 3 * nn;
+  
+  return 0;
+}
+
+
+void pfolsm_batch_destroy (pfolsm_batch_t * pb)
+{
+  _pfolsm_pool_destroy (pb->pool);
+  free (pb->data);
+}
+
+
+int pfolsm_batch_threads (pfolsm_batch_t * pb, size_t nthreads)
+{
+  _pfolsm_pool_destroy (pb->pool);
+  pb->pool = 0;
+  if (nthreads >= 2) {
+    pb->pool = _pfolsm_pool_create (nthreads);
+    if (0 == pb->pool) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+int pfolsm_batch_load (pfolsm_batch_t * pb, size_t kk, pfolsm_t const * pp)
+{
+  size_t ii, jj;
+  
+  if (kk >= pb->ninst || pp->dimx != pb->dimx || pp->dimy != pb->dimy || pp->fphi) {
+    return -1;
+  }
+  for (jj = 1; jj <= pb->dimy; ++jj) {
+    for (ii = 1; ii <= pb->dimx; ++ii) {
+      size_t const src = ii + jj * pp->nx;
+      size_t const dst = (ii + jj * pb->nx) * pb->nlane + kk;
+      pb->phi[dst] = pp->phi[src];
+      pb->speed[dst] = pp->speed[src];
+    }
+  }
+  return 0;
+}
+
+
+int pfolsm_batch_store (pfolsm_batch_t const * pb, size_t kk, pfolsm_t * pp)
+{
+  size_t ii, jj;
+  
+  if (kk >= pb->ninst || pp->dimx != pb->dimx || pp->dimy != pb->dimy || pp->fphi) {
+    return -1;
+  }
+  for (jj = 1; jj <= pb->dimy; ++jj) {
+    for (ii = 1; ii <= pb->dimx; ++ii) {
+      pp->phi[ii + jj * pp->nx] = pb->phi[(ii + jj * pb->nx) * pb->nlane + kk];
+    }
+  }
+  return 0;
+}
+
+
+double pfolsm_batch_get (pfolsm_batch_t const * pb, size_t kk, size_t ii, size_t jj)
+{
+  return pb->phi[(ii + jj * pb->nx) * pb->nlane + kk];
+}
+
+
+void pfolsm_batch_set (pfolsm_batch_t * pb, size_t kk, size_t ii, size_t jj,
+		       double phi, double speed)
+{
+  size_t const idx = (ii + jj * pb->nx) * pb->nlane + kk;
+  pb->phi[idx] = phi;
+  pb->speed[idx] = speed;
+}
+
+
+/**
+   Ghost cells of rows j0 to j1, plus the bottom and top ghost rows
+   if those rows include the first or last one. Same mirroring as
+   _pfolsm_cbounds_rows, a whole cell of lanes at a time.
+*/
+static void cbounds_rows (pfolsm_batch_t const * pb, size_t j0, size_t j1)
+{
+  size_t const nl = pb->nlane;
+  size_t const rowlen = pb->dimx * nl * sizeof(double);
+  size_t jj;
+  
+  if (1 == j0) {
+    memcpy (pb->phi + nl, pb->phi + (1 + 2 * pb->nx) * nl, rowlen);
+  }
+  if (pb->dimy == j1) {
+    memcpy (pb->phi + (1 + (pb->dimy + 1) * pb->nx) * nl,
+	    pb->phi + (1 + (pb->dimy - 1) * pb->nx) * nl, rowlen);
+  }
+  for (jj = j0; jj <= j1; ++jj) {
+    double * row = pb->phi + jj * pb->nx * nl;
+    memcpy (row, row + 2 * nl, nl * sizeof(double));
+    memcpy (row + (pb->dimx + 1) * nl, row + (pb->dimx - 1) * nl, nl * sizeof(double));
+  }
+}
+
+
+static void update_band (void * arg, size_t iw, size_t nw)
+{
+  pfolsm_batch_t const * pb = arg;
+  size_t const nl = pb->nlane;
+  size_t j0, j1, jj;
+  
+  _pfolsm_split (pb->dimy, iw, nw, &j0, &j1);
+  if (j0 > j1) {
+    return;
+  }
+  cbounds_rows (pb, j0, j1);
+  for (jj = j0; jj <= j1; ++jj) {
+    size_t const off = (1 + jj * pb->nx) * nl;
+    pb->lanes (pb->phi + off, pb->speed + off, pb->phinext + off, pb->dt,
+	       pb->dimx, nl, pb->nx * nl);
+  }
+}
+
+
+void pfolsm_batch_update (pfolsm_batch_t * pb, double const * dt)
+{
+  double * tmp;
+  
+  memcpy (pb->dt, dt, pb->ninst * sizeof(double));
+  if (pb->pool) {
+    _pfolsm_pool_run (pb->pool, update_band, pb);
+  }
+  else {
+    update_band (pb, 0, 1);
+  }
+  
+  tmp = pb->phi;
+  pb->phi = pb->phinext;
+  pb->phinext = tmp;
+}
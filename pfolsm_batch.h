@@ -0,0 +1,128 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_BATCH_H
+#define PFOLSM_BATCH_H
+
+#include "pfolsm.h"
+
+
+/*
+ * Ensemble of same-sized grids advanced together. The planes are
+ * interleaved by instance: all lanes of a cell are next to each
+ * other, so one vector of the update kernel holds the same cell of
+ * several instances, and the row loops run once for the whole batch
+ * however small each grid is.
+ */
+
+/** Lanes are padded to a multiple of this, the widest vector. */
+#define PFOLSM_BATCH_WIDTH 8
+
+
+/**
+   Update of nn cells of a row for all nlane lanes, with the x
+   neighbours nlane and the y neighbours stride entries away, and a
+   time step per lane. Same arithmetic as pfolsm_row_t.
+*/
+typedef void (*pfolsm_lanes_t) (double const * phi,
+				double const * speed,
+				double * next,
+				double const * dt,
+				size_t nn,
+				size_t nlane,
+				size_t stride);
+
+
+struct pfolsm_batch_s {
+  size_t ninst;			/* instances */
+  size_t nlane;			/* ninst rounded up to PFOLSM_BATCH_WIDTH */
+  size_t dimx;
+  size_t dimy;
+  size_t nx, ny, ntt;		/* one ghost layer, as for pfolsm_create */
+  double * data;
+  double * speed;		/* ntt * nlane each, entry (idx, k) */
+  double * phi;			/* at idx * nlane + k */
+  double * phinext;
+  double * dt;			/* nlane, 0 in the padding */
+  pfolsm_lanes_t lanes;
+  pfolsm_pool_t * pool;
+};
+
+typedef struct pfolsm_batch_s pfolsm_batch_t;
+
+
+int pfolsm_batch_create (pfolsm_batch_t * pb,
+			 size_t dimx,
+			 size_t dimy,
+			 size_t ninst);
+
+void pfolsm_batch_destroy (pfolsm_batch_t * pb);
+
+/** Same as pfolsm_threads, splitting the rows of all instances. */
+int pfolsm_batch_threads (pfolsm_batch_t * pb, size_t nthreads);
+
+/**
+   Copy phi and speed of the interior cells of pp into instance kk.
+   pp must have the size of the batch and double planes. Returns -1
+   if it does not fit.
+*/
+int pfolsm_batch_load (pfolsm_batch_t * pb, size_t kk, pfolsm_t const * pp);
+
+/** Copy phi of instance kk back into pp, the inverse of load. */
+int pfolsm_batch_store (pfolsm_batch_t const * pb, size_t kk, pfolsm_t * pp);
+
+double pfolsm_batch_get (pfolsm_batch_t const * pb, size_t kk, size_t ii, size_t jj);
+
+void pfolsm_batch_set (pfolsm_batch_t * pb, size_t kk, size_t ii, size_t jj,
+		       double phi, double speed);
+
+/**
+   One step of every instance, instance kk with time step dt[kk].
+   Each instance ends up bit-identical to what pfolsm_update would
+   have computed for it on its own.
+*/
+void pfolsm_batch_update (pfolsm_batch_t * pb, double const * dt);
+
+
+/** Fastest supported kernel for PFOLSM_ISA_xxx, 0 if unsupported. */
+pfolsm_lanes_t _pfolsm_lanes_kernel (int isa);
+
+void _pfolsm_lanes_scalar (double const * phi, double const * speed, double * next,
+			   double const * dt, size_t nn, size_t nlane, size_t stride);
+
+
+#endif
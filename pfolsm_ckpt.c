@@ -0,0 +1,238 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pfolsm_ckpt.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static char const magic[8] = "pfolsm";
+
+
+/** Where the planes start. */
+static size_t plane_offset (pfolsm_t const * pp)
+{
+  return PFOLSM_CKPT_OFFSET + _pfolsm_lead (pp);
+}
+
+
+/**
+   Where the arrival times start, aligned for doubles after float
+   planes.
+*/
+static size_t arrival_offset (pfolsm_t const * pp, size_t nplanes, size_t elsize)
+{
+  size_t const end = plane_offset (pp) + nplanes * pp->ntt * elsize;
+  return (end + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+}
+
+
+static int write_all (int fd, void const * buf, size_t len)
+{
+  char const * pos = buf;
+  while (len > 0) {
+    ssize_t const nn = write (fd, pos, len);
+    if (nn < 0) {
+      if (EINTR == errno) {
+	continue;
+      }
+      return -1;
+    }
+    pos += nn;
+    len -= nn;
+  }
+  return 0;
+}
+
+
+int pfolsm_ckpt_save (pfolsm_t const * pp, char const * path,
+		      double const * arrival)
+{
+  size_t const org = (pp->ng - 1) * (pp->nx + 1);
+  char head[PFOLSM_CKPT_OFFSET + PFOLSM_ALIGN];
+  struct pfolsm_ckpt_header_s hdr;
+  void const * plane[4];
+  size_t elsize, rest, ii;
+  int fd, status;
+  
+  memset (&hdr, 0, sizeof(hdr));
+  memcpy (hdr.magic, magic, sizeof(hdr.magic));
+  hdr.version = PFOLSM_CKPT_VERSION;
+  hdr.byteorder = 0x01020304;
+  hdr.flags = pp->flags;
+  hdr.dimx = pp->dimx;
+  hdr.dimy = pp->dimy;
+  hdr.ng = pp->ng;
+  hdr.nx = pp->nx;
+  hdr.ny = pp->ny;
+  hdr.nplanes = (pp->flags & PFOLSM_DEBUG) ? 8 : (pp->flags & PFOLSM_WENO) ? 4 : 3;
+  hdr.narrival = arrival ? pp->ntt : 0;
+  hdr.time = pp->time;
+  hdr.dt = pp->dt;
+  
+  // phi and phinext swap places with every update, so they get
+  // written one by one in their nominal order. The engine planes
+  // after them never move.
+  
+  if (pp->fdata) {
+    elsize = sizeof(float);
+    plane[0] = pp->fspeed - org;
+    plane[1] = pp->fphi - org;
+    plane[2] = pp->fphinext - org;
+    plane[3] = pp->fdata + 3 * pp->ntt;
+  }
+  else {
+    elsize = sizeof(double);
+    plane[0] = pp->speed - org;
+    plane[1] = pp->phi - org;
+    plane[2] = pp->phinext - org;
+    plane[3] = pp->data + 3 * pp->ntt;
+  }
+  hdr.elsize = elsize;
+  rest = (hdr.nplanes - 3) * pp->ntt * elsize;
+  
+  memset (head, 0, sizeof(head));
+  memcpy (head, &hdr, sizeof(hdr));
+  
+  fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+  status = write_all (fd, head, plane_offset (pp));
+  for (ii = 0; 0 == status && ii < 3; ++ii) {
+    status = write_all (fd, plane[ii], pp->ntt * elsize);
+  }
+  if (0 == status && rest > 0) {
+    status = write_all (fd, plane[3], rest);
+  }
+  if (0 == status && arrival) {
+    static char const pad[sizeof(double)] = { 0 };
+    size_t const used = plane_offset (pp) + hdr.nplanes * pp->ntt * elsize;
+    status = write_all (fd, pad, arrival_offset (pp, hdr.nplanes, elsize) - used);
+    if (0 == status) {
+      status = write_all (fd, arrival, pp->ntt * sizeof(double));
+    }
+  }
+  if (0 != close (fd)) {
+    status = -1;
+  }
+  return status;
+}
+
+
+/**
+   Validate the header against the file size and set up pp for it.
+   Returns the number of planes, or 0 if the file is not usable.
+*/
+static size_t check (pfolsm_t * pp, struct pfolsm_ckpt_header_s const * hdr, size_t size)
+{
+  size_t nplanes, elsize;
+  
+  if (0 != memcmp (hdr->magic, magic, sizeof(hdr->magic))
+      || PFOLSM_CKPT_VERSION != hdr->version
+      || 0x01020304 != hdr->byteorder) {
+    return 0;
+  }
+  nplanes = _pfolsm_layout (pp, hdr->dimx, hdr->dimy, hdr->flags, hdr->ng);
+  elsize = (hdr->flags & (PFOLSM_FLOAT | PFOLSM_MIXED)) ? sizeof(float) : sizeof(double);
+  if (0 == nplanes || nplanes != hdr->nplanes || elsize != hdr->elsize
+      || pp->dimx != hdr->dimx || pp->dimy != hdr->dimy || pp->ng != hdr->ng
+      || pp->nx != hdr->nx || pp->ny != hdr->ny
+      || (0 != hdr->narrival && pp->ntt != hdr->narrival)) {
+    return 0;
+  }
+  if (size < plane_offset (pp) + nplanes * pp->ntt * elsize
+      || (0 != hdr->narrival
+	  && size < arrival_offset (pp, nplanes, elsize) + hdr->narrival * sizeof(double))) {
+    return 0;
+  }
+  return nplanes;
+}
+
+
+int pfolsm_ckpt_load (pfolsm_t * pp, char const * path, double ** arrival)
+{
+  struct pfolsm_ckpt_header_s hdr;
+  struct stat st;
+  char * base;
+  size_t nplanes;
+  int fd;
+  
+  fd = open (path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  if (0 != fstat (fd, &st) || st.st_size < PFOLSM_CKPT_OFFSET) {
+    close (fd);
+    return -1;
+  }
+  base = mmap (0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (MAP_FAILED == base) {
+    return -1;
+  }
+  
+  memcpy (&hdr, base, sizeof(hdr));
+  nplanes = check (pp, &hdr, st.st_size);
+  if (0 == nplanes) {
+    munmap (base, st.st_size);
+    return -1;
+  }
+  
+  if (sizeof(float) == hdr.elsize) {
+    pp->fdata = (float *) (base + plane_offset (pp));
+  }
+  else {
+    pp->data = (double *) (base + plane_offset (pp));
+  }
+  _pfolsm_planes (pp);
+  pp->time = hdr.time;
+  pp->dt = hdr.dt;
+  pp->mapbase = base;
+  pp->maplen = st.st_size;
+  
+  if (arrival) {
+    *arrival = hdr.narrival
+      ? (double *) (base + arrival_offset (pp, nplanes, hdr.elsize))
+      : 0;
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_CKPT_H
+#define PFOLSM_CKPT_H
+
+#include "pfolsm.h"
+
+#include <stdint.h>
+
+
+#define PFOLSM_CKPT_VERSION 2
+
+/** Bytes before the planes, so that they stay page aligned. */
+#define PFOLSM_CKPT_OFFSET 4096
+
+
+/**
+   Start of a checkpoint file, in native byte order. The planes
+   follow at PFOLSM_CKPT_OFFSET plus _pfolsm_lead, so that their rows
+   come out aligned when mapped, in the order speed, phi, phinext, and
+   then the planes of the engine. Each has all ntt cells including
+   ghosts and padding, as double or as float for PFOLSM_FLOAT and
+   PFOLSM_MIXED. The optional arrival times come last, as ntt doubles.
+*/
+struct pfolsm_ckpt_header_s {
+  char magic[8];		/* "pfolsm\0\0" */
+  uint32_t version;
+  uint32_t byteorder;		/* 0x01020304 as written */
+  uint32_t flags;
+  uint32_t elsize;		/* bytes per plane entry */
+  uint64_t dimx, dimy, ng;
+  uint64_t nx, ny;		/* padded layout, must match on load */
+  uint64_t nplanes;
+  uint64_t narrival;		/* 0 or ntt */
+  double time;
+  double dt;
+};
+
+
+/**
+   Write the size, flags, time, and planes of pp to path, straight
+   from the plane buffers, along with arrival (pp->ntt entries, for
+   instance from pfolsm_fmm_arrival) unless that is null. Threads,
+   narrow band, speed model, and lazy reinitialization settings are
+   not saved.
+*/
+int pfolsm_ckpt_save (pfolsm_t const * pp, char const * path,
+		      double const * arrival);
+
+/**
+   Create pp from a checkpoint written by pfolsm_ckpt_save. The file
+   is mapped privately and serves as the storage of the planes, so
+   loading does not copy anything and only the pages that get touched
+   are read. Updates go to private copies of the pages, the file is
+   never modified. If arrival is not null, it is set to the arrival
+   times inside the mapping, or null if the file has none; they stay
+   valid until pfolsm_destroy. Returns -1 if the file cannot be read
+   or is not a compatible checkpoint, leaving pp uninitialized.
+*/
+int pfolsm_ckpt_load (pfolsm_t * pp, char const * path, double ** arrival);
+
+
+#endif
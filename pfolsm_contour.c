@@ -0,0 +1,290 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Marching squares over the cell centers of pfolsm_t. Edge 2*idx is
+ * the one from cell idx to its right neighbor, edge 2*idx+1 the one
+ * to its upper neighbor. The squares only record which crossings
+ * they connect, and the polylines are stitched together afterwards
+ * by walking the links, which also clears them for the next call.
+ */
+
+#include "pfolsm_contour.h"
+
+#define NONE PFOLSM_CONTOUR_NONE
+
+
+struct output_s {
+  pfolsm_point_t * point;
+  size_t pointcap, npoint;
+  size_t * line;
+  size_t linecap, nline;
+};
+
+
+int pfolsm_contour_create (pfolsm_contour_t * ct, pfolsm_t const * pp)
+{
+  size_t ii;
+  
+  ct->nx = pp->nx;
+  ct->ntt = pp->ntt;
+  ct->ntouched = 0;
+  ct->link = malloc (4 * pp->ntt * sizeof(*ct->link));
+  ct->touched = malloc (2 * pp->ntt * sizeof(*ct->touched));
+  if (0 == ct->link || 0 == ct->touched) {
+    pfolsm_contour_destroy (ct);
+    return -1;
+  }
+  for (ii = 0; ii < 4 * pp->ntt; ++ii) {
+    ct->link[ii] = NONE;
+  }
+  return 0;
+}
+
+
+void pfolsm_contour_destroy (pfolsm_contour_t * ct)
+{
+  free (ct->link);
+  free (ct->touched);
+  ct->link = 0;
+  ct->touched = 0;
+}
+
+
+static double phi_at (pfolsm_t const * pp, size_t idx)
+{
+  return pp->fphi ? pp->fphi[idx] : pp->phi[idx];
+}
+
+
+static void add_link (pfolsm_contour_t * ct, size_t from, size_t to)
+{
+  size_t * const ll = ct->link + 2 * from;
+  if (NONE == ll[0]) {
+    ll[0] = to;
+    ct->touched[ct->ntouched++] = from;
+  }
+  else {
+    ll[1] = to;
+  }
+}
+
+
+static void connect (pfolsm_contour_t * ct, size_t e0, size_t e1)
+{
+  add_link (ct, e0, e1);
+  add_link (ct, e1, e0);
+}
+
+
+/**
+   Record the segments of the square whose lower left corner is the
+   cell idx. Saddles are resolved with the average of the corners.
+*/
+static void square (pfolsm_contour_t * ct, pfolsm_t const * pp, size_t idx)
+{
+  size_t const nx = ct->nx;
+  double const p0 = phi_at (pp, idx);
+  double const p1 = phi_at (pp, idx + 1);
+  double const p2 = phi_at (pp, idx + 1 + nx);
+  double const p3 = phi_at (pp, idx + nx);
+  int const s0 = p0 > 0.0, s1 = p1 > 0.0, s2 = p2 > 0.0, s3 = p3 > 0.0;
+  size_t const bottom = 2 * idx;
+  size_t const right = 2 * (idx + 1) + 1;
+  size_t const top = 2 * (idx + nx);
+  size_t const left = 2 * idx + 1;
+  size_t edge[4];
+  size_t nn = 0;
+  
+  if (s0 != s1) {
+    edge[nn++] = bottom;
+  }
+  if (s1 != s2) {
+    edge[nn++] = right;
+  }
+  if (s2 != s3) {
+    edge[nn++] = top;
+  }
+  if (s3 != s0) {
+    edge[nn++] = left;
+  }
+  
+  if (2 == nn) {
+    connect (ct, edge[0], edge[1]);
+  }
+  else if (4 == nn) {
+    if (((p0 + p1 + p2 + p3) > 0.0) == s0) {
+      connect (ct, bottom, right);
+      connect (ct, top, left);
+    }
+    else {
+      connect (ct, left, bottom);
+      connect (ct, right, top);
+    }
+  }
+}
+
+
+static void emit (struct output_s * out, pfolsm_t const * pp, size_t edge)
+{
+  size_t const idx = edge / 2;
+  size_t const other = (edge & 1) ? idx + pp->nx : idx + 1;
+  double const p0 = phi_at (pp, idx);
+  double const tt = p0 / (p0 - phi_at (pp, other));
+  if (out->npoint < out->pointcap) {
+    pfolsm_point_t * pt = out->point + out->npoint;
+    pt->x = idx % pp->nx;
+    pt->y = idx / pp->nx;
+    if (edge & 1) {
+      pt->y += tt;
+    }
+    else {
+      pt->x += tt;
+    }
+  }
+  ++out->npoint;
+}
+
+
+/**
+   Follow the links from start until they run out, clearing them on
+   the way.
+*/
+static void walk (pfolsm_contour_t * ct, pfolsm_t const * pp,
+		  struct output_s * out, size_t start)
+{
+  size_t cur = start;
+  
+  if (out->nline < out->linecap) {
+    out->line[out->nline] = out->npoint;
+  }
+  ++out->nline;
+  emit (out, pp, cur);
+  
+  for (;;) {
+    size_t * ll = ct->link + 2 * cur;
+    size_t next;
+    if (NONE != ll[1]) {
+      next = ll[1];
+      ll[1] = NONE;
+    }
+    else if (NONE != ll[0]) {
+      next = ll[0];
+      ll[0] = NONE;
+    }
+    else {
+      break;
+    }
+    ll = ct->link + 2 * next;
+    if (cur == ll[1]) {
+      ll[1] = NONE;
+    }
+    else {
+      ll[0] = ll[1];
+      ll[1] = NONE;
+    }
+    emit (out, pp, next);
+    cur = next;
+  }
+}
+
+
+size_t pfolsm_contour (pfolsm_contour_t * ct, pfolsm_t const * pp,
+		       size_t j0, size_t j1,
+		       pfolsm_point_t * point, size_t pointcap,
+		       size_t * line, size_t linecap, size_t * nline)
+{
+  struct output_s out;
+  size_t ii, jj;
+  
+  if (j0 < 1) {
+    j0 = 1;
+  }
+  if (j1 > pp->dimy) {
+    j1 = pp->dimy;
+  }
+  
+  // Squares span rows jj and jj + 1, and columns ii and ii + 1.
+  
+  ct->ntouched = 0;
+  if (pp->nband) {
+    size_t const * span = pp->nband->span;
+    for (ii = 0; ii < pp->nband->nspan; ++ii, span += 2) {
+      size_t const row = span[0] / pp->nx;
+      size_t idx;
+      if (row < j0 || row >= j1) {
+	continue;
+      }
+      for (idx = span[0]; idx < span[0] + span[1]; ++idx) {
+	if (idx % pp->nx < pp->dimx) {
+	  square (ct, pp, idx);
+	}
+      }
+    }
+  }
+  else {
+    for (jj = j0; jj < j1; ++jj) {
+      for (ii = 1; ii < pp->dimx; ++ii) {
+	square (ct, pp, ii + jj * pp->nx);
+      }
+    }
+  }
+  
+  // Open polylines first, from their ends, then the closed ones.
+  
+  out.point = point;
+  out.pointcap = pointcap;
+  out.npoint = 0;
+  out.line = line;
+  out.linecap = linecap;
+  out.nline = 0;
+  for (ii = 0; ii < ct->ntouched; ++ii) {
+    size_t const * ll = ct->link + 2 * ct->touched[ii];
+    if (NONE != ll[0] && NONE == ll[1]) {
+      walk (ct, pp, &out, ct->touched[ii]);
+    }
+  }
+  for (ii = 0; ii < ct->ntouched; ++ii) {
+    if (NONE != ct->link[2 * ct->touched[ii]]) {
+      walk (ct, pp, &out, ct->touched[ii]);
+    }
+  }
+  ct->ntouched = 0;
+  
+  *nline = out.nline;
+  return out.npoint;
+}
@@ -0,0 +1,94 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_CONTOUR_H
+#define PFOLSM_CONTOUR_H
+
+#include "pfolsm.h"
+
+
+/** Contour vertex, in the cell coordinates of pfolsm_get. */
+typedef struct {
+  double x, y;
+} pfolsm_point_t;
+
+
+/**
+   Workspace for extracting the zero level of phi as polylines,
+   sized for one grid and reusable across calls. Crossings live on
+   the edges between neighboring cell centers, and each edge links
+   to at most two others through the marching squares segments of
+   the squares on either side.
+*/
+struct pfolsm_contour_s {
+  size_t nx, ntt;
+  size_t * link;		/* two per edge, or PFOLSM_CONTOUR_NONE */
+  size_t * touched;		/* edges with links, for resetting */
+  size_t ntouched;
+};
+
+typedef struct pfolsm_contour_s pfolsm_contour_t;
+
+#define PFOLSM_CONTOUR_NONE ((size_t) -1)
+
+
+/** Allocate a workspace for grids of the same size as pp. */
+int pfolsm_contour_create (pfolsm_contour_t * ct, pfolsm_t const * pp);
+
+void pfolsm_contour_destroy (pfolsm_contour_t * ct);
+
+/**
+   Extract the zero level of phi between rows j0 and j1 (inclusive,
+   clamped to the interior) by marching squares, with crossings
+   interpolated linearly along the cell edges. If pp has a narrow
+   band, only the squares at band cells get visited. Polyline number
+   kk starts at point[line[kk]] and ends where the next one starts,
+   or at the last point. Closed polylines repeat their first point at
+   the end, open ones end at the domain or row range boundary.
+   
+   Does not allocate. Returns the number of points, and stores the
+   number of polylines in nline. If these exceed pointcap or linecap,
+   only what fits gets written, and the caller can retry with larger
+   buffers.
+*/
+size_t pfolsm_contour (pfolsm_contour_t * ct, pfolsm_t const * pp,
+		       size_t j0, size_t j1,
+		       pfolsm_point_t * point, size_t pointcap,
+		       size_t * line, size_t linecap, size_t * nline);
+
+
+#endif
@@ -0,0 +1,337 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Text output of the planes. Values are formatted by hand into a
+ * large buffer, which goes out with one fwrite per chunk, instead of
+ * going through fprintf for every cell. The formatter produces the
+ * same characters as printf: the digits come from an exact split of
+ * the value into its integer and fractional parts, and the residual
+ * of the fractional scaling (via fma) settles rounding exactly, with
+ * ties to even. Values too large for that fall back to snprintf.
+ */
+
+#include "pfolsm.h"
+
+#include <math.h>
+#include <string.h>
+
+#define CHUNK 65536
+
+
+struct chunk_s {
+  FILE * fp;
+  size_t len;
+  int status;
+  char buf[CHUNK];
+};
+
+
+static void chunk_flush (struct chunk_s * ch)
+{
+  if (ch->len > 0 && ch->len != fwrite (ch->buf, 1, ch->len, ch->fp)) {
+    ch->status = -1;
+  }
+  ch->len = 0;
+}
+
+
+/**
+   Where to format the next value, with room for at least
+   PFOLSM_FMT_MAX characters plus a separator.
+*/
+static char * chunk_room (struct chunk_s * ch)
+{
+  if (CHUNK - ch->len < PFOLSM_FMT_MAX + 2) {
+    chunk_flush (ch);
+  }
+  return ch->buf + ch->len;
+}
+
+
+/**
+   Right-align the len characters at the start of buf in width.
+*/
+static size_t pad (char * buf, size_t len, int width)
+{
+  if ((int) len < width) {
+    size_t const shift = width - len;
+    memmove (buf + shift, buf, len);
+    memset (buf, ' ', shift);
+    return width;
+  }
+  return len;
+}
+
+
+/**
+   Decimal digits of nn, without leading zeros unless mindig asks for
+   them.
+*/
+static size_t digits (char * buf, unsigned long nn, int mindig)
+{
+  char tmp[24];
+  size_t len = 0, ii;
+  do {
+    tmp[len++] = '0' + nn % 10;
+    nn /= 10;
+  } while (nn > 0 || (int) len < mindig);
+  for (ii = 0; ii < len; ++ii) {
+    buf[ii] = tmp[len - 1 - ii];
+  }
+  return len;
+}
+
+
+/**
+   Same as printf with "% *d" (space nonzero) or "%*d".
+*/
+static size_t fmt_int (char * buf, int num, int width, int space)
+{
+  size_t len = 0;
+  unsigned long mag = num < 0 ? - (unsigned long) num : (unsigned long) num;
+  if (num < 0) {
+    buf[len++] = '-';
+  }
+  else if (space) {
+    buf[len++] = ' ';
+  }
+  len += digits (buf + len, mag, 1);
+  return pad (buf, len, width);
+}
+
+
+size_t _pfolsm_fmt_fixed (char * buf, double num, int width, int prec, int space)
+{
+  static double const pow10[10] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+  double mag, ip, ff, scaled, resid, nn, frac;
+  size_t len = 0;
+  int up;
+  
+  if (width > 64) {
+    width = 64;
+  }
+  if (prec < 0) {
+    prec = 0;
+  }
+  if (prec > 17) {
+    prec = 17;
+  }
+  
+  mag = fabs (num);
+  if ( ! (mag < 1e9) || prec > 9) {
+    int const nn = snprintf (buf, PFOLSM_FMT_MAX, space ? "% *.*f" : "%*.*f", width, prec, num);
+    return nn < PFOLSM_FMT_MAX ? nn : PFOLSM_FMT_MAX - 1;
+  }
+  
+  // Both the split and the subtraction of the floor are exact, and
+  // scaled + resid is the exact product.
+  
+  ip = trunc (mag);
+  ff = mag - ip;
+  scaled = ff * pow10[prec];
+  resid = fma (ff, pow10[prec], - scaled);
+  nn = floor (scaled);
+  frac = scaled - nn;
+  if (frac != 0.5) {
+    up = frac > 0.5;
+  }
+  else if (resid != 0.0) {
+    up = resid > 0.0;
+  }
+  else {
+    up = 0 != fmod (prec > 0 ? nn : ip, 2.0);
+  }
+  if (up) {
+    nn += 1.0;
+    if (nn >= pow10[prec]) {
+      nn = 0.0;
+      ip += 1.0;
+    }
+  }
+  
+  if (signbit (num)) {
+    buf[len++] = '-';
+  }
+  else if (space) {
+    buf[len++] = ' ';
+  }
+  len += digits (buf + len, (unsigned long) ip, 1);
+  if (prec > 0) {
+    buf[len++] = '.';
+    len += digits (buf + len, (unsigned long) nn, prec);
+  }
+  return pad (buf, len, width);
+}
+
+
+size_t _pfolsm_fmt_num (char * buf, double num, int width)
+{
+  buf[0] = ' ';
+  if (isinf(num) || isnan(num)) {
+    memset (buf + 1, ' ', width - 3);
+    memcpy (buf + width - 2, isinf(num) ? "inf" : "nan", 3);
+    return width + 1;
+  }
+  if (fabs(fmod(num, 1)) < 1e-6 && fabs(num) < 1e9) {
+    size_t const len = 1 + fmt_int (buf + 1, (int) rint(num), width - 2, 1);
+    buf[len] = ' ';
+    buf[len + 1] = ' ';
+    return len + 2;
+  }
+  if (fabs(fmod(num, 1)) < 1e-6) {
+    int const nn = snprintf (buf, PFOLSM_FMT_MAX, " % *d  ", width - 2, (int) rint(num));
+    return nn < PFOLSM_FMT_MAX ? nn : PFOLSM_FMT_MAX - 1;
+  }
+  return 1 + _pfolsm_fmt_fixed (buf + 1, num, width, 1, 1);
+}
+
+
+void _pfolsm_pnum5 (FILE * fp, double num)
+{
+  char buf[PFOLSM_FMT_MAX];
+  fwrite (buf, 1, _pfolsm_fmt_num (buf, num, 4), fp);
+}
+
+
+void _pfolsm_pnum6 (FILE * fp, double num)
+{
+  char buf[PFOLSM_FMT_MAX];
+  fwrite (buf, 1, _pfolsm_fmt_num (buf, num, 5), fp);
+}
+
+
+/**
+   Write the double plane dd, or the float plane ff if dd is null, in
+   the given format. For PFOLSM_DUMP_TEXT, prec is the field width of
+   _pfolsm_fmt_num.
+*/
+static int prows (pfolsm_t const * pp, FILE * fp,
+		  double const * dd, float const * ff,
+		  int format, int prec)
+{
+  struct chunk_s ch;
+  size_t ii, jj;
+  
+  ch.fp = fp;
+  ch.len = 0;
+  ch.status = 0;
+  
+  if (PFOLSM_DUMP_TEXT == format) {
+    for (jj = pp->dimy + 1; jj <= pp->dimy + 1 /* until overflow */; --jj) {
+      for (ii = 0; ii <= pp->dimx + 1; ++ii) {
+	size_t const idx = ii + jj * pp->nx;
+	ch.len += _pfolsm_fmt_num (chunk_room (&ch), dd ? dd[idx] : ff[idx], prec);
+      }
+      ch.buf[ch.len++] = '\n';
+    }
+  }
+  else {
+    char const sep = (PFOLSM_DUMP_CSV == format) ? ',' : ' ';
+    for (jj = 1; jj <= pp->dimy; ++jj) {
+      for (ii = 1; ii <= pp->dimx; ++ii) {
+	size_t const idx = ii + jj * pp->nx;
+	char * const pos = chunk_room (&ch);
+	ch.len += _pfolsm_fmt_fixed (pos, dd ? dd[idx] : ff[idx], 0, prec, 0);
+	ch.buf[ch.len++] = ii < pp->dimx ? sep : '\n';
+      }
+    }
+  }
+  
+  chunk_flush (&ch);
+  return ch.status;
+}
+
+
+void _pfolsm_pdata (pfolsm_t * pp,
+		    FILE * fp,
+		    double * dbase,
+		    void (*pfunc)(FILE *, double))
+{
+  size_t ii, jj;
+  double * dd;
+  
+  if (_pfolsm_pnum6 == pfunc || _pfolsm_pnum5 == pfunc) {
+    prows (pp, fp, dbase, 0, PFOLSM_DUMP_TEXT, _pfolsm_pnum6 == pfunc ? 5 : 4);
+    return;
+  }
+  
+  for (jj = pp->dimy + 1; jj <= pp->dimy + 1 /* until overflow */; --jj) {
+    dd = dbase + pp->nx * jj;
+    for (ii = 0; ii <= pp->dimx + 1; ++ii) {
+      pfunc (fp, *(dd++));
+    }
+    fprintf (fp, "\n");
+  }
+}
+
+
+int pfolsm_dump_phi (pfolsm_t const * pp,
+		     FILE * fp,
+		     int format,
+		     int prec)
+{
+  if (PFOLSM_DUMP_TEXT == format) {
+    prec = 5;
+  }
+  return prows (pp, fp, pp->fphi ? 0 : pp->phi, pp->fphi, format, prec);
+}
+
+
+void pfolsm_dump (pfolsm_t * pp,
+		  FILE * fp)
+{
+  fprintf (fp, "==================================================\n");
+  fprintf (fp, "phi\n");
+  pfolsm_dump_phi (pp, fp, PFOLSM_DUMP_TEXT, 0);
+  
+  if ( ! (pp->flags & PFOLSM_DEBUG)) {
+    return;
+  }
+  
+  fprintf (fp, "--------------------------------------------------\n");
+  fprintf (fp, "diffx\n");
+  _pfolsm_pdata (pp, fp, pp->diffx, _pfolsm_pnum6);
+  
+  fprintf (fp, "--------------------------------------------------\n");
+  fprintf (fp, "diffy\n");
+  _pfolsm_pdata (pp, fp, pp->diffy, _pfolsm_pnum6);
+  
+  fprintf (fp, "--------------------------------------------------\n");
+  fprintf (fp, "nabla\n");
+  _pfolsm_pdata (pp, fp, pp->nabla, _pfolsm_pnum6);
+}
@@ -0,0 +1,399 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Fast marching method (Sethian 1996) on the grid of pfolsm_t, with
+ * unit spacing, first order upwind stencils, and the reflective
+ * domain boundary of the explicit update, which for marching simply
+ * means that there are no neighbors beyond the interior.
+ */
+
+#include "pfolsm_fmm.h"
+
+#include <math.h>
+#include <string.h>
+
+#define FAR   PFOLSM_FMM_FAR
+#define TRIAL PFOLSM_FMM_TRIAL
+#define KNOWN PFOLSM_FMM_KNOWN
+
+
+int pfolsm_fmm_create (pfolsm_fmm_t * fm, pfolsm_t const * pp)
+{
+  fm->dimx = pp->dimx;
+  fm->dimy = pp->dimy;
+  fm->nx = pp->nx;
+  fm->ntt = pp->ntt;
+  fm->nheap = 0;
+  fm->heapcap = 2 * (pp->nx + pp->ny);
+  fm->dist = malloc (pp->ntt * sizeof(*fm->dist));
+  fm->state = malloc (pp->ntt);
+  fm->pos = malloc (pp->ntt * sizeof(*fm->pos));
+  fm->heap = malloc (fm->heapcap * sizeof(*fm->heap));
+  if (0 == fm->dist || 0 == fm->state || 0 == fm->pos || 0 == fm->heap) {
+    pfolsm_fmm_destroy (fm);
+    return -1;
+  }
+  return 0;
+}
+
+
+void pfolsm_fmm_destroy (pfolsm_fmm_t * fm)
+{
+  free (fm->dist);
+  free (fm->state);
+  free (fm->pos);
+  free (fm->heap);
+  fm->dist = 0;
+  fm->state = 0;
+  fm->pos = 0;
+  fm->heap = 0;
+}
+
+
+static void sift_up (pfolsm_fmm_t * fm, size_t hh)
+{
+  struct pfolsm_fmm_node_s const node = fm->heap[hh];
+  while (hh > 0) {
+    size_t const parent = (hh - 1) / 2;
+    if (fm->heap[parent].key <= node.key) {
+      break;
+    }
+    fm->heap[hh] = fm->heap[parent];
+    fm->pos[fm->heap[hh].idx] = hh;
+    hh = parent;
+  }
+  fm->heap[hh] = node;
+  fm->pos[node.idx] = hh;
+}
+
+
+static void sift_down (pfolsm_fmm_t * fm, size_t hh)
+{
+  struct pfolsm_fmm_node_s const node = fm->heap[hh];
+  for (;;) {
+    size_t child = 2 * hh + 1;
+    if (child >= fm->nheap) {
+      break;
+    }
+    if (child + 1 < fm->nheap && fm->heap[child + 1].key < fm->heap[child].key) {
+      ++child;
+    }
+    if (node.key <= fm->heap[child].key) {
+      break;
+    }
+    fm->heap[hh] = fm->heap[child];
+    fm->pos[fm->heap[hh].idx] = hh;
+    hh = child;
+  }
+  fm->heap[hh] = node;
+  fm->pos[node.idx] = hh;
+}
+
+
+int _pfolsm_fmm_offer (pfolsm_fmm_t * fm, size_t idx, double key)
+{
+  if (TRIAL == fm->state[idx]) {
+    size_t const hh = fm->pos[idx];
+    if (key < fm->heap[hh].key) {
+      fm->heap[hh].key = key;
+      sift_up (fm, hh);
+    }
+    return 0;
+  }
+  if (fm->nheap >= fm->heapcap) {
+    size_t const nc = 2 * fm->heapcap;
+    struct pfolsm_fmm_node_s * nh = realloc (fm->heap, nc * sizeof(*nh));
+    if (0 == nh) {
+      return -1;
+    }
+    fm->heap = nh;
+    fm->heapcap = nc;
+  }
+  fm->state[idx] = TRIAL;
+  fm->heap[fm->nheap].key = key;
+  fm->heap[fm->nheap].idx = idx;
+  sift_up (fm, fm->nheap++);
+  return 0;
+}
+
+
+struct pfolsm_fmm_node_s _pfolsm_fmm_pop (pfolsm_fmm_t * fm)
+{
+  struct pfolsm_fmm_node_s const top = fm->heap[0];
+  if (--fm->nheap > 0) {
+    fm->heap[0] = fm->heap[fm->nheap];
+    sift_down (fm, 0);
+  }
+  return top;
+}
+
+
+static double speed_at (pfolsm_t const * pp, size_t idx)
+{
+  return pp->fspeed ? pp->fspeed[idx] : pp->speed[idx];
+}
+
+
+/**
+   First order upwind solution of |grad T| = 1 / speed at idx, using
+   only known neighbors.
+*/
+static double solve (pfolsm_fmm_t const * fm, double const * tt, size_t idx, double speed)
+{
+  double const rs = 1.0 / speed;
+  double aa = INFINITY, bb = INFINITY;
+  
+  if (KNOWN == fm->state[idx - 1]) {
+    aa = tt[idx - 1];
+  }
+  if (KNOWN == fm->state[idx + 1] && tt[idx + 1] < aa) {
+    aa = tt[idx + 1];
+  }
+  if (KNOWN == fm->state[idx - fm->nx]) {
+    bb = tt[idx - fm->nx];
+  }
+  if (KNOWN == fm->state[idx + fm->nx] && tt[idx + fm->nx] < bb) {
+    bb = tt[idx + fm->nx];
+  }
+  if (aa > bb) {
+    double const tmp = aa;
+    aa = bb;
+    bb = tmp;
+  }
+  if (bb - aa >= rs) {
+    return aa + rs;
+  }
+  return 0.5 * (aa + bb + sqrt (2.0 * rs * rs - (bb - aa) * (bb - aa)));
+}
+
+
+/**
+   Offer the non-known neighbors of a freshly known cell. A null pp
+   means unit speed.
+*/
+static int relax (pfolsm_fmm_t * fm, pfolsm_t const * pp, double const * tt, size_t idx)
+{
+  size_t const nbor[4] = { idx - 1, idx + 1, idx - fm->nx, idx + fm->nx };
+  size_t kk;
+  
+  for (kk = 0; kk < 4; ++kk) {
+    size_t const nn = nbor[kk];
+    double const speed = pp ? speed_at (pp, nn) : 1.0;
+    if (KNOWN == fm->state[nn] || ! (speed > 0.0)) {
+      continue;
+    }
+    if (0 != _pfolsm_fmm_offer (fm, nn, solve (fm, tt, nn, speed))) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+void _pfolsm_fmm_reset (pfolsm_fmm_t * fm, double * tt)
+{
+  size_t jj;
+  
+  fm->nheap = 0;
+  for (jj = 0; jj < fm->ntt; ++jj) {
+    tt[jj] = INFINITY;
+  }
+  memset (fm->state, KNOWN, fm->ntt);
+  for (jj = 1; jj <= fm->dimy; ++jj) {
+    memset (fm->state + jj * fm->nx + 1, FAR, fm->dimx);
+  }
+}
+
+
+/**
+   Known cells in increasing order of tt until the heap runs dry or
+   tt exceeds limit.
+*/
+static int march (pfolsm_fmm_t * fm, pfolsm_t const * pp, double * tt, double limit)
+{
+  while (fm->nheap > 0) {
+    struct pfolsm_fmm_node_s const top = _pfolsm_fmm_pop (fm);
+    if (top.key > limit) {
+      fm->state[top.idx] = FAR;
+      break;
+    }
+    fm->state[top.idx] = KNOWN;
+    tt[top.idx] = top.key;
+    if (0 != relax (fm, pp, tt, top.idx)) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+double _pfolsm_front_dist (pfolsm_t const * pp, size_t idx)
+{
+  double const p0 = pp->fphi ? pp->fphi[idx] : pp->phi[idx];
+  size_t const ii = idx % pp->nx;
+  size_t const jj = idx / pp->nx;
+  double dd[2] = { INFINITY, INFINITY };
+  size_t kk;
+  
+  for (kk = 0; kk < 4; ++kk) {
+    static int const di[4] = { -1, 1, 0, 0 };
+    static int const dj[4] = { 0, 0, -1, 1 };
+    size_t const ni = ii + di[kk];
+    size_t const nj = jj + dj[kk];
+    double p1, ff;
+    if (ni < 1 || ni > pp->dimx || nj < 1 || nj > pp->dimy) {
+      continue;
+    }
+    p1 = pfolsm_get (pp, ni, nj);
+    if ((p0 > 0.0) == (p1 > 0.0)) {
+      continue;
+    }
+    ff = p0 / (p0 - p1);
+    if (ff < dd[kk / 2]) {
+      dd[kk / 2] = ff;
+    }
+  }
+  
+  if (isinf (dd[0])) {
+    return dd[1];
+  }
+  if (isinf (dd[1]) || 0.0 == dd[0] || 0.0 == dd[1]) {
+    return dd[0] < dd[1] ? dd[0] : dd[1];
+  }
+  return dd[0] * dd[1] / sqrt (dd[0] * dd[0] + dd[1] * dd[1]);
+}
+
+
+int pfolsm_fmm_arrival (pfolsm_fmm_t * fm, pfolsm_t const * pp,
+			size_t const * seed, size_t nseed,
+			double * arrival)
+{
+  size_t ii, jj;
+  
+  _pfolsm_fmm_reset (fm, arrival);
+  
+  if (nseed > 0) {
+    for (ii = 0; ii < nseed; ++ii) {
+      fm->state[seed[ii]] = KNOWN;
+      arrival[seed[ii]] = 0.0;
+    }
+    for (ii = 0; ii < nseed; ++ii) {
+      if (0 != relax (fm, pp, arrival, seed[ii])) {
+	return -1;
+      }
+    }
+    return march (fm, pp, arrival, INFINITY);
+  }
+  
+  // Start from the zero level: the inside has been reached already,
+  // and the first outside layer is fixed by interpolation.
+  
+  for (jj = 1; jj <= pp->dimy; ++jj) {
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      size_t const idx = ii + jj * pp->nx;
+      double const speed = speed_at (pp, idx);
+      double dd;
+      if (pfolsm_get (pp, ii, jj) <= 0.0) {
+	fm->state[idx] = KNOWN;
+	arrival[idx] = 0.0;
+      }
+      else if (speed > 0.0 && isfinite (dd = _pfolsm_front_dist (pp, idx))) {
+	fm->state[idx] = KNOWN;
+	arrival[idx] = dd / speed;
+      }
+    }
+  }
+  for (jj = 1; jj <= pp->dimy; ++jj) {
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      size_t const idx = ii + jj * pp->nx;
+      if (arrival[idx] > 0.0 && isfinite (arrival[idx])
+	  && 0 != relax (fm, pp, arrival, idx)) {
+	return -1;
+      }
+    }
+  }
+  return march (fm, pp, arrival, INFINITY);
+}
+
+
+int pfolsm_fmm_reinit (pfolsm_fmm_t * fm, pfolsm_t * pp, double width)
+{
+  double const limit = width > 0.0 ? width : INFINITY;
+  size_t ii, jj, nfront;
+  
+  _pfolsm_fmm_reset (fm, fm->dist);
+  
+  // Both sides march outward from the cells next to the zero level,
+  // which keep their interpolated distance.
+  
+  nfront = 0;
+  for (jj = 1; jj <= pp->dimy; ++jj) {
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      size_t const idx = ii + jj * pp->nx;
+      double const dd = _pfolsm_front_dist (pp, idx);
+      if (isfinite (dd)) {
+	fm->state[idx] = KNOWN;
+	fm->dist[idx] = dd;
+	++nfront;
+      }
+    }
+  }
+  if (0 == nfront) {
+    return 0;
+  }
+  for (jj = 1; jj <= pp->dimy; ++jj) {
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      size_t const idx = ii + jj * pp->nx;
+      if (isfinite (fm->dist[idx]) && 0 != relax (fm, 0, fm->dist, idx)) {
+	return -1;
+      }
+    }
+  }
+  if (0 != march (fm, 0, fm->dist, limit)) {
+    return -1;
+  }
+  
+  for (jj = 1; jj <= pp->dimy; ++jj) {
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      double const dd = fm->dist[ii + jj * pp->nx];
+      double const mag = dd < limit ? dd : width;
+      pfolsm_set (pp, ii, jj, pfolsm_get (pp, ii, jj) > 0.0 ? mag : - mag);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_FMM_H
+#define PFOLSM_FMM_H
+
+#include "pfolsm.h"
+
+
+/** Cell states of pfolsm_fmm_t. */
+#define PFOLSM_FMM_FAR   0
+#define PFOLSM_FMM_TRIAL 1
+#define PFOLSM_FMM_KNOWN 2
+
+
+/** Entry of the binary heap of trial cells. */
+struct pfolsm_fmm_node_s {
+  double key;
+  size_t idx;
+};
+
+
+/**
+   Workspace of the fast marching method, sized for one grid and
+   reusable across calls. The heap keeps the key next to the cell
+   index so sifting never touches the planes, and pos maps each trial
+   cell back to its heap slot for decrease-key.
+*/
+struct pfolsm_fmm_s {
+  size_t dimx, dimy, nx, ntt;
+  double * dist;		/* unsigned distance for reinitialization */
+  unsigned char * state;	/* far, trial, or known */
+  size_t * pos;
+  struct pfolsm_fmm_node_s * heap;
+  size_t nheap, heapcap;
+};
+
+typedef struct pfolsm_fmm_s pfolsm_fmm_t;
+
+
+/** Allocate a workspace for grids of the same size as pp. */
+int pfolsm_fmm_create (pfolsm_fmm_t * fm, pfolsm_t const * pp);
+
+void pfolsm_fmm_destroy (pfolsm_fmm_t * fm);
+
+/**
+   First arrival times of a front that starts at the given seed cells
+   (indices like those of the planes of pp) at time zero and moves
+   outward with the speed of pp, solving |grad T| speed = 1 in
+   O(N log N). Cells with speed <= 0 are never reached. With nseed 0,
+   the front is the zero level of phi instead: cells with phi <= 0
+   arrive at zero and cells next to them at the interpolated distance
+   divided by their speed. Writes all pp->ntt entries of arrival,
+   with INFINITY for unreachable and ghost cells.
+*/
+int pfolsm_fmm_arrival (pfolsm_fmm_t * fm, pfolsm_t const * pp,
+			size_t const * seed, size_t nseed,
+			double * arrival);
+
+/**
+   Replace phi by the signed distance to its zero level, which stays
+   where it is to within the accuracy of linear interpolation. With
+   width > 0, marching stops at that distance and farther cells get
+   +/- width. Does nothing if phi has no zero level.
+*/
+int pfolsm_fmm_reinit (pfolsm_fmm_t * fm, pfolsm_t * pp, double width);
+
+
+/**
+   Distance from the center of cell idx to the zero level of phi,
+   interpolated linearly towards each neighbor across which phi
+   changes sign, or INFINITY if there is no such neighbor.
+*/
+double _pfolsm_front_dist (pfolsm_t const * pp, size_t idx);
+
+
+/** Insert a far cell, or lower the key of a trial cell. */
+int _pfolsm_fmm_offer (pfolsm_fmm_t * fm, size_t idx, double key);
+
+/** Remove the trial cell with the smallest key. */
+struct pfolsm_fmm_node_s _pfolsm_fmm_pop (pfolsm_fmm_t * fm);
+
+/**
+   Empty the heap and set all of tt to INFINITY. Ghost cells count as
+   known but infinitely far, everything else starts out far.
+*/
+void _pfolsm_fmm_reset (pfolsm_fmm_t * fm, double * tt);
+
+
+#endif
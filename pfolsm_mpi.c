@@ -0,0 +1,499 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pfolsm_mpi.h"
+
+#include <stddef.h>
+
+
+/* offsets of the sides and corners W, E, S, N, SW, SE, NW, NE */
+static int const dirx[PFOLSM_MPI_NDIR] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+static int const diry[PFOLSM_MPI_NDIR] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+static int const opposite[PFOLSM_MPI_NDIR] = { 1, 0, 3, 2, 7, 6, 5, 4 };
+
+#define PFOLSM_MPI_W 0
+#define PFOLSM_MPI_E 1
+#define PFOLSM_MPI_S 2
+#define PFOLSM_MPI_N 3
+
+
+/**
+   Range along one axis of what goes out to, or comes in from, the
+   neighbor in direction dd (-1, 0, or +1) with nn interior cells.
+*/
+static void strip (int dd, size_t nn, size_t depth, int in, ptrdiff_t * lo, ptrdiff_t * cnt)
+{
+  if (0 == dd) {
+    *lo = 1;
+    *cnt = nn;
+  }
+  else if (dd < 0) {
+    *lo = in ? 1 - (ptrdiff_t) depth : 1;
+    *cnt = depth;
+  }
+  else {
+    *lo = in ? (ptrdiff_t) nn + 1 : (ptrdiff_t) (nn - depth + 1);
+    *cnt = depth;
+  }
+}
+
+
+static int make_types (pfolsm_mpi_t * pm)
+{
+  pfolsm_t const * pp = &pm->local;
+  ptrdiff_t i0, j0, ni, nj;
+  int dir, in;
+  
+  for (dir = 0; dir < PFOLSM_MPI_NDIR; ++dir) {
+    for (in = 0; in <= 1; ++in) {
+      MPI_Datatype * type = in ? pm->recv + dir : pm->send + dir;
+      strip (dirx[dir], pp->dimx, pm->depth, in, &i0, &ni);
+      strip (diry[dir], pp->dimy, pm->depth, in, &j0, &nj);
+      if (MPI_SUCCESS != MPI_Type_vector (nj, ni, pp->nx, MPI_DOUBLE, type)
+	  || MPI_SUCCESS != MPI_Type_commit (type)) {
+	return -1;
+      }
+      if (in) {
+	pm->recvoff[dir] = i0 + j0 * (ptrdiff_t) pp->nx;
+      }
+      else {
+	pm->sendoff[dir] = i0 + j0 * (ptrdiff_t) pp->nx;
+      }
+    }
+  }
+  return 0;
+}
+
+
+int pfolsm_mpi_create (pfolsm_mpi_t * pm,
+		       MPI_Comm comm,
+		       size_t gdimx,
+		       size_t gdimy,
+		       size_t depth)
+{
+  int const periods[2] = { 0, 0 };
+  size_t i0, i1, j0, j1;
+  int ok, allok, dir, tmp;
+  
+  MPI_Comm_size (comm, &pm->nrank);
+  pm->dims[0] = 0;
+  pm->dims[1] = 0;
+  MPI_Dims_create (pm->nrank, 2, pm->dims);
+  if ((gdimx < gdimy) != (pm->dims[0] < pm->dims[1])) {
+    tmp = pm->dims[0];
+    pm->dims[0] = pm->dims[1];
+    pm->dims[1] = tmp;
+  }
+  if (MPI_SUCCESS != MPI_Cart_create (comm, 2, pm->dims, periods, 0, &pm->comm)) {
+    return -1;
+  }
+  MPI_Comm_rank (pm->comm, &pm->rank);
+  MPI_Cart_coords (pm->comm, pm->rank, 2, pm->coords);
+  
+  pm->gdimx = gdimx;
+  pm->gdimy = gdimy;
+  pm->depth = depth;
+  pm->speed_halo = 0;
+  _pfolsm_split (gdimx, pm->coords[0], pm->dims[0], &i0, &i1);
+  _pfolsm_split (gdimy, pm->coords[1], pm->dims[1], &j0, &j1);
+  pm->x0 = i0 - 1;
+  pm->y0 = j0 - 1;
+  
+  // Every rank has to agree on failure, or the others would wait for
+  // it in the first exchange.
+  
+  ok = depth >= 1 && i1 >= i0 + depth && j1 >= j0 + depth
+    && 0 == pfolsm_create_ng (&pm->local, i1 - i0 + 1, j1 - j0 + 1, 0, depth);
+  for (dir = 0; dir < PFOLSM_MPI_NDIR; ++dir) {
+    pm->send[dir] = MPI_DATATYPE_NULL;
+    pm->recv[dir] = MPI_DATATYPE_NULL;
+  }
+  if (ok && 0 != make_types (pm)) {
+    pfolsm_mpi_destroy (pm);
+    ok = 0;
+  }
+  MPI_Allreduce (&ok, &allok, 1, MPI_INT, MPI_MIN, comm);
+  if ( ! allok) {
+    if (ok) {
+      pfolsm_mpi_destroy (pm);
+    }
+    else if (MPI_COMM_NULL != pm->comm) {
+      MPI_Comm_free (&pm->comm);
+    }
+    return -1;
+  }
+  
+  for (dir = 0; dir < PFOLSM_MPI_NDIR; ++dir) {
+    int const nc[2] = { pm->coords[0] + dirx[dir], pm->coords[1] + diry[dir] };
+    if (nc[0] < 0 || nc[0] >= pm->dims[0] || nc[1] < 0 || nc[1] >= pm->dims[1]) {
+      pm->nbr[dir] = MPI_PROC_NULL;
+    }
+    else {
+      MPI_Cart_rank (pm->comm, nc, pm->nbr + dir);
+    }
+  }
+  
+  return 0;
+}
+
+
+void pfolsm_mpi_destroy (pfolsm_mpi_t * pm)
+{
+  int dir;
+  
+  for (dir = 0; dir < PFOLSM_MPI_NDIR; ++dir) {
+    if (MPI_DATATYPE_NULL != pm->send[dir]) {
+      MPI_Type_free (pm->send + dir);
+    }
+    if (MPI_DATATYPE_NULL != pm->recv[dir]) {
+      MPI_Type_free (pm->recv + dir);
+    }
+  }
+  MPI_Comm_free (&pm->comm);
+  pfolsm_destroy (&pm->local);
+}
+
+
+int pfolsm_mpi_owns (pfolsm_mpi_t const * pm, size_t gi, size_t gj)
+{
+  return gi > pm->x0 && gi <= pm->x0 + pm->local.dimx
+    && gj > pm->y0 && gj <= pm->y0 + pm->local.dimy;
+}
+
+
+int pfolsm_mpi_set (pfolsm_mpi_t * pm, size_t gi, size_t gj, double phi, double speed)
+{
+  size_t idx;
+  
+  if ( ! pfolsm_mpi_owns (pm, gi, gj)) {
+    return -1;
+  }
+  idx = gi - pm->x0 + (gj - pm->y0) * pm->local.nx;
+  pm->local.phi[idx] = phi;
+  pm->local.speed[idx] = speed;
+  pm->speed_halo = 0;
+  return 0;
+}
+
+
+static void exchange_start (pfolsm_mpi_t * pm, double * plane)
+{
+  int dir;
+  
+  for (dir = 0; dir < PFOLSM_MPI_NDIR; ++dir) {
+    MPI_Irecv (plane + pm->recvoff[dir], 1, pm->recv[dir], pm->nbr[dir], opposite[dir],
+	       pm->comm, pm->req + dir);
+  }
+  for (dir = 0; dir < PFOLSM_MPI_NDIR; ++dir) {
+    MPI_Isend (plane + pm->sendoff[dir], 1, pm->send[dir], pm->nbr[dir], dir,
+	       pm->comm, pm->req + PFOLSM_MPI_NDIR + dir);
+  }
+}
+
+
+static int exchange_finish (pfolsm_mpi_t * pm)
+{
+  return MPI_SUCCESS == MPI_Waitall (2 * PFOLSM_MPI_NDIR, pm->req, MPI_STATUSES_IGNORE) ? 0 : -1;
+}
+
+
+/**
+   Mirror the first ghost layer along the sides that are on the
+   global border, for the rows and columns of the rectangle i0..i1 by
+   j0..j1 that is about to be updated. Same as _pfolsm_cbounds_plane
+   with one layer.
+*/
+static void mirror (pfolsm_mpi_t const * pm, ptrdiff_t i0, ptrdiff_t i1, ptrdiff_t j0, ptrdiff_t j1)
+{
+  pfolsm_t const * pp = &pm->local;
+  ptrdiff_t const nx = pp->nx;
+  ptrdiff_t const dimx = pp->dimx;
+  ptrdiff_t const dimy = pp->dimy;
+  double * const phi = pp->phi;
+  ptrdiff_t ii, jj;
+  
+  if (MPI_PROC_NULL == pm->nbr[PFOLSM_MPI_S]) {
+    for (ii = i0; ii <= i1; ++ii) {
+      phi[ii] = phi[ii + 2 * nx];
+    }
+  }
+  if (MPI_PROC_NULL == pm->nbr[PFOLSM_MPI_N]) {
+    for (ii = i0; ii <= i1; ++ii) {
+      phi[ii + (dimy + 1) * nx] = phi[ii + (dimy - 1) * nx];
+    }
+  }
+  for (jj = j0; jj <= j1; ++jj) {
+    if (MPI_PROC_NULL == pm->nbr[PFOLSM_MPI_W]) {
+      phi[jj * nx] = phi[2 + jj * nx];
+    }
+    if (MPI_PROC_NULL == pm->nbr[PFOLSM_MPI_E]) {
+      phi[dimx + 1 + jj * nx] = phi[dimx - 1 + jj * nx];
+    }
+  }
+}
+
+
+static void update_rect (pfolsm_t * pp, double dt,
+			 ptrdiff_t i0, ptrdiff_t i1, ptrdiff_t j0, ptrdiff_t j1)
+{
+  ptrdiff_t jj;
+  
+  for (jj = j0; i0 <= i1 && jj <= j1; ++jj) {
+    ptrdiff_t const off = i0 + jj * (ptrdiff_t) pp->nx;
+    pp->row (pp->phi + off, pp->speed + off, pp->phinext + off, i1 - i0 + 1, pp->nx, dt);
+  }
+}
+
+
+static double rate_rect (pfolsm_t const * pp,
+			 ptrdiff_t i0, ptrdiff_t i1, ptrdiff_t j0, ptrdiff_t j1)
+{
+  double rmax = 0.0;
+  ptrdiff_t jj;
+  
+  for (jj = j0; i0 <= i1 && jj <= j1; ++jj) {
+    double const rr = _pfolsm_rate_span (pp, i0 + jj * pp->nx, i1 - i0 + 1);
+    if (rr > rmax) {
+      rmax = rr;
+    }
+  }
+  return rmax;
+}
+
+
+/**
+   The cells of i0..i1 by j0..j1 that need some ghost cell, which is
+   everything outside of 2..dimx-1 by 2..dimy-1.
+*/
+static void update_frame (pfolsm_t * pp, double dt,
+			  ptrdiff_t i0, ptrdiff_t i1, ptrdiff_t j0, ptrdiff_t j1)
+{
+  ptrdiff_t const dimx = pp->dimx;
+  ptrdiff_t const dimy = pp->dimy;
+  
+  update_rect (pp, dt, i0, i1, j0, 1);
+  update_rect (pp, dt, i0, i1, dimy, j1);
+  update_rect (pp, dt, i0, 1, 2, dimy - 1);
+  update_rect (pp, dt, dimx, i1, 2, dimy - 1);
+}
+
+
+static double rate_frame (pfolsm_t const * pp)
+{
+  ptrdiff_t const dimx = pp->dimx;
+  ptrdiff_t const dimy = pp->dimy;
+  double const rr[4] = {
+    rate_rect (pp, 1, dimx, 1, 1),
+    rate_rect (pp, 1, dimx, dimy, dimy),
+    rate_rect (pp, 1, 1, 2, dimy - 1),
+    rate_rect (pp, dimx, dimx, 2, dimy - 1)
+  };
+  double rmax = 0.0;
+  int kk;
+  
+  for (kk = 0; kk < 4; ++kk) {
+    if (rr[kk] > rmax) {
+      rmax = rr[kk];
+    }
+  }
+  return rmax;
+}
+
+
+static void make_speed_halo (pfolsm_mpi_t * pm)
+{
+  if ( ! pm->speed_halo) {
+    exchange_start (pm, pm->local.speed);
+    exchange_finish (pm);
+    pm->speed_halo = 1;
+  }
+}
+
+
+static void swap (pfolsm_t * pp, double dt)
+{
+  double * tmp = pp->phi;
+  pp->phi = pp->phinext;
+  pp->phinext = tmp;
+  pp->time += dt;
+  pp->dt = dt;
+}
+
+
+int pfolsm_mpi_advance (pfolsm_mpi_t * pm, double dt, size_t nsteps)
+{
+  pfolsm_t * pp = &pm->local;
+  ptrdiff_t const dimx = pp->dimx;
+  ptrdiff_t const dimy = pp->dimy;
+  
+  make_speed_halo (pm);
+  
+  while (nsteps > 0) {
+    size_t const depth = nsteps < pm->depth ? nsteps : pm->depth;
+    size_t step;
+    
+    exchange_start (pm, pp->phi);
+    for (step = 1; step <= depth; ++step) {
+      
+      // After step steps, the cells up to depth - step into the halo
+      // of an inner side are still exact.
+      
+      ptrdiff_t const ext = depth - step;
+      ptrdiff_t const i0 = MPI_PROC_NULL == pm->nbr[PFOLSM_MPI_W] ? 1 : 1 - ext;
+      ptrdiff_t const i1 = MPI_PROC_NULL == pm->nbr[PFOLSM_MPI_E] ? dimx : dimx + ext;
+      ptrdiff_t const j0 = MPI_PROC_NULL == pm->nbr[PFOLSM_MPI_S] ? 1 : 1 - ext;
+      ptrdiff_t const j1 = MPI_PROC_NULL == pm->nbr[PFOLSM_MPI_N] ? dimy : dimy + ext;
+      
+      if (1 == step) {
+	update_rect (pp, dt, 2, dimx - 1, 2, dimy - 1);
+	if (0 != exchange_finish (pm)) {
+	  return -1;
+	}
+	mirror (pm, i0, i1, j0, j1);
+	update_frame (pp, dt, i0, i1, j0, j1);
+      }
+      else {
+	mirror (pm, i0, i1, j0, j1);
+	update_rect (pp, dt, i0, i1, j0, j1);
+      }
+      swap (pp, dt);
+    }
+    nsteps -= depth;
+  }
+  
+  return 0;
+}
+
+
+int pfolsm_mpi_update_cfl (pfolsm_mpi_t * pm, double cfl, double * dt_out)
+{
+  pfolsm_t * pp = &pm->local;
+  ptrdiff_t const dimx = pp->dimx;
+  ptrdiff_t const dimy = pp->dimy;
+  double rmax, rr, gmax, dt;
+  
+  make_speed_halo (pm);
+  
+  exchange_start (pm, pp->phi);
+  rmax = rate_rect (pp, 2, dimx - 1, 2, dimy - 1);
+  if (0 != exchange_finish (pm)) {
+    return -1;
+  }
+  mirror (pm, 1, dimx, 1, dimy);
+  rr = rate_frame (pp);
+  if (rr > rmax) {
+    rmax = rr;
+  }
+  if (MPI_SUCCESS != MPI_Allreduce (&rmax, &gmax, 1, MPI_DOUBLE, MPI_MAX, pm->comm)) {
+    return -1;
+  }
+  
+  dt = gmax > 0.0 ? cfl / gmax : cfl;
+  update_rect (pp, dt, 1, dimx, 1, dimy);
+  swap (pp, dt);
+  if (dt_out) {
+    *dt_out = dt;
+  }
+  return 0;
+}
+
+
+int pfolsm_mpi_gather (pfolsm_mpi_t const * pm, double * global, int root)
+{
+  pfolsm_t const * pp = &pm->local;
+  size_t const nown = pp->dimx * pp->dimy;
+  double * own, * all = 0;
+  int * count = 0, * displ = 0;
+  size_t ii, jj;
+  int rank, status = 0;
+  
+  own = malloc (nown * sizeof(double));
+  if (pm->rank == root) {
+    all = malloc (pm->gdimx * pm->gdimy * sizeof(double));
+    count = malloc (pm->nrank * sizeof(int));
+    displ = malloc (pm->nrank * sizeof(int));
+  }
+  if (0 == own || (pm->rank == root && (0 == all || 0 == count || 0 == displ))) {
+    status = -1;
+  }
+  
+  // Block by block, in rank order, each block row-major.
+  
+  for (jj = 1; own && jj <= pp->dimy; ++jj) {
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      own[ii - 1 + (jj - 1) * pp->dimx] = pp->phi[ii + jj * pp->nx];
+    }
+  }
+  if (pm->rank == root && 0 == status) {
+    int off = 0;
+    for (rank = 0; rank < pm->nrank; ++rank) {
+      int cc[2];
+      size_t i0, i1, j0, j1;
+      MPI_Cart_coords (pm->comm, rank, 2, cc);
+      _pfolsm_split (pm->gdimx, cc[0], pm->dims[0], &i0, &i1);
+      _pfolsm_split (pm->gdimy, cc[1], pm->dims[1], &j0, &j1);
+      count[rank] = (i1 - i0 + 1) * (j1 - j0 + 1);
+      displ[rank] = off;
+      off += count[rank];
+    }
+  }
+  MPI_Allreduce (MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, pm->comm);
+  if (0 == status) {
+    MPI_Gatherv (own, nown, MPI_DOUBLE, all, count, displ, MPI_DOUBLE, root, pm->comm);
+  }
+  
+  if (pm->rank == root && 0 == status) {
+    for (rank = 0; rank < pm->nrank; ++rank) {
+      int cc[2];
+      size_t i0, i1, j0, j1, nn = 0;
+      MPI_Cart_coords (pm->comm, rank, 2, cc);
+      _pfolsm_split (pm->gdimx, cc[0], pm->dims[0], &i0, &i1);
+      _pfolsm_split (pm->gdimy, cc[1], pm->dims[1], &j0, &j1);
+      for (jj = j0; jj <= j1; ++jj) {
+	for (ii = i0; ii <= i1; ++ii) {
+	  global[ii - 1 + (jj - 1) * pm->gdimx] = all[displ[rank] + nn++];
+	}
+      }
+    }
+  }
+  
+  free (own);
+  free (all);
+  free (count);
+  free (displ);
+  return status;
+}
@@ -0,0 +1,123 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_MPI_H
+#define PFOLSM_MPI_H
+
+#include "pfolsm.h"
+
+#include <mpi.h>
+
+
+/*
+ * Domain decomposition over MPI. Each rank owns a block of the
+ * global grid as a pfolsm_t whose ghost layers are filled from the
+ * neighboring blocks instead of by _pfolsm_cbounds, except along the
+ * border of the global grid, where they mirror like in the dense
+ * engine. With a halo of depth cells, one exchange serves up to depth
+ * steps, each computing one cell less into the halo (temporal
+ * blocking). The interior cells that do not need the halo are updated
+ * while the exchange is in flight. Every cell ends up bit-identical
+ * to a single dense pfolsm_t of the global size.
+ */
+
+/** Sides and corners, in the order of pfolsm_mpi_s::nbr. */
+#define PFOLSM_MPI_NDIR 8
+
+
+struct pfolsm_mpi_s {
+  MPI_Comm comm;		/* Cartesian, owned */
+  int rank, nrank;
+  int dims[2];			/* ranks along x and y */
+  int coords[2];
+  int nbr[PFOLSM_MPI_NDIR];	/* MPI_PROC_NULL past the global border */
+  size_t gdimx, gdimy;		/* global interior */
+  size_t x0, y0;		/* global ii, jj of local cell 0 */
+  size_t depth;			/* halo width, steps per exchange */
+  pfolsm_t local;		/* ng = depth */
+  MPI_Datatype send[PFOLSM_MPI_NDIR];
+  MPI_Datatype recv[PFOLSM_MPI_NDIR];
+  ptrdiff_t sendoff[PFOLSM_MPI_NDIR];
+  ptrdiff_t recvoff[PFOLSM_MPI_NDIR];
+  MPI_Request req[2 * PFOLSM_MPI_NDIR];
+  int speed_halo;		/* speed halo is up to date */
+};
+
+typedef struct pfolsm_mpi_s pfolsm_mpi_t;
+
+
+/**
+   Collective over comm: split a gdimx by gdimy grid into one block per
+   rank, with halos of depth cells. Every block needs at least
+   depth + 1 cells along each side. Returns -1 on all ranks if any of
+   them fails.
+*/
+int pfolsm_mpi_create (pfolsm_mpi_t * pm,
+		       MPI_Comm comm,
+		       size_t gdimx,
+		       size_t gdimy,
+		       size_t depth);
+
+void pfolsm_mpi_destroy (pfolsm_mpi_t * pm);
+
+/** Whether the global cell (gi, gj), 1-based, belongs to this rank. */
+int pfolsm_mpi_owns (pfolsm_mpi_t const * pm, size_t gi, size_t gj);
+
+/**
+   Set phi and speed of a global cell, if this rank owns it. Returns
+   0 if it does, -1 otherwise.
+*/
+int pfolsm_mpi_set (pfolsm_mpi_t * pm, size_t gi, size_t gj, double phi, double speed);
+
+/** Collective: nsteps of pfolsm_update on the global grid. */
+int pfolsm_mpi_advance (pfolsm_mpi_t * pm, double dt, size_t nsteps);
+
+/**
+   Collective: one step of pfolsm_update_cfl on the global grid, with
+   the rate reduced over all ranks, so every rank uses the same dt.
+*/
+int pfolsm_mpi_update_cfl (pfolsm_mpi_t * pm, double cfl, double * dt_out);
+
+/**
+   Collective: copy the interior of every block into global at root,
+   which needs gdimx * gdimy entries with (gi, gj) at gi - 1 + (gj - 1)
+   * gdimx. Other ranks may pass null.
+*/
+int pfolsm_mpi_gather (pfolsm_mpi_t const * pm, double * global, int root);
+
+
+#endif
@@ -0,0 +1,406 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Narrow band mode: only cells within a few cells of the zero level
+ * of phi are updated. Cells outside the band keep their value in both
+ * phi and phinext. The band is rebuilt around the current front when
+ * the front gets close to its edge, which only touches cells of the
+ * old and the new band, so the cost scales with the front length.
+ */
+
+#include "pfolsm.h"
+
+#include <string.h>
+#include <math.h>
+
+// Per cell band markers. Cells in the band store their distance to
+// the front (at most RADIUS_MAX) and have ENTER set if they were not
+// in the previous band.
+
+#define RADIUS_MAX 126
+#define OUTSIDE    0x7f
+#define ENTER      0x80
+#define OLDBAND    0xff
+
+
+static int grow (size_t ** arr, size_t * cap, size_t need)
+{
+  size_t nc;
+  size_t * na;
+  
+  if (need <= *cap) {
+    return 0;
+  }
+  nc = *cap ? *cap : 1024;
+  while (nc < need) {
+    nc *= 2;
+  }
+  na = realloc (*arr, nc * sizeof(**arr));
+  if (0 == na) {
+    return -1;
+  }
+  *arr = na;
+  *cap = nc;
+  return 0;
+}
+
+
+static int cmp_size (void const * aa, void const * bb)
+{
+  size_t const la = *(size_t const *) aa;
+  size_t const lb = *(size_t const *) bb;
+  return la < lb ? -1 : (la > lb);
+}
+
+
+/**
+   A cell is on the front if phi changes sign towards one of its
+   interior 4-neighbors.
+*/
+static int is_front (pfolsm_t const * pp, size_t idx)
+{
+  size_t const ii = idx % pp->nx;
+  size_t const jj = idx / pp->nx;
+  int const pos = pp->phi[idx] > 0.0;
+  
+  return (ii > 1         && pos != (pp->phi[idx - 1] > 0.0))
+    ||   (ii < pp->dimx  && pos != (pp->phi[idx + 1] > 0.0))
+    ||   (jj > 1         && pos != (pp->phi[idx - pp->nx] > 0.0))
+    ||   (jj < pp->dimy  && pos != (pp->phi[idx + pp->nx] > 0.0));
+}
+
+
+/**
+   Cells entering the band still have the value they had when they
+   were last updated, which can be far too large in magnitude now
+   that the front has come closer. Give them a chamfer distance
+   estimate from neighbors that already have good values instead.
+*/
+static void extrapolate (pfolsm_t * pp, size_t idx)
+{
+  pfolsm_nband_t const * nb = pp->nband;
+  int const pos = pp->phi[idx] > 0.0;
+  unsigned char const dd = nb->dist[idx] & OUTSIDE;
+  double best = fabs (pp->phi[idx]);
+  size_t ii, jj;
+  
+  for (jj = idx / pp->nx - 1; jj <= idx / pp->nx + 1; ++jj) {
+    for (ii = idx % pp->nx - 1; ii <= idx % pp->nx + 1; ++ii) {
+      size_t const nbr = ii + jj * pp->nx;
+      unsigned char const nd = nb->dist[nbr];
+      double cand;
+      if (ii < 1 || ii > pp->dimx || jj < 1 || jj > pp->dimy
+	  || OUTSIDE == nd
+	  || ((nd & ENTER) && OLDBAND != nd && (nd & OUTSIDE) >= dd)
+	  || pos != (pp->phi[nbr] > 0.0)) {
+	continue;
+      }
+      cand = fabs (pp->phi[nbr]) + ((ii == idx % pp->nx || jj == idx / pp->nx) ? 1.0 : M_SQRT2);
+      if (cand < best) {
+	best = cand;
+      }
+    }
+  }
+  
+  pp->phi[idx] = pos ? best : - best;
+  pp->phinext[idx] = pp->phi[idx];
+}
+
+
+int _pfolsm_nband_build (pfolsm_t * pp)
+{
+  pfolsm_nband_t * nb = pp->nband;
+  size_t ii, jj, head, nnew;
+  size_t * tmp;
+  
+  // Mark the old band and make sure that its cells are consistent in
+  // both buffers. Only the old band can contain the front, because
+  // nothing outside of it has changed since it was built. On the
+  // first call, everything counts as old band.
+  
+  nnew = 0;
+  if (0 == nb->nbuild) {
+    memset (nb->dist, OLDBAND, pp->ntt);
+    for (jj = 1; jj <= pp->dimy; ++jj) {
+      memcpy (pp->phinext + jj * pp->nx + 1, pp->phi + jj * pp->nx + 1,
+	      pp->dimx * sizeof(double));
+      for (ii = 1; ii <= pp->dimx; ++ii) {
+	if (is_front (pp, ii + jj * pp->nx)) {
+	  if (grow (&nb->next, &nb->nextcap, nnew + 1)) {
+	    return -1;
+	  }
+	  nb->next[nnew++] = ii + jj * pp->nx;
+	}
+      }
+    }
+  }
+  else {
+    for (ii = 0; ii < nb->ncell; ++ii) {
+      size_t const idx = nb->cell[ii];
+      nb->dist[idx] = OLDBAND;
+      pp->phinext[idx] = pp->phi[idx];
+    }
+    for (ii = 0; ii < nb->ncell; ++ii) {
+      if (is_front (pp, nb->cell[ii])) {
+	if (grow (&nb->next, &nb->nextcap, nnew + 1)) {
+	  return -1;
+	}
+	nb->next[nnew++] = nb->cell[ii];
+      }
+    }
+  }
+  
+  // Breadth-first dilation of the front cells, using the new cell
+  // list as the queue.
+  
+  for (ii = 0; ii < nnew; ++ii) {
+    nb->dist[nb->next[ii]] = 0;
+  }
+  for (head = 0; head < nnew; ++head) {
+    size_t const idx = nb->next[head];
+    size_t const ci = idx % pp->nx;
+    size_t const cj = idx / pp->nx;
+    unsigned char const dd = (nb->dist[idx] & OUTSIDE) + 1;
+    if (nb->dist[idx] & ENTER) {
+      extrapolate (pp, idx);
+    }
+    if (dd > nb->radius) {
+      continue;
+    }
+    if (grow (&nb->next, &nb->nextcap, nnew + 8)) {
+      return -1;
+    }
+    for (jj = cj - 1; jj <= cj + 1; ++jj) {
+      if (jj < 1 || jj > pp->dimy) {
+	continue;
+      }
+      for (ii = ci - 1; ii <= ci + 1; ++ii) {
+	size_t const nbr = ii + jj * pp->nx;
+	if (ii < 1 || ii > pp->dimx) {
+	  continue;
+	}
+	if (OLDBAND == nb->dist[nbr]) {
+	  nb->dist[nbr] = dd;
+	}
+	else if (OUTSIDE == nb->dist[nbr]) {
+	  nb->dist[nbr] = dd | ENTER;
+	}
+	else {
+	  continue;
+	}
+	nb->next[nnew++] = nbr;
+      }
+    }
+  }
+  
+  // Whatever is still marked as old band has dropped out of it.
+  
+  if (0 == nb->nbuild) {
+    for (ii = 0; ii < pp->ntt; ++ii) {
+      if (OLDBAND == nb->dist[ii]) {
+	nb->dist[ii] = OUTSIDE;
+      }
+    }
+  }
+  else {
+    for (ii = 0; ii < nb->ncell; ++ii) {
+      if (OLDBAND == nb->dist[nb->cell[ii]]) {
+	nb->dist[nb->cell[ii]] = OUTSIDE;
+      }
+    }
+  }
+  
+  tmp = nb->cell;
+  nb->cell = nb->next;
+  nb->next = tmp;
+  ii = nb->cellcap;
+  nb->cellcap = nb->nextcap;
+  nb->nextcap = ii;
+  nb->ncell = nnew;
+  
+  // Row-major order lets the update run the row kernel over spans of
+  // consecutive active cells.
+  
+  qsort (nb->cell, nb->ncell, sizeof(*nb->cell), cmp_size);
+  
+  nb->nspan = 0;
+  nb->nedge = 0;
+  for (ii = 0; ii < nb->ncell; ++ii) {
+    size_t const idx = nb->cell[ii];
+    nb->dist[idx] &= OUTSIDE;
+    if (0 == ii || idx != nb->cell[ii-1] + 1) {
+      if (grow (&nb->span, &nb->spancap, 2 * nb->nspan + 2)) {
+	return -1;
+      }
+      nb->span[2 * nb->nspan] = idx;
+      nb->span[2 * nb->nspan + 1] = 0;
+      ++nb->nspan;
+    }
+    ++nb->span[2 * nb->nspan - 1];
+    if (nb->dist[idx] + 2 >= nb->radius) {
+      if (grow (&nb->edge, &nb->edgecap, nb->nedge + 1)) {
+	return -1;
+      }
+      nb->edge[nb->nedge++] = idx;
+    }
+  }
+  
+  ++nb->nbuild;
+  
+  return 0;
+}
+
+
+void _pfolsm_nband_fused (pfolsm_t * pp, double dt)
+{
+  pfolsm_nband_t const * nb = pp->nband;
+  size_t const * span = nb->span;
+  size_t ii;
+  
+  for (ii = 0; ii < nb->nspan; ++ii, span += 2) {
+    pp->row (pp->phi + span[0], pp->speed + span[0], pp->phinext + span[0],
+	     span[1], pp->nx, dt);
+    if (pp->driftbuf) {
+      _pfolsm_drift_span (pp, span[0], span[1], pp->driftbuf);
+    }
+  }
+}
+
+
+void _pfolsm_nband_speed (pfolsm_t * pp)
+{
+  pfolsm_nband_t const * nb = pp->nband;
+  size_t const * span = nb->span;
+  size_t ii;
+  
+  for (ii = 0; ii < nb->nspan; ++ii, span += 2) {
+    _pfolsm_speed_span (pp, span[0], span[1], pp->speedbuf);
+  }
+}
+
+
+double _pfolsm_nband_rate (pfolsm_t const * pp)
+{
+  pfolsm_nband_t const * nb = pp->nband;
+  size_t const * span = nb->span;
+  double rmax = 0.0;
+  size_t ii;
+  
+  for (ii = 0; ii < nb->nspan; ++ii, span += 2) {
+    double const rr = _pfolsm_rate_span (pp, span[0], span[1]);
+    if (rr > rmax) {
+      rmax = rr;
+    }
+  }
+  return rmax;
+}
+
+
+int _pfolsm_nband_check (pfolsm_t * pp)
+{
+  pfolsm_nband_t const * nb = pp->nband;
+  size_t ii;
+  
+  for (ii = 0; ii < nb->nedge; ++ii) {
+    if (is_front (pp, nb->edge[ii])) {
+      return _pfolsm_nband_build (pp);
+    }
+  }
+  return 0;
+}
+
+
+static void nband_free (pfolsm_nband_t * nb)
+{
+  if (nb) {
+    free (nb->dist);
+    free (nb->cell);
+    free (nb->next);
+    free (nb->span);
+    free (nb->edge);
+    free (nb);
+  }
+}
+
+
+int pfolsm_nband (pfolsm_t * pp, double width)
+{
+  pfolsm_nband_t * nb;
+  
+  nband_free (pp->nband);
+  pp->nband = 0;
+  if (width <= 0.0) {
+    return 0;
+  }
+  if (pp->flags & (PFOLSM_DEBUG | PFOLSM_FLOAT | PFOLSM_MIXED | PFOLSM_WENO)) {
+    return -1;
+  }
+  
+  nb = calloc (1, sizeof(*nb));
+  if (0 == nb) {
+    return -1;
+  }
+  nb->radius = ceil (width);
+  if (nb->radius < 4) {
+    nb->radius = 4;
+  }
+  else if (nb->radius > RADIUS_MAX) {
+    nb->radius = RADIUS_MAX;
+  }
+  nb->dist = malloc (pp->ntt);
+  if (0 == nb->dist) {
+    free (nb);
+    return -1;
+  }
+  pp->nband = nb;
+  
+  if (0 != _pfolsm_nband_build (pp)) {
+    nband_free (nb);
+    pp->nband = 0;
+    return -1;
+  }
+  
+  return 0;
+}
+
+
+void _pfolsm_nband_destroy (pfolsm_t * pp)
+{
+  nband_free (pp->nband);
+  pp->nband = 0;
+}
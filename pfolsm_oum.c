@@ -0,0 +1,333 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Ordered upwind method on the grid of pfolsm_t. Instead of keeping
+ * an explicit list of accepted front segments, each accepted cell
+ * immediately pushes tentative times to all unknown cells within the
+ * update radius, through the segments it forms with its known
+ * neighbors. Cells far from the front keep their tentative time
+ * until they become adjacent to a known cell and enter the heap, so
+ * the work per accepted cell only depends on the radius.
+ */
+
+#include "pfolsm_oum.h"
+
+#include <math.h>
+
+#define FAR   PFOLSM_FMM_FAR
+#define TRIAL PFOLSM_FMM_TRIAL
+#define KNOWN PFOLSM_FMM_KNOWN
+
+
+struct oum_s {
+  pfolsm_fmm_t * fm;
+  pfolsm_t const * pp;
+  pfolsm_profile_t const * vel;
+  double * tt;
+  double radius;
+  int reach;			/* radius rounded up */
+};
+
+
+static double speed_at (pfolsm_t const * pp, size_t idx)
+{
+  return pp->fspeed ? pp->fspeed[idx] : pp->speed[idx];
+}
+
+
+/**
+   Time to reach (yi, yj) with speed factor sy, starting at time t0
+   from (xi, xj).
+*/
+static double travel (struct oum_s const * om, double t0, double xi, double xj,
+		      double yi, double yj, double sy)
+{
+  double const dx = yi - xi;
+  double const dy = yj - xj;
+  return t0 + sqrt (dx * dx + dy * dy) / (sy * pfolsm_profile_eval (om->vel, dx, dy));
+}
+
+
+/**
+   Whether the straight path from (xi, xj) to (yi, yj) stays clear of
+   cells with zero speed, sampled every half cell between the two
+   ends.
+*/
+static int visible (struct oum_s const * om, size_t xi, size_t xj, size_t yi, size_t yj)
+{
+  double const dx = (double) yi - (double) xi;
+  double const dy = (double) yj - (double) xj;
+  double const len = fabs (dx) > fabs (dy) ? fabs (dx) : fabs (dy);
+  int const nstep = 2 * (int) len;
+  int ss;
+  
+  for (ss = 1; ss < nstep; ++ss) {
+    size_t const ci = floor (xi + dx * ss / nstep + 0.5);
+    size_t const cj = floor (xj + dy * ss / nstep + 0.5);
+    if ( ! (speed_at (om->pp, ci + cj * om->fm->nx) > 0.0)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/**
+   Whether any interior cell within reach of (ii, jj) has zero speed.
+*/
+static int obstructed (struct oum_s const * om, size_t ii, size_t jj)
+{
+  pfolsm_fmm_t const * fm = om->fm;
+  int oi, oj;
+  
+  for (oj = - om->reach; oj <= om->reach; ++oj) {
+    size_t const yj = jj + oj;
+    if (yj < 1 || yj > fm->dimy) {
+      continue;
+    }
+    for (oi = - om->reach; oi <= om->reach; ++oi) {
+      size_t const yi = ii + oi;
+      if (yi >= 1 && yi <= fm->dimx && ! (speed_at (om->pp, yi + yj * fm->nx) > 0.0)) {
+	return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+
+/**
+   Smallest travel time to (yi, yj) from the segment between the
+   known cells a and b, with times interpolated linearly along it,
+   by golden section search.
+*/
+static double segment (struct oum_s const * om, size_t ia, size_t ja, double ta,
+		       size_t ib, size_t jb, double tb,
+		       double yi, double yj, double sy)
+{
+  static double const ratio = 0.6180339887498949;
+  double const di = (double) ib - (double) ia;
+  double const dj = (double) jb - (double) ja;
+  double lo = 0.0, hi = 1.0;
+  double aa = hi - ratio, bb = ratio;
+  double fa = travel (om, ta + aa * (tb - ta), ia + aa * di, ja + aa * dj, yi, yj, sy);
+  double fb = travel (om, ta + bb * (tb - ta), ia + bb * di, ja + bb * dj, yi, yj, sy);
+  int kk;
+  
+  for (kk = 0; kk < 16; ++kk) {
+    if (fa < fb) {
+      hi = bb;
+      bb = aa;
+      fb = fa;
+      aa = hi - ratio * (hi - lo);
+      fa = travel (om, ta + aa * (tb - ta), ia + aa * di, ja + aa * dj, yi, yj, sy);
+    }
+    else {
+      lo = aa;
+      aa = bb;
+      fa = fb;
+      bb = lo + ratio * (hi - lo);
+      fb = travel (om, ta + bb * (tb - ta), ia + bb * di, ja + bb * dj, yi, yj, sy);
+    }
+  }
+  return fa < fb ? fa : fb;
+}
+
+
+/**
+   Push the times that the freshly known cell idx implies to the
+   unknown cells around it, and offer its far neighbors to the heap.
+   Cells with zero speed are obstacles: with any of them within reach,
+   a cell is only updated from idx if the path from idx is clear, and
+   from a segment if the path from its other end is clear as well.
+*/
+static int accept (struct oum_s * om, size_t idx)
+{
+  static int const di[8] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+  static int const dj[8] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+  pfolsm_t const * pp = om->pp;
+  pfolsm_fmm_t * fm = om->fm;
+  size_t const nx = fm->nx;
+  size_t const ii = idx % nx;
+  size_t const jj = idx / nx;
+  double const t0 = om->tt[idx];
+  int const check = obstructed (om, ii, jj);
+  size_t nbor[8];
+  size_t nn, kk;
+  int oi, oj;
+  
+  nn = 0;
+  for (kk = 0; kk < 8; ++kk) {
+    size_t const ni = ii + di[kk];
+    size_t const nj = jj + dj[kk];
+    size_t const nidx = ni + nj * nx;
+    if (KNOWN == fm->state[nidx] && isfinite (om->tt[nidx])) {
+      nbor[nn++] = nidx;
+    }
+  }
+  
+  for (oj = - om->reach; oj <= om->reach; ++oj) {
+    size_t const yj = jj + oj;
+    if (yj < 1 || yj > fm->dimy) {
+      continue;
+    }
+    for (oi = - om->reach; oi <= om->reach; ++oi) {
+      size_t const yi = ii + oi;
+      size_t const yidx = yi + yj * nx;
+      double sy, best;
+      if (yi < 1 || yi > fm->dimx || KNOWN == fm->state[yidx]
+	  || oi * oi + oj * oj > om->radius * om->radius
+	  || ! ((sy = speed_at (pp, yidx)) > 0.0)
+	  || (check && ! visible (om, ii, jj, yi, yj))) {
+	continue;
+      }
+      best = travel (om, t0, ii, jj, yi, yj, sy);
+      for (kk = 0; kk < nn; ++kk) {
+	size_t const ki = nbor[kk] % nx;
+	size_t const kj = nbor[kk] / nx;
+	double ts;
+	if (check && ! visible (om, ki, kj, yi, yj)) {
+	  continue;
+	}
+	ts = segment (om, ii, jj, t0, ki, kj, om->tt[nbor[kk]], yi, yj, sy);
+	if (ts < best) {
+	  best = ts;
+	}
+      }
+      if (best < om->tt[yidx]) {
+	om->tt[yidx] = best;
+	if (TRIAL == fm->state[yidx] && 0 != _pfolsm_fmm_offer (fm, yidx, best)) {
+	  return -1;
+	}
+      }
+    }
+  }
+  
+  for (kk = 0; kk < 8; ++kk) {
+    size_t const nidx = ii + di[kk] + (jj + dj[kk]) * nx;
+    if (FAR == fm->state[nidx] && isfinite (om->tt[nidx])
+	&& 0 != _pfolsm_fmm_offer (fm, nidx, om->tt[nidx])) {
+      return -1;
+    }
+  }
+  
+  return 0;
+}
+
+
+/**
+   Update radius for the anisotropy ratio of vel: the fastest heading
+   can make a cell reachable soonest through a segment that is that
+   many times farther than the closest one.
+*/
+static double auto_radius (pfolsm_profile_t const * vel)
+{
+  double vmin = INFINITY, vmax = 0.0, radius;
+  size_t kk;
+  
+  for (kk = 0; kk <= 720; ++kk) {
+    double const angle = kk * M_PI / 720;
+    double const vv = pfolsm_profile_eval (vel, cos (angle), sin (angle));
+    if (vv < vmin) {
+      vmin = vv;
+    }
+    if (vv > vmax) {
+      vmax = vv;
+    }
+  }
+  if ( ! (vmin > 0.0)) {
+    return PFOLSM_OUM_MAXRADIUS;
+  }
+  radius = M_SQRT2 * vmax / vmin;
+  return radius < PFOLSM_OUM_MAXRADIUS ? radius : PFOLSM_OUM_MAXRADIUS;
+}
+
+
+int pfolsm_oum_arrival (pfolsm_fmm_t * fm, pfolsm_t const * pp,
+			pfolsm_profile_t const * vel, double radius,
+			size_t const * seed, size_t nseed,
+			double * arrival)
+{
+  struct oum_s om;
+  size_t ii, jj;
+  
+  om.fm = fm;
+  om.pp = pp;
+  om.vel = vel;
+  om.tt = arrival;
+  om.radius = radius > 0.0 ? radius : auto_radius (vel);
+  om.reach = ceil (om.radius);
+  
+  _pfolsm_fmm_reset (fm, arrival);
+  
+  if (nseed > 0) {
+    for (ii = 0; ii < nseed; ++ii) {
+      fm->state[seed[ii]] = KNOWN;
+      arrival[seed[ii]] = 0.0;
+    }
+  }
+  else {
+    for (jj = 1; jj <= pp->dimy; ++jj) {
+      for (ii = 1; ii <= pp->dimx; ++ii) {
+	if (pfolsm_get (pp, ii, jj) <= 0.0) {
+	  fm->state[ii + jj * pp->nx] = KNOWN;
+	  arrival[ii + jj * pp->nx] = 0.0;
+	}
+      }
+    }
+  }
+  for (jj = 1; jj <= pp->dimy; ++jj) {
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      size_t const idx = ii + jj * pp->nx;
+      if (KNOWN == fm->state[idx] && 0 != accept (&om, idx)) {
+	return -1;
+      }
+    }
+  }
+  
+  while (fm->nheap > 0) {
+    struct pfolsm_fmm_node_s const top = _pfolsm_fmm_pop (fm);
+    fm->state[top.idx] = KNOWN;
+    arrival[top.idx] = top.key;
+    if (0 != accept (&om, top.idx)) {
+      return -1;
+    }
+  }
+  
+  return 0;
+}
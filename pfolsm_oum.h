@@ -0,0 +1,71 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_OUM_H
+#define PFOLSM_OUM_H
+
+#include "pfolsm_fmm.h"
+#include "pfolsm_profile.h"
+
+
+/** Largest update radius, in cells, that pfolsm_oum_arrival picks. */
+#define PFOLSM_OUM_MAXRADIUS 8.0
+
+
+/**
+   Anisotropic first arrival times by the ordered upwind method
+   (Sethian and Vladimirsky 2003), in a single Dijkstra-like pass
+   that uses the workspace of the fast marching method. The front
+   moves from the seed cells with a speed that depends on the heading
+   of motion, given by vel, times the speed of pp at the cell being
+   reached. A cell is updated from the straight segments between
+   pairs of adjacent known cells (including diagonals) within radius
+   cells, minimizing along each segment. With radius <= 0, it is
+   derived from the anisotropy ratio of vel and capped at
+   PFOLSM_OUM_MAXRADIUS, which also applies if vel vanishes for some
+   headings. Cells with zero speed are obstacles that no update
+   reaches across, whatever the radius. With nseed 0, the cells with phi <= 0 are the seeds.
+   Writes all pp->ntt entries of arrival, with INFINITY for
+   unreachable and ghost cells.
+*/
+int pfolsm_oum_arrival (pfolsm_fmm_t * fm, pfolsm_t const * pp,
+			pfolsm_profile_t const * vel, double radius,
+			size_t const * seed, size_t nseed,
+			double * arrival);
+
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Precomputed direction-dependent speed profiles. The speed models in
+ * dbgpln and noniso used to call atan2 and search the spline table
+ * for every cell; here the profile is resampled once onto a table
+ * that is uniform in a pseudo-angle, which needs a single division
+ * per gradient, and evaluated with a cubic per segment. The AVX2
+ * kernel uses the same operations in the same order as the scalar
+ * one, so both give identical results.
+ */
+
+#include "pfolsm_profile.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# define PFOLSM_HAVE_X86
+# include <immintrin.h>
+#endif
+
+
+/**
+   Gradient angle in [0, pi] for a pseudo-angle in [0, 2].
+*/
+static double pseudo_to_angle (double pa)
+{
+  return atan2 (pa <= 1.0 ? pa : 2.0 - pa, 1.0 - pa);
+}
+
+
+static void eval_scalar (pfolsm_profile_t const * pf, size_t nn,
+			 double const * gx, double const * gy, double * speed)
+{
+  size_t ii;
+  for (ii = 0; ii < nn; ++ii) {
+    speed[ii] = pfolsm_profile_eval (pf, gx[ii], gy[ii]);
+  }
+}
+
+
+#ifdef PFOLSM_HAVE_X86
+
+
+__attribute__((target("avx2")))
+static void eval_avx2 (pfolsm_profile_t const * pf, size_t nn,
+		       double const * gx, double const * gy, double * speed)
+{
+  __m256d const sign = _mm256_set1_pd (-0.0);
+  __m256d const one = _mm256_set1_pd (1.0);
+  __m256d const tiny = _mm256_set1_pd (1e-8);
+  __m256d const scale = _mm256_set1_pd (pf->scale);
+  __m128i const kmax = _mm_set1_epi32 (pf->nseg - 1);
+  size_t ii;
+  
+  for (ii = 0; ii + 4 <= nn; ii += 4) {
+    __m256d const vx = _mm256_loadu_pd (gx + ii);
+    __m256d const vy = _mm256_loadu_pd (gy + ii);
+    __m256d const valid = _mm256_cmp_pd (_mm256_add_pd (_mm256_mul_pd (vx, vx), _mm256_mul_pd (vy, vy)),
+					 tiny, _CMP_GE_OQ);
+    __m256d const l1 = _mm256_add_pd (_mm256_andnot_pd (sign, vx), _mm256_andnot_pd (sign, vy));
+    __m256d const pa = _mm256_sub_pd (one, _mm256_div_pd (vx, l1));
+    __m256d const tt = _mm256_and_pd (valid, _mm256_mul_pd (pa, scale));
+    __m128i const kk = _mm_min_epi32 (_mm256_cvttpd_epi32 (tt), kmax);
+    __m256d const uu = _mm256_sub_pd (tt, _mm256_cvtepi32_pd (kk));
+    __m128i const k4 = _mm_slli_epi32 (kk, 2);
+    __m256d const c0 = _mm256_i32gather_pd (pf->coef, k4, 8);
+    __m256d const c1 = _mm256_i32gather_pd (pf->coef + 1, k4, 8);
+    __m256d const c2 = _mm256_i32gather_pd (pf->coef + 2, k4, 8);
+    __m256d const c3 = _mm256_i32gather_pd (pf->coef + 3, k4, 8);
+    __m256d const vv = _mm256_add_pd (c0, _mm256_mul_pd (uu, _mm256_add_pd (c1, _mm256_mul_pd (uu, _mm256_add_pd (c2, _mm256_mul_pd (uu, c3))))));
+    _mm256_storeu_pd (speed + ii, _mm256_and_pd (valid, vv));
+  }
+  
+  eval_scalar (pf, nn - ii, gx + ii, gy + ii, speed + ii);
+}
+
+
+#endif // PFOLSM_HAVE_X86
+
+
+int pfolsm_profile_create (pfolsm_profile_t * pf, size_t nseg,
+			   pfolsm_polar_t fn, void * arg)
+{
+  size_t kk;
+  
+  if (nseg < 1) {
+    nseg = 1;
+  }
+  pf->nseg = nseg;
+  pf->scale = 0.5 * nseg;
+  pf->coef = malloc (4 * nseg * sizeof(double));
+  if (0 == pf->coef) {
+    return -1;
+  }
+  
+  // Cubic through the values at u = 0, 1/3, 2/3, 1 of each segment.
+  
+  for (kk = 0; kk < nseg; ++kk) {
+    double yy[4];
+    double * cc = pf->coef + 4 * kk;
+    int ll;
+    for (ll = 0; ll < 4; ++ll) {
+      yy[ll] = fn (arg, pseudo_to_angle ((kk + ll / 3.0) / pf->scale));
+    }
+    cc[0] = yy[0];
+    cc[1] = 0.5 * (-11.0 * yy[0] + 18.0 * yy[1] - 9.0 * yy[2] + 2.0 * yy[3]);
+    cc[2] = 0.5 * (18.0 * yy[0] - 45.0 * yy[1] + 36.0 * yy[2] - 9.0 * yy[3]);
+    cc[3] = 0.5 * (-9.0 * yy[0] + 27.0 * yy[1] - 27.0 * yy[2] + 9.0 * yy[3]);
+  }
+  
+  pf->eval_n = eval_scalar;
+#ifdef PFOLSM_HAVE_X86
+  if (_pfolsm_isa_best () >= PFOLSM_ISA_AVX2) {
+    pf->eval_n = eval_avx2;
+  }
+#endif
+  
+  return 0;
+}
+
+
+/**
+   Put the angle into [-pi, pi], as modangle in dbgpln.c.
+*/
+static double modangle (double angle)
+{
+  angle = fmod (angle, 2 * M_PI);
+  if (angle > M_PI) {
+    angle -= 2 * M_PI;
+  }
+  else if (angle < -M_PI) {
+    angle += 2 * M_PI;
+  }
+  return angle;
+}
+
+
+double pfolsm_spline_polar (void * arg, double angle)
+{
+  pfolsm_spline_t const * sp = arg;
+  size_t ii;
+  
+  if (sp->tablen < 1) {
+    return 0.0;
+  }
+  angle = fabs (modangle (angle));
+  if (sp->tablen < 2 || angle < sp->atab[0]) {
+    return sp->vtab[0];
+  }
+  for (ii = 1; ii < sp->tablen; ++ii) {
+    if (angle <= sp->atab[ii]) {
+      double const p0 = sp->vtab[ii-1];
+      double const p1 = sp->vtab[ii];
+      double const tt = (angle - sp->atab[ii-1]) / (sp->atab[ii] - sp->atab[ii-1]);
+      return (2 * tt - 3) * (p0 - p1) * tt * tt + p0;
+    }
+  }
+  return sp->vtab[sp->tablen - 1];
+}
+
+
+int pfolsm_profile_create_spline (pfolsm_profile_t * pf, size_t nseg,
+				  double const * atab, double const * vtab,
+				  size_t tablen)
+{
+  pfolsm_spline_t sp;
+  sp.atab = atab;
+  sp.vtab = vtab;
+  sp.tablen = tablen;
+  return pfolsm_profile_create (pf, nseg, pfolsm_spline_polar, &sp);
+}
+
+
+/**
+   Normal speed contributed by heading phi for the gradient angle
+   alpha.
+*/
+static double wulff_term (pfolsm_wulff_t const * wf, double alpha, double phi)
+{
+  return wf->vel (wf->velarg, fabs (modangle (phi)))
+    * cos (phi - alpha)
+    * wf->pen (wf->penarg, fabs (modangle (alpha - phi)));
+}
+
+
+double pfolsm_wulff_eval (pfolsm_wulff_t const * wf, double alpha, double * heading)
+{
+  static double const ratio = 0.6180339887498949;
+  size_t const nh = wf->nheading < 4 ? 4 : wf->nheading;
+  double const dphi = 2 * M_PI / nh;
+  double best, fbest, lo, hi, aa, bb, fa, fb;
+  size_t kk;
+  
+  // coarse scan over all headings
+  
+  best = -M_PI;
+  fbest = wulff_term (wf, alpha, best);
+  for (kk = 1; kk < nh; ++kk) {
+    double const phi = -M_PI + kk * dphi;
+    double const ff = wulff_term (wf, alpha, phi);
+    if (ff > fbest) {
+      best = phi;
+      fbest = ff;
+    }
+  }
+  
+  // golden section search around the best coarse heading
+  
+  lo = best - dphi;
+  hi = best + dphi;
+  aa = hi - ratio * (hi - lo);
+  bb = lo + ratio * (hi - lo);
+  fa = wulff_term (wf, alpha, aa);
+  fb = wulff_term (wf, alpha, bb);
+  for (kk = 0; kk < 60; ++kk) {
+    if (fa > fb) {
+      hi = bb;
+      bb = aa;
+      fb = fa;
+      aa = hi - ratio * (hi - lo);
+      fa = wulff_term (wf, alpha, aa);
+    }
+    else {
+      lo = aa;
+      aa = bb;
+      fa = fb;
+      bb = lo + ratio * (hi - lo);
+      fb = wulff_term (wf, alpha, bb);
+    }
+  }
+  if (fa > fbest) {
+    best = aa;
+    fbest = fa;
+  }
+  if (fb > fbest) {
+    best = bb;
+    fbest = fb;
+  }
+  
+  if (heading) {
+    *heading = modangle (best);
+  }
+  return fbest;
+}
+
+
+static double wulff_polar (void * arg, double angle)
+{
+  return pfolsm_wulff_eval (arg, angle, 0);
+}
+
+
+int pfolsm_profile_create_wulff (pfolsm_profile_t * pf, size_t nseg,
+				 pfolsm_wulff_t const * wf)
+{
+  return pfolsm_profile_create (pf, nseg, wulff_polar, (void*) wf);
+}
+
+
+void pfolsm_profile_destroy (pfolsm_profile_t * pf)
+{
+  free (pf->coef);
+  pf->coef = 0;
+}
+
+
+double pfolsm_profile_eval (pfolsm_profile_t const * pf, double gx, double gy)
+{
+  double tt, uu;
+  double const * cc;
+  size_t kk;
+  
+  if ( ! (gx * gx + gy * gy >= 1e-8)) {
+    return 0.0;
+  }
+  tt = (1.0 - gx / (fabs (gx) + fabs (gy))) * pf->scale;
+  kk = tt;
+  if (kk > pf->nseg - 1) {
+    kk = pf->nseg - 1;
+  }
+  uu = tt - (double) kk;
+  cc = pf->coef + 4 * kk;
+  return cc[0] + uu * (cc[1] + uu * (cc[2] + uu * cc[3]));
+}
+
+
+void pfolsm_profile_eval_n (pfolsm_profile_t const * pf, size_t nn,
+			    double const * gx, double const * gy, double * speed)
+{
+  pf->eval_n (pf, nn, gx, gy, speed);
+}
+
+
+void pfolsm_profile_speedfn (void * arg, size_t i0, size_t jj, size_t nn,
+			     double const * gx, double const * gy, double * speed)
+{
+  pfolsm_profile_t const * pf = arg;
+  pf->eval_n (pf, nn, gx, gy, speed);
+}
@@ -0,0 +1,144 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_PROFILE_H
+#define PFOLSM_PROFILE_H
+
+#include "pfolsm.h"
+
+
+/** A speed as a function of the absolute gradient angle in [0, pi]. */
+typedef double (*pfolsm_polar_t) (void * arg, double angle);
+
+
+/**
+   Direction-dependent speed profile, tabulated once so that it can
+   be evaluated without atan2 or table searches. The table is
+   uniform in the pseudo-angle p = 1 - gx / (|gx| + |gy|), which grows
+   monotonically from 0 to 2 as the gradient angle goes from 0 to pi,
+   and holds the power basis coefficients of a cubic per segment that
+   interpolates the profile at four points.
+*/
+struct pfolsm_profile_s {
+  size_t nseg;
+  double scale;			/* nseg / 2 */
+  double * coef;		/* 4 per segment, constant term first */
+  void (*eval_n) (struct pfolsm_profile_s const * pf, size_t nn,
+		  double const * gx, double const * gy, double * speed);
+};
+
+typedef struct pfolsm_profile_s pfolsm_profile_t;
+
+
+/** Tabulate fn with nseg segments. */
+int pfolsm_profile_create (pfolsm_profile_t * pf, size_t nseg,
+			   pfolsm_polar_t fn, void * arg);
+
+/**
+   Tabulate the symmetric polar piecewise cubic with horizontal
+   tangents through the given angles and values, as used in dbgpln
+   and noniso: constant below the first and above the last angle.
+*/
+int pfolsm_profile_create_spline (pfolsm_profile_t * pf, size_t nseg,
+				  double const * atab, double const * vtab,
+				  size_t tablen);
+
+/** Table of angles and values for pfolsm_spline_polar. */
+typedef struct {
+  double const * atab;
+  double const * vtab;
+  size_t tablen;
+} pfolsm_spline_t;
+
+/**
+   A pfolsm_polar_t for the spline described by a pfolsm_spline_t.
+   Takes the absolute value of the angle after putting it into
+   [-pi, pi].
+*/
+double pfolsm_spline_polar (void * arg, double angle);
+
+
+/**
+   Heading-aware speed model: an agent moving with heading phi has
+   speed vel(|phi|), scaled by pen(|alpha - phi|) for deviating from
+   the gradient angle alpha. The normal speed of the front is the
+   maximum over all headings of vel * pen * cos(phi - alpha), which
+   is what max_speed in dbgpln.c approximated per cell.
+*/
+typedef struct {
+  pfolsm_polar_t vel;
+  void * velarg;
+  pfolsm_polar_t pen;
+  void * penarg;
+  size_t nheading;		/* headings of the coarse scan, e.g. 36 */
+} pfolsm_wulff_t;
+
+/**
+   Maximize the normal speed over headings for the gradient angle
+   alpha, with a coarse scan followed by a golden section search. The
+   maximizing heading gets stored in heading unless that is null.
+*/
+double pfolsm_wulff_eval (pfolsm_wulff_t const * wf, double alpha, double * heading);
+
+/**
+   Tabulate the normal speed of a heading-aware model, so that the
+   maximization happens once rather than per cell and step.
+*/
+int pfolsm_profile_create_wulff (pfolsm_profile_t * pf, size_t nseg,
+				 pfolsm_wulff_t const * wf);
+
+void pfolsm_profile_destroy (pfolsm_profile_t * pf);
+
+/**
+   Speed for the gradient (gx, gy), which does not need to be
+   normalized. Gradients shorter than 1e-4 get zero.
+*/
+double pfolsm_profile_eval (pfolsm_profile_t const * pf, double gx, double gy);
+
+/** pfolsm_profile_eval for nn gradients, vectorized where possible. */
+void pfolsm_profile_eval_n (pfolsm_profile_t const * pf, size_t nn,
+			    double const * gx, double const * gy, double * speed);
+
+/**
+   Adapter for pfolsm_speed_fn, with the profile as argument. Note
+   that the speed model gets central difference gradients.
+*/
+void pfolsm_profile_speedfn (void * arg, size_t i0, size_t jj, size_t nn,
+			     double const * gx, double const * gy, double * speed);
+
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pfolsm_sched.h"
+
+#include <sched.h>
+#include <string.h>
+
+
+static uint64_t pack (uint64_t top, uint64_t bottom)
+{
+  return top << 32 | bottom;
+}
+
+
+/**
+   Take the last job of a deque, or return -1 if it is empty. Thieves
+   change the same word, so the owner has to use a CAS too.
+*/
+static int64_t take (struct pfolsm_deque_s * dq)
+{
+  uint64_t range = __atomic_load_n (&dq->range, __ATOMIC_ACQUIRE);
+  for (;;) {
+    uint64_t const top = range >> 32;
+    uint64_t const bottom = range & 0xffffffff;
+    if (top >= bottom) {
+      return -1;
+    }
+    if (__atomic_compare_exchange_n (&dq->range, &range, pack (top, bottom - 1), 0,
+				     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return bottom - 1;
+    }
+  }
+}
+
+
+/**
+   Move the first half (rounded up) of the jobs of a deque to
+   [*lo, *hi). Returns 0 if it is empty.
+*/
+static int steal (struct pfolsm_deque_s * dq, uint64_t * lo, uint64_t * hi)
+{
+  uint64_t range = __atomic_load_n (&dq->range, __ATOMIC_ACQUIRE);
+  for (;;) {
+    uint64_t const top = range >> 32;
+    uint64_t const bottom = range & 0xffffffff;
+    uint64_t const half = (bottom - top + 1) / 2;
+    if (top >= bottom) {
+      return 0;
+    }
+    if (__atomic_compare_exchange_n (&dq->range, &range, pack (top + half, bottom), 0,
+				     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      *lo = top;
+      *hi = top + half;
+      return 1;
+    }
+  }
+}
+
+
+static void run_job (pfolsm_sched_t * ps, uint64_t ijob, size_t iw)
+{
+  double const rr = ps->job (ps->arg, ijob, iw);
+  if (ps->flags & PFOLSM_SCHED_DETERMINISTIC) {
+    ps->result[ijob] = rr;
+  }
+  else {
+    ps->deque[iw].sum += rr;
+  }
+  __atomic_fetch_sub (&ps->remaining, 1, __ATOMIC_RELEASE);
+}
+
+
+static void work (void * arg, size_t iw, size_t nw)
+{
+  pfolsm_sched_t * ps = arg;
+  struct pfolsm_deque_s * own = ps->deque + iw;
+  uint32_t seed = 2654435761u * (iw + 1);
+  size_t ii;
+  
+  for (;;) {
+    int64_t ijob;
+    uint64_t lo, hi;
+    size_t victim;
+    
+    while ((ijob = take (own)) >= 0) {
+      run_job (ps, ijob, iw);
+    }
+    
+    // A full round over the other workers can find nothing while
+    // some thief has yet to publish the rest of what it stole, so
+    // only the count of unfinished jobs tells when to stop.
+    
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    victim = seed % nw;
+    for (ii = 0; ii < nw; ++ii, victim = (victim + 1) % nw) {
+      if (victim != iw && steal (ps->deque + victim, &lo, &hi)) {
+	break;
+      }
+    }
+    if (ii == nw) {
+      if (0 == __atomic_load_n (&ps->remaining, __ATOMIC_ACQUIRE)) {
+	return;
+      }
+      sched_yield ();
+      continue;
+    }
+    ++own->nsteal;
+    __atomic_store_n (&own->range, pack (lo + 1, hi), __ATOMIC_RELEASE);
+    run_job (ps, lo, iw);
+  }
+}
+
+
+int pfolsm_sched_create (pfolsm_sched_t * ps, size_t nthreads, unsigned flags)
+{
+  void * mem;
+  
+  if (nthreads < 1) {
+    nthreads = 1;
+  }
+  ps->nworkers = nthreads;
+  ps->flags = flags;
+  ps->result = 0;
+  ps->resultcap = 0;
+  ps->nsteal = 0;
+  ps->pool = 0;
+  if (0 != posix_memalign (&mem, PFOLSM_ALIGN, nthreads * sizeof(*ps->deque))) {
+    return -1;
+  }
+  memset (mem, 0, nthreads * sizeof(*ps->deque));
+  ps->deque = mem;
+  if (nthreads >= 2) {
+    ps->pool = _pfolsm_pool_create (nthreads);
+    if (0 == ps->pool) {
+      free (ps->deque);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+void pfolsm_sched_destroy (pfolsm_sched_t * ps)
+{
+  _pfolsm_pool_destroy (ps->pool);
+  free (ps->deque);
+  free (ps->result);
+}
+
+
+int pfolsm_sched_run (pfolsm_sched_t * ps, size_t njob, pfolsm_job_t job, void * arg,
+		      double * sum)
+{
+  double total = 0.0;
+  size_t iw, i0, i1;
+  
+  if (njob > 0xffffffff) {
+    return -1;
+  }
+  if ((ps->flags & PFOLSM_SCHED_DETERMINISTIC) && njob > ps->resultcap) {
+    double * result = realloc (ps->result, njob * sizeof(double));
+    if (0 == result) {
+      return -1;
+    }
+    ps->result = result;
+    ps->resultcap = njob;
+  }
+  
+  ps->job = job;
+  ps->arg = arg;
+  ps->remaining = njob;
+  for (iw = 0; iw < ps->nworkers; ++iw) {
+    _pfolsm_split (njob, iw, ps->nworkers, &i0, &i1);
+    ps->deque[iw].range = pack (i0 - 1, i1);
+    ps->deque[iw].sum = 0.0;
+    ps->deque[iw].nsteal = 0;
+  }
+  if (ps->pool) {
+    _pfolsm_pool_run (ps->pool, work, ps);
+  }
+  else {
+    work (ps, 0, 1);
+  }
+  
+  ps->nsteal = 0;
+  for (iw = 0; iw < ps->nworkers; ++iw) {
+    ps->nsteal += ps->deque[iw].nsteal;
+    total += ps->deque[iw].sum;
+  }
+  if (ps->flags & PFOLSM_SCHED_DETERMINISTIC) {
+    for (i0 = 0; i0 < njob; ++i0) {
+      total += ps->result[i0];
+    }
+  }
+  if (sum) {
+    *sum = total;
+  }
+  return 0;
+}
+
+
+struct advance_s {
+  pfolsm_t * const * inst;
+  double dt;
+  size_t nsteps;
+  int status;
+};
+
+
+static double advance_job (void * arg, size_t ijob, size_t iw)
+{
+  struct advance_s * as = arg;
+  if (0 != pfolsm_advance_n (as->inst[ijob], as->dt, as->nsteps)) {
+    __atomic_store_n (&as->status, -1, __ATOMIC_RELAXED);
+  }
+  return 0.0;
+}
+
+
+int pfolsm_sched_advance (pfolsm_sched_t * ps, pfolsm_t * const * inst, size_t ninst,
+			  double dt, size_t nsteps)
+{
+  struct advance_s as;
+  as.inst = inst;
+  as.dt = dt;
+  as.nsteps = nsteps;
+  as.status = 0;
+  if (0 != pfolsm_sched_run (ps, ninst, advance_job, &as, 0)) {
+    return -1;
+  }
+  return as.status;
+}
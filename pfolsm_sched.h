@@ -0,0 +1,119 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_SCHED_H
+#define PFOLSM_SCHED_H
+
+#include "pfolsm.h"
+
+#include <stdint.h>
+
+
+/*
+ * Work stealing over a fixed set of independent jobs, for workloads
+ * whose jobs cost very different amounts, like whole runs of an
+ * ensemble or the tiles of a sparse level set. Each worker starts
+ * with a contiguous share of the job indices and takes jobs from its
+ * end. A worker that runs out steals the first half of what another
+ * one has left.
+ */
+
+/**
+   Make the sum returned by pfolsm_sched_run independent of thread
+   count and timing, by adding the job results in job order.
+*/
+#define PFOLSM_SCHED_DETERMINISTIC 1
+
+
+/**
+   Job ijob, run by worker iw. Workers run one job at a time, so iw
+   can index per-worker scratch space, but which worker gets which
+   job varies between runs. The result goes into the sum.
+*/
+typedef double (*pfolsm_job_t) (void * arg, size_t ijob, size_t iw);
+
+
+/**
+   Jobs left to a worker, top in the upper and bottom in the lower
+   half. Each deque fills a cache line of its own.
+*/
+struct pfolsm_deque_s {
+  uint64_t range;
+  double sum;
+  size_t nsteal;
+  char pad[PFOLSM_ALIGN - 2 * sizeof(uint64_t) - sizeof(size_t)];
+};
+
+
+struct pfolsm_sched_s {
+  pfolsm_pool_t * pool;
+  size_t nworkers;
+  unsigned flags;
+  struct pfolsm_deque_s * deque; /* one per worker */
+  double * result;		/* per job, for PFOLSM_SCHED_DETERMINISTIC */
+  size_t resultcap;
+  pfolsm_job_t job;
+  void * arg;
+  size_t remaining;		/* jobs not finished yet */
+  size_t nsteal;		/* steals during the last run */
+};
+
+typedef struct pfolsm_sched_s pfolsm_sched_t;
+
+
+int pfolsm_sched_create (pfolsm_sched_t * ps, size_t nthreads, unsigned flags);
+
+void pfolsm_sched_destroy (pfolsm_sched_t * ps);
+
+/**
+   Run job for every index in [0, njob) and wait for all of them, at
+   most 2^32 - 1 jobs per run. Stores the sum of their results in sum
+   unless that is null. Returns -1 if it runs out of memory before
+   running any job.
+*/
+int pfolsm_sched_run (pfolsm_sched_t * ps, size_t njob, pfolsm_job_t job, void * arg,
+		      double * sum);
+
+/**
+   pfolsm_advance_n of nsteps on each of the ninst instances, as one
+   job each. The instances must not share planes.
+*/
+int pfolsm_sched_advance (pfolsm_sched_t * ps, pfolsm_t * const * inst, size_t ninst,
+			  double dt, size_t nsteps);
+
+
+#endif
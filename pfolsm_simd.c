@@ -0,0 +1,483 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Vectorized versions of _pfolsm_row_scalar. They use the same
+ * operations in the same order (max3 maps onto two MAXPD because
+ * both return the first operand only if it is strictly greater), so
+ * their results are bit-identical to the scalar reference as long as
+ * the compiler does not contract multiply-adds.
+ */
+
+#include "pfolsm.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+# define PFOLSM_HAVE_X86
+# include <immintrin.h>
+#endif
+
+
+#ifdef PFOLSM_HAVE_X86
+
+
+__attribute__((target("sse2")))
+void _pfolsm_row_sse2 (double const * phi,
+		       double const * speed,
+		       double * next,
+		       size_t nn,
+		       size_t stride,
+		       double dt)
+{
+  double const * dn = phi - stride;
+  double const * up = phi + stride;
+  __m128d const zero = _mm_setzero_pd ();
+  __m128d const sign = _mm_set1_pd (-0.0);
+  __m128d const vdt = _mm_set1_pd (dt);
+  size_t ii;
+  
+  for (ii = 0; ii + 2 <= nn; ii += 2) {
+    __m128d const cc = _mm_loadu_pd (phi + ii);
+    __m128d const dxm = _mm_sub_pd (cc, _mm_loadu_pd (phi + ii - 1));
+    __m128d const dxp = _mm_sub_pd (_mm_loadu_pd (phi + ii + 1), cc);
+    __m128d const dym = _mm_sub_pd (cc, _mm_loadu_pd (dn + ii));
+    __m128d const dyp = _mm_sub_pd (_mm_loadu_pd (up + ii), cc);
+    // flip is -0.0 where speed is not positive, which turns
+    // (dm, -dp) into (-dm, dp) without branching
+    __m128d const ss = _mm_loadu_pd (speed + ii);
+    __m128d const flip = _mm_andnot_pd (_mm_cmpgt_pd (ss, zero), sign);
+    __m128d const gx = _mm_max_pd (_mm_max_pd (_mm_xor_pd (dxm, flip),
+					       _mm_xor_pd (dxp, _mm_xor_pd (flip, sign))),
+				   zero);
+    __m128d const gy = _mm_max_pd (_mm_max_pd (_mm_xor_pd (dym, flip),
+					       _mm_xor_pd (dyp, _mm_xor_pd (flip, sign))),
+				   zero);
+    __m128d const nabla = _mm_sqrt_pd (_mm_add_pd (_mm_mul_pd (gx, gx), _mm_mul_pd (gy, gy)));
+    _mm_storeu_pd (next + ii, _mm_sub_pd (cc, _mm_mul_pd (vdt, _mm_mul_pd (ss, nabla))));
+  }
+  
+  _pfolsm_row_scalar (phi + ii, speed + ii, next + ii, nn - ii, stride, dt);
+}
+
+
+__attribute__((target("avx2")))
+void _pfolsm_row_avx2 (double const * phi,
+		       double const * speed,
+		       double * next,
+		       size_t nn,
+		       size_t stride,
+		       double dt)
+{
+  double const * dn = phi - stride;
+  double const * up = phi + stride;
+  __m256d const zero = _mm256_setzero_pd ();
+  __m256d const sign = _mm256_set1_pd (-0.0);
+  __m256d const vdt = _mm256_set1_pd (dt);
+  size_t ii;
+  
+  for (ii = 0; ii + 4 <= nn; ii += 4) {
+    __m256d const cc = _mm256_loadu_pd (phi + ii);
+    __m256d const dxm = _mm256_sub_pd (cc, _mm256_loadu_pd (phi + ii - 1));
+    __m256d const dxp = _mm256_sub_pd (_mm256_loadu_pd (phi + ii + 1), cc);
+    __m256d const dym = _mm256_sub_pd (cc, _mm256_loadu_pd (dn + ii));
+    __m256d const dyp = _mm256_sub_pd (_mm256_loadu_pd (up + ii), cc);
+    __m256d const ss = _mm256_loadu_pd (speed + ii);
+    __m256d const pos = _mm256_cmp_pd (ss, zero, _CMP_GT_OQ);
+    __m256d const flip = _mm256_andnot_pd (pos, sign);
+    __m256d const gx = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dxm, flip),
+						     _mm256_xor_pd (dxp, _mm256_xor_pd (flip, sign))),
+				      zero);
+    __m256d const gy = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dym, flip),
+						     _mm256_xor_pd (dyp, _mm256_xor_pd (flip, sign))),
+				      zero);
+    __m256d const nabla = _mm256_sqrt_pd (_mm256_add_pd (_mm256_mul_pd (gx, gx),
+							 _mm256_mul_pd (gy, gy)));
+    _mm256_storeu_pd (next + ii, _mm256_sub_pd (cc, _mm256_mul_pd (vdt, _mm256_mul_pd (ss, nabla))));
+  }
+  
+  _pfolsm_row_sse2 (phi + ii, speed + ii, next + ii, nn - ii, stride, dt);
+}
+
+
+__attribute__((target("avx2")))
+double _pfolsm_rate_avx2 (double const * phi,
+			  double const * speed,
+			  size_t nn,
+			  size_t stride)
+{
+  double const * dn = phi - stride;
+  double const * up = phi + stride;
+  __m256d const zero = _mm256_setzero_pd ();
+  __m256d const sign = _mm256_set1_pd (-0.0);
+  __m256d rmax = zero;
+  double buf[4], tail;
+  size_t ii;
+  
+  for (ii = 0; ii + 4 <= nn; ii += 4) {
+    __m256d const cc = _mm256_loadu_pd (phi + ii);
+    __m256d const dxm = _mm256_sub_pd (cc, _mm256_loadu_pd (phi + ii - 1));
+    __m256d const dxp = _mm256_sub_pd (_mm256_loadu_pd (phi + ii + 1), cc);
+    __m256d const dym = _mm256_sub_pd (cc, _mm256_loadu_pd (dn + ii));
+    __m256d const dyp = _mm256_sub_pd (_mm256_loadu_pd (up + ii), cc);
+    __m256d const ss = _mm256_loadu_pd (speed + ii);
+    __m256d const pos = _mm256_cmp_pd (ss, zero, _CMP_GT_OQ);
+    __m256d const flip = _mm256_andnot_pd (pos, sign);
+    __m256d const gx = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dxm, flip),
+						     _mm256_xor_pd (dxp, _mm256_xor_pd (flip, sign))),
+				      zero);
+    __m256d const gy = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dym, flip),
+						     _mm256_xor_pd (dyp, _mm256_xor_pd (flip, sign))),
+				      zero);
+    __m256d const nabla = _mm256_sqrt_pd (_mm256_add_pd (_mm256_mul_pd (gx, gx),
+							 _mm256_mul_pd (gy, gy)));
+    // MAXPD returns the second operand for NaN, like the scalar loop
+    rmax = _mm256_max_pd (_mm256_andnot_pd (sign, _mm256_mul_pd (ss, nabla)), rmax);
+  }
+  
+  _mm256_storeu_pd (buf, rmax);
+  tail = _pfolsm_rate_scalar (phi + ii, speed + ii, nn - ii, stride);
+  for (ii = 0; ii < 4; ++ii) {
+    if (buf[ii] > tail) {
+      tail = buf[ii];
+    }
+  }
+  return tail;
+}
+
+
+__attribute__((target("avx512f")))
+static __m512d neg512 (__m512d aa)
+{
+  return _mm512_castsi512_pd (_mm512_xor_si512 (_mm512_castpd_si512 (aa),
+						_mm512_castpd_si512 (_mm512_set1_pd (-0.0))));
+}
+
+
+__attribute__((target("avx512f")))
+void _pfolsm_row_avx512 (double const * phi,
+			 double const * speed,
+			 double * next,
+			 size_t nn,
+			 size_t stride,
+			 double dt)
+{
+  double const * dn = phi - stride;
+  double const * up = phi + stride;
+  __m512d const zero = _mm512_setzero_pd ();
+  __m512d const vdt = _mm512_set1_pd (dt);
+  size_t ii;
+  
+  for (ii = 0; ii + 8 <= nn; ii += 8) {
+    __m512d const cc = _mm512_loadu_pd (phi + ii);
+    __m512d const dxm = _mm512_sub_pd (cc, _mm512_loadu_pd (phi + ii - 1));
+    __m512d const dxp = _mm512_sub_pd (_mm512_loadu_pd (phi + ii + 1), cc);
+    __m512d const dym = _mm512_sub_pd (cc, _mm512_loadu_pd (dn + ii));
+    __m512d const dyp = _mm512_sub_pd (_mm512_loadu_pd (up + ii), cc);
+    __m512d const ss = _mm512_loadu_pd (speed + ii);
+    __mmask8 const pos = _mm512_cmp_pd_mask (ss, zero, _CMP_GT_OQ);
+    __m512d const gx = _mm512_max_pd (_mm512_max_pd (_mm512_mask_blend_pd (pos, neg512 (dxm), dxm),
+						     _mm512_mask_blend_pd (pos, dxp, neg512 (dxp))),
+				      zero);
+    __m512d const gy = _mm512_max_pd (_mm512_max_pd (_mm512_mask_blend_pd (pos, neg512 (dym), dym),
+						     _mm512_mask_blend_pd (pos, dyp, neg512 (dyp))),
+				      zero);
+    __m512d const nabla = _mm512_sqrt_pd (_mm512_add_pd (_mm512_mul_pd (gx, gx),
+							 _mm512_mul_pd (gy, gy)));
+    _mm512_storeu_pd (next + ii, _mm512_sub_pd (cc, _mm512_mul_pd (vdt, _mm512_mul_pd (ss, nabla))));
+  }
+  
+  _pfolsm_row_avx2 (phi + ii, speed + ii, next + ii, nn - ii, stride, dt);
+}
+
+
+__attribute__((target("sse2")))
+void _pfolsm_rowf_sse2 (float const * phi,
+			float const * speed,
+			float * next,
+			size_t nn,
+			size_t stride,
+			double dt)
+{
+  float const * dn = phi - stride;
+  float const * up = phi + stride;
+  __m128 const zero = _mm_setzero_ps ();
+  __m128 const sign = _mm_set1_ps (-0.0f);
+  __m128 const vdt = _mm_set1_ps ((float) dt);
+  size_t ii;
+  
+  for (ii = 0; ii + 4 <= nn; ii += 4) {
+    __m128 const cc = _mm_loadu_ps (phi + ii);
+    __m128 const dxm = _mm_sub_ps (cc, _mm_loadu_ps (phi + ii - 1));
+    __m128 const dxp = _mm_sub_ps (_mm_loadu_ps (phi + ii + 1), cc);
+    __m128 const dym = _mm_sub_ps (cc, _mm_loadu_ps (dn + ii));
+    __m128 const dyp = _mm_sub_ps (_mm_loadu_ps (up + ii), cc);
+    __m128 const ss = _mm_loadu_ps (speed + ii);
+    __m128 const flip = _mm_andnot_ps (_mm_cmpgt_ps (ss, zero), sign);
+    __m128 const gx = _mm_max_ps (_mm_max_ps (_mm_xor_ps (dxm, flip),
+					      _mm_xor_ps (dxp, _mm_xor_ps (flip, sign))),
+				  zero);
+    __m128 const gy = _mm_max_ps (_mm_max_ps (_mm_xor_ps (dym, flip),
+					      _mm_xor_ps (dyp, _mm_xor_ps (flip, sign))),
+				  zero);
+    __m128 const nabla = _mm_sqrt_ps (_mm_add_ps (_mm_mul_ps (gx, gx), _mm_mul_ps (gy, gy)));
+    _mm_storeu_ps (next + ii, _mm_sub_ps (cc, _mm_mul_ps (vdt, _mm_mul_ps (ss, nabla))));
+  }
+  
+  _pfolsm_rowf_scalar (phi + ii, speed + ii, next + ii, nn - ii, stride, dt);
+}
+
+
+__attribute__((target("avx2")))
+void _pfolsm_rowf_avx2 (float const * phi,
+			float const * speed,
+			float * next,
+			size_t nn,
+			size_t stride,
+			double dt)
+{
+  float const * dn = phi - stride;
+  float const * up = phi + stride;
+  __m256 const zero = _mm256_setzero_ps ();
+  __m256 const sign = _mm256_set1_ps (-0.0f);
+  __m256 const vdt = _mm256_set1_ps ((float) dt);
+  size_t ii;
+  
+  for (ii = 0; ii + 8 <= nn; ii += 8) {
+    __m256 const cc = _mm256_loadu_ps (phi + ii);
+    __m256 const dxm = _mm256_sub_ps (cc, _mm256_loadu_ps (phi + ii - 1));
+    __m256 const dxp = _mm256_sub_ps (_mm256_loadu_ps (phi + ii + 1), cc);
+    __m256 const dym = _mm256_sub_ps (cc, _mm256_loadu_ps (dn + ii));
+    __m256 const dyp = _mm256_sub_ps (_mm256_loadu_ps (up + ii), cc);
+    __m256 const ss = _mm256_loadu_ps (speed + ii);
+    __m256 const pos = _mm256_cmp_ps (ss, zero, _CMP_GT_OQ);
+    __m256 const flip = _mm256_andnot_ps (pos, sign);
+    __m256 const gx = _mm256_max_ps (_mm256_max_ps (_mm256_xor_ps (dxm, flip),
+						    _mm256_xor_ps (dxp, _mm256_xor_ps (flip, sign))),
+				     zero);
+    __m256 const gy = _mm256_max_ps (_mm256_max_ps (_mm256_xor_ps (dym, flip),
+						    _mm256_xor_ps (dyp, _mm256_xor_ps (flip, sign))),
+				     zero);
+    __m256 const nabla = _mm256_sqrt_ps (_mm256_add_ps (_mm256_mul_ps (gx, gx),
+							_mm256_mul_ps (gy, gy)));
+    _mm256_storeu_ps (next + ii, _mm256_sub_ps (cc, _mm256_mul_ps (vdt, _mm256_mul_ps (ss, nabla))));
+  }
+  
+  _pfolsm_rowf_sse2 (phi + ii, speed + ii, next + ii, nn - ii, stride, dt);
+}
+
+
+__attribute__((target("avx512f")))
+static __m512 neg512f (__m512 aa)
+{
+  return _mm512_castsi512_ps (_mm512_xor_si512 (_mm512_castps_si512 (aa),
+						_mm512_castps_si512 (_mm512_set1_ps (-0.0f))));
+}
+
+
+__attribute__((target("avx512f")))
+void _pfolsm_rowf_avx512 (float const * phi,
+			  float const * speed,
+			  float * next,
+			  size_t nn,
+			  size_t stride,
+			  double dt)
+{
+  float const * dn = phi - stride;
+  float const * up = phi + stride;
+  __m512 const zero = _mm512_setzero_ps ();
+  __m512 const vdt = _mm512_set1_ps ((float) dt);
+  size_t ii;
+  
+  for (ii = 0; ii + 16 <= nn; ii += 16) {
+    __m512 const cc = _mm512_loadu_ps (phi + ii);
+    __m512 const dxm = _mm512_sub_ps (cc, _mm512_loadu_ps (phi + ii - 1));
+    __m512 const dxp = _mm512_sub_ps (_mm512_loadu_ps (phi + ii + 1), cc);
+    __m512 const dym = _mm512_sub_ps (cc, _mm512_loadu_ps (dn + ii));
+    __m512 const dyp = _mm512_sub_ps (_mm512_loadu_ps (up + ii), cc);
+    __m512 const ss = _mm512_loadu_ps (speed + ii);
+    __mmask16 const pos = _mm512_cmp_ps_mask (ss, zero, _CMP_GT_OQ);
+    __m512 const gx = _mm512_max_ps (_mm512_max_ps (_mm512_mask_blend_ps (pos, neg512f (dxm), dxm),
+						    _mm512_mask_blend_ps (pos, dxp, neg512f (dxp))),
+				     zero);
+    __m512 const gy = _mm512_max_ps (_mm512_max_ps (_mm512_mask_blend_ps (pos, neg512f (dym), dym),
+						    _mm512_mask_blend_ps (pos, dyp, neg512f (dyp))),
+				     zero);
+    __m512 const nabla = _mm512_sqrt_ps (_mm512_add_ps (_mm512_mul_ps (gx, gx),
+							_mm512_mul_ps (gy, gy)));
+    _mm512_storeu_ps (next + ii, _mm512_sub_ps (cc, _mm512_mul_ps (vdt, _mm512_mul_ps (ss, nabla))));
+  }
+  
+  _pfolsm_rowf_avx2 (phi + ii, speed + ii, next + ii, nn - ii, stride, dt);
+}
+
+
+__attribute__((target("avx2")))
+static __m256d loadcvt (float const * src)
+{
+  return _mm256_cvtps_pd (_mm_loadu_ps (src));
+}
+
+
+__attribute__((target("avx2")))
+void _pfolsm_rowm_avx2 (float const * phi,
+			float const * speed,
+			float * next,
+			size_t nn,
+			size_t stride,
+			double dt)
+{
+  float const * dn = phi - stride;
+  float const * up = phi + stride;
+  __m256d const zero = _mm256_setzero_pd ();
+  __m256d const sign = _mm256_set1_pd (-0.0);
+  __m256d const vdt = _mm256_set1_pd (dt);
+  size_t ii;
+  
+  // Four floats widen to one register of doubles, then the same
+  // sequence as _pfolsm_row_avx2.
+  
+  for (ii = 0; ii + 4 <= nn; ii += 4) {
+    __m256d const cc = loadcvt (phi + ii);
+    __m256d const dxm = _mm256_sub_pd (cc, loadcvt (phi + ii - 1));
+    __m256d const dxp = _mm256_sub_pd (loadcvt (phi + ii + 1), cc);
+    __m256d const dym = _mm256_sub_pd (cc, loadcvt (dn + ii));
+    __m256d const dyp = _mm256_sub_pd (loadcvt (up + ii), cc);
+    __m256d const ss = loadcvt (speed + ii);
+    __m256d const pos = _mm256_cmp_pd (ss, zero, _CMP_GT_OQ);
+    __m256d const flip = _mm256_andnot_pd (pos, sign);
+    __m256d const gx = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dxm, flip),
+						     _mm256_xor_pd (dxp, _mm256_xor_pd (flip, sign))),
+				      zero);
+    __m256d const gy = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dym, flip),
+						     _mm256_xor_pd (dyp, _mm256_xor_pd (flip, sign))),
+				      zero);
+    __m256d const nabla = _mm256_sqrt_pd (_mm256_add_pd (_mm256_mul_pd (gx, gx),
+							 _mm256_mul_pd (gy, gy)));
+    _mm_storeu_ps (next + ii, _mm256_cvtpd_ps (_mm256_sub_pd (cc, _mm256_mul_pd (vdt, _mm256_mul_pd (ss, nabla)))));
+  }
+  
+  _pfolsm_rowm_scalar (phi + ii, speed + ii, next + ii, nn - ii, stride, dt);
+}
+
+
+int _pfolsm_isa_best (void)
+{
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx512f")) {
+    return PFOLSM_ISA_AVX512;
+  }
+  if (__builtin_cpu_supports ("avx2")) {
+    return PFOLSM_ISA_AVX2;
+  }
+  if (__builtin_cpu_supports ("sse2")) {
+    return PFOLSM_ISA_SSE2;
+  }
+  return PFOLSM_ISA_SCALAR;
+}
+
+
+#else // PFOLSM_HAVE_X86
+
+
+int _pfolsm_isa_best (void)
+{
+  return PFOLSM_ISA_SCALAR;
+}
+
+
+#endif // PFOLSM_HAVE_X86
+
+
+pfolsm_rowf_t _pfolsm_rowf_kernel (int isa)
+{
+  if (isa < 0 || isa > _pfolsm_isa_best ()) {
+    return 0;
+  }
+  switch (isa) {
+#ifdef PFOLSM_HAVE_X86
+  case PFOLSM_ISA_SSE2:
+    return _pfolsm_rowf_sse2;
+  case PFOLSM_ISA_AVX2:
+    return _pfolsm_rowf_avx2;
+  case PFOLSM_ISA_AVX512:
+    return _pfolsm_rowf_avx512;
+#endif
+  default:
+    return _pfolsm_rowf_scalar;
+  }
+}
+
+
+pfolsm_rowf_t _pfolsm_rowm_kernel (int isa)
+{
+#ifdef PFOLSM_HAVE_X86
+  if (isa >= PFOLSM_ISA_AVX2 && _pfolsm_isa_best () >= PFOLSM_ISA_AVX2) {
+    return _pfolsm_rowm_avx2;
+  }
+#endif
+  return _pfolsm_rowm_scalar;
+}
+
+
+pfolsm_rate_t _pfolsm_rate_kernel (int isa)
+{
+#ifdef PFOLSM_HAVE_X86
+  if (isa >= PFOLSM_ISA_AVX2 && _pfolsm_isa_best () >= PFOLSM_ISA_AVX2) {
+    return _pfolsm_rate_avx2;
+  }
+#endif
+  return _pfolsm_rate_scalar;
+}
+
+
+pfolsm_row_t _pfolsm_row_kernel (int isa)
+{
+  if (isa < 0 || isa > _pfolsm_isa_best ()) {
+    return 0;
+  }
+  switch (isa) {
+#ifdef PFOLSM_HAVE_X86
+  case PFOLSM_ISA_SSE2:
+    return _pfolsm_row_sse2;
+  case PFOLSM_ISA_AVX2:
+    return _pfolsm_row_avx2;
+  case PFOLSM_ISA_AVX512:
+    return _pfolsm_row_avx512;
+#endif
+  default:
+    return _pfolsm_row_scalar;
+  }
+}
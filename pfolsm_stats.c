@@ -0,0 +1,250 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pfolsm_stats.h"
+
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# define PFOLSM_HAVE_X86
+# include <x86intrin.h>
+#endif
+
+
+static double now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+
+static uint64_t cycles (void)
+{
+#ifdef PFOLSM_HAVE_X86
+  return __rdtsc ();
+#else
+  return 0;
+#endif
+}
+
+
+int pfolsm_stats_enable (pfolsm_t * pp, size_t tracecap)
+{
+#ifdef PFOLSM_STATS
+  size_t const nw = pp->pool ? _pfolsm_pool_size (pp->pool) : 1;
+  pfolsm_stats_t * st;
+  size_t iw;
+  
+  pfolsm_stats_disable (pp);
+  st = calloc (1, sizeof(*st));
+  if (0 == st) {
+    return -1;
+  }
+  st->nthreads = nw;
+  st->tracecap = tracecap;
+  st->epoch = now ();
+  st->thread = calloc (nw, sizeof(*st->thread));
+  if (0 == st->thread) {
+    free (st);
+    return -1;
+  }
+  pp->stats = st;
+  for (iw = 0; tracecap > 0 && iw < nw; ++iw) {
+    st->thread[iw].trace = malloc (tracecap * sizeof(*st->thread[iw].trace));
+    if (0 == st->thread[iw].trace) {
+      pfolsm_stats_disable (pp);
+      return -1;
+    }
+  }
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+
+void pfolsm_stats_disable (pfolsm_t * pp)
+{
+  pfolsm_stats_t * st = pp->stats;
+  size_t iw;
+  
+  if (0 == st) {
+    return;
+  }
+  for (iw = 0; iw < st->nthreads; ++iw) {
+    free (st->thread[iw].trace);
+  }
+  free (st->thread);
+  free (st);
+  pp->stats = 0;
+}
+
+
+void pfolsm_stats_total (pfolsm_t const * pp, unsigned stage,
+			 struct pfolsm_stage_s * total)
+{
+  size_t iw;
+  
+  memset (total, 0, sizeof(*total));
+  if (0 == pp->stats || stage >= PFOLSM_NSTAGE) {
+    return;
+  }
+  for (iw = 0; iw < pp->stats->nthreads; ++iw) {
+    struct pfolsm_stage_s const * ss = pp->stats->thread[iw].stage + stage;
+    total->ncall += ss->ncall;
+    total->cells += ss->cells;
+    total->cycles += ss->cycles;
+    total->seconds += ss->seconds;
+  }
+}
+
+
+char const * pfolsm_stats_name (unsigned stage)
+{
+  static char const * name[PFOLSM_NSTAGE] = {
+    "update", "cbounds", "speed", "diff", "nabla", "cphinext",
+    "fused", "nband", "weno", "rate", "reinit"
+  };
+  return stage < PFOLSM_NSTAGE ? name[stage] : "unknown";
+}
+
+
+int pfolsm_stats_trace (pfolsm_t const * pp, FILE * fp)
+{
+  pfolsm_stats_t const * st = pp->stats;
+  char const * sep = "";
+  size_t iw, ii;
+  
+  fprintf (fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+  for (iw = 0; st && iw < st->nthreads; ++iw) {
+    fprintf (fp, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu,"
+	     " \"args\": {\"name\": \"pfolsm %zu\"}}", sep, iw, iw);
+    sep = ",";
+    for (ii = 0; ii < st->thread[iw].ntrace; ++ii) {
+      struct pfolsm_trace_s const * tr = st->thread[iw].trace + ii;
+      fprintf (fp, ",\n{\"name\": \"%s\", \"cat\": \"pfolsm\", \"ph\": \"X\", \"pid\": 1,"
+	       " \"tid\": %zu, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"cells\": %llu}}",
+	       pfolsm_stats_name (tr->stage), iw, 1e6 * tr->start, 1e6 * tr->dur,
+	       (unsigned long long) tr->cells);
+    }
+  }
+  fprintf (fp, "\n]}\n");
+  return ferror (fp) ? -1 : 0;
+}
+
+
+pfolsm_stats_mark_t _pfolsm_stats_begin (void)
+{
+  pfolsm_stats_mark_t mark;
+  mark.t0 = now ();
+  mark.c0 = cycles ();
+  return mark;
+}
+
+
+void _pfolsm_stats_end (pfolsm_t const * pp, pfolsm_stats_mark_t const * mark,
+			unsigned stage, size_t iw, uint64_t cells)
+{
+  pfolsm_stats_t * st = pp->stats;
+  struct pfolsm_stats_thread_s * th;
+  double dur;
+  
+  if (0 == st || iw >= st->nthreads) {
+    return;
+  }
+  th = st->thread + iw;
+  dur = now () - mark->t0;
+  
+  th->stage[stage].ncall += 1;
+  th->stage[stage].cells += cells;
+  th->stage[stage].cycles += cycles () - mark->c0;
+  th->stage[stage].seconds += dur;
+  if (PFOLSM_STAGE_UPDATE != stage) {
+    th->busy += dur;
+  }
+  
+  if (th->ntrace < st->tracecap) {
+    struct pfolsm_trace_s * tr = th->trace + th->ntrace++;
+    tr->start = mark->t0 - st->epoch;
+    tr->dur = dur;
+    tr->cells = cells;
+    tr->stage = stage;
+  }
+  else if (st->tracecap > 0) {
+    ++th->ndropped;
+  }
+}
+
+
+void _pfolsm_stats_fork (pfolsm_t const * pp)
+{
+  pfolsm_stats_t * st = pp->stats;
+  size_t iw;
+  
+  for (iw = 0; st && iw < st->nthreads; ++iw) {
+    st->thread[iw].busy = 0.0;
+  }
+}
+
+
+void _pfolsm_stats_parallel (pfolsm_t const * pp)
+{
+  pfolsm_stats_t * st = pp->stats;
+  double sum = 0.0, max = 0.0;
+  size_t iw;
+  
+  if (0 == st) {
+    return;
+  }
+  for (iw = 0; iw < st->nthreads; ++iw) {
+    double const busy = st->thread[iw].busy;
+    sum += busy;
+    if (busy > max) {
+      max = busy;
+    }
+  }
+  if (sum > 0.0) {
+    double const imb = max * st->nthreads / sum - 1.0;
+    st->imbalance += imb;
+    if (imb > st->imbalance_max) {
+      st->imbalance_max = imb;
+    }
+    ++st->nparallel;
+  }
+}
@@ -0,0 +1,173 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_STATS_H
+#define PFOLSM_STATS_H
+
+#include "pfolsm.h"
+
+#include <stdint.h>
+
+
+/*
+ * Per-stage instrumentation of the update. The hooks in the hot path
+ * only exist when the library is compiled with -DPFOLSM_STATS, and
+ * then cost nothing but a pointer test until pfolsm_stats_enable is
+ * called for a particular pfolsm_t.
+ */
+
+#define PFOLSM_STAGE_UPDATE   0	/* all of one pfolsm_update */
+#define PFOLSM_STAGE_CBOUNDS  1	/* ghost cells */
+#define PFOLSM_STAGE_SPEED    2	/* speed model */
+#define PFOLSM_STAGE_DIFF     3	/* multi-pass differences */
+#define PFOLSM_STAGE_NABLA    4	/* multi-pass gradient */
+#define PFOLSM_STAGE_CPHINEXT 5	/* multi-pass update */
+#define PFOLSM_STAGE_FUSED    6	/* fused gradient and update rows */
+#define PFOLSM_STAGE_NBAND    7	/* fused update of the narrow band */
+#define PFOLSM_STAGE_WENO     8	/* all Runge-Kutta stages of WENO */
+#define PFOLSM_STAGE_RATE     9	/* CFL pass of pfolsm_update_cfl */
+#define PFOLSM_STAGE_REINIT  10	/* lazy reinitialization */
+#define PFOLSM_NSTAGE        11
+
+
+/** Accumulated cost of one stage. */
+struct pfolsm_stage_s {
+  uint64_t ncall;
+  uint64_t cells;
+  uint64_t cycles;		/* time stamp counter, 0 where there is none */
+  double seconds;
+};
+
+
+/** Timeline entry, in seconds since pfolsm_stats_enable. */
+struct pfolsm_trace_s {
+  double start, dur;
+  uint64_t cells;
+  unsigned stage;
+};
+
+
+/**
+   What one thread of the pool recorded. Thread 0 is the caller,
+   which also records everything outside of the pool.
+*/
+struct pfolsm_stats_thread_s {
+  struct pfolsm_stage_s stage[PFOLSM_NSTAGE];
+  double busy;			/* since the current parallel run started */
+  struct pfolsm_trace_s * trace;
+  size_t ntrace, ndropped;
+};
+
+
+struct pfolsm_stats_s {
+  size_t nthreads;
+  struct pfolsm_stats_thread_s * thread;
+  size_t tracecap;		/* trace entries per thread */
+  double epoch;
+  size_t nparallel;		/* parallel runs of the fused update */
+  double imbalance;		/* sum over them of max / mean busy - 1 */
+  double imbalance_max;
+};
+
+typedef struct pfolsm_stats_s pfolsm_stats_t;
+
+
+/** Start of a measured section. */
+typedef struct {
+  double t0;
+  uint64_t c0;
+} pfolsm_stats_mark_t;
+
+
+#ifdef PFOLSM_STATS
+# define PFOLSM_STATS_BEGIN(mark) \
+  pfolsm_stats_mark_t const mark = _pfolsm_stats_begin ()
+# define PFOLSM_STATS_END(pp, mark, stage, iw, cells) \
+  _pfolsm_stats_end ((pp), &(mark), (stage), (iw), (cells))
+# define PFOLSM_STATS_FORK(pp) \
+  _pfolsm_stats_fork (pp)
+# define PFOLSM_STATS_PARALLEL(pp) \
+  _pfolsm_stats_parallel (pp)
+#else
+# define PFOLSM_STATS_BEGIN(mark)
+# define PFOLSM_STATS_END(pp, mark, stage, iw, cells)
+# define PFOLSM_STATS_FORK(pp)
+# define PFOLSM_STATS_PARALLEL(pp)
+#endif
+
+
+/**
+   Start recording into a fresh pp->stats, with room for tracecap
+   timeline entries per thread (0 for none). Calling it again resets
+   everything, and pfolsm_threads does that as well. Returns -1 if
+   the library was built without PFOLSM_STATS.
+*/
+int pfolsm_stats_enable (pfolsm_t * pp, size_t tracecap);
+
+void pfolsm_stats_disable (pfolsm_t * pp);
+
+/** Sum of one stage over all threads. */
+void pfolsm_stats_total (pfolsm_t const * pp, unsigned stage,
+			 struct pfolsm_stage_s * total);
+
+/** Name of a stage, as used in the trace. */
+char const * pfolsm_stats_name (unsigned stage);
+
+/**
+   Write the timeline as Chrome trace event JSON, which chrome://tracing
+   and Perfetto can display, with one track per thread.
+*/
+int pfolsm_stats_trace (pfolsm_t const * pp, FILE * fp);
+
+
+pfolsm_stats_mark_t _pfolsm_stats_begin (void);
+
+/** Account for the section started at mark, done by thread iw. */
+void _pfolsm_stats_end (pfolsm_t const * pp, pfolsm_stats_mark_t const * mark,
+			unsigned stage, size_t iw, uint64_t cells);
+
+/**
+   Start the busy times of a parallel run from zero, so that serial
+   sections of thread 0 before it do not count.
+*/
+void _pfolsm_stats_fork (pfolsm_t const * pp);
+
+/** Fold the busy times of a parallel run into the imbalance. */
+void _pfolsm_stats_parallel (pfolsm_t const * pp);
+
+
+#endif
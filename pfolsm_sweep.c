@@ -0,0 +1,243 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pfolsm_sweep.h"
+#include "pfolsm_fmm.h"
+
+#include <math.h>
+#include <string.h>
+
+
+struct sweep_s {
+  pfolsm_t const * pp;
+  double * tt;
+  unsigned char const * fixed;
+  size_t nbx, nby;		/* number of blocks */
+  int sx, sy;			/* sweep direction, +1 or -1 */
+  double * change;		/* largest change, one per thread */
+};
+
+
+static double speed_at (pfolsm_t const * pp, size_t idx)
+{
+  return pp->fspeed ? pp->fspeed[idx] : pp->speed[idx];
+}
+
+
+/**
+   Same upwind solution as the fast marching module, but using the
+   current values of all four neighbors.
+*/
+static double solve (double const * tt, size_t idx, size_t nx, double speed)
+{
+  double const rs = 1.0 / speed;
+  double aa = tt[idx - 1] < tt[idx + 1] ? tt[idx - 1] : tt[idx + 1];
+  double bb = tt[idx - nx] < tt[idx + nx] ? tt[idx - nx] : tt[idx + nx];
+  
+  if (aa > bb) {
+    double const tmp = aa;
+    aa = bb;
+    bb = tmp;
+  }
+  if (isinf (bb) || bb - aa >= rs) {
+    return aa + rs;
+  }
+  return 0.5 * (aa + bb + sqrt (2.0 * rs * rs - (bb - aa) * (bb - aa)));
+}
+
+
+/**
+   Gauss-Seidel pass over block (bi, bj), given in sweep order, with
+   cells also visited in sweep order.
+*/
+static double sweep_block (struct sweep_s const * sw, size_t bi, size_t bj)
+{
+  pfolsm_t const * pp = sw->pp;
+  size_t const bx = sw->sx > 0 ? bi : sw->nbx - 1 - bi;
+  size_t const by = sw->sy > 0 ? bj : sw->nby - 1 - bj;
+  size_t const i0 = 1 + bx * PFOLSM_SWEEP_BLOCK;
+  size_t const j0 = 1 + by * PFOLSM_SWEEP_BLOCK;
+  size_t const ni = (i0 + PFOLSM_SWEEP_BLOCK - 1 > pp->dimx ? pp->dimx + 1 - i0 : PFOLSM_SWEEP_BLOCK);
+  size_t const nj = (j0 + PFOLSM_SWEEP_BLOCK - 1 > pp->dimy ? pp->dimy + 1 - j0 : PFOLSM_SWEEP_BLOCK);
+  double change = 0.0;
+  size_t ii, jj;
+  
+  for (jj = 0; jj < nj; ++jj) {
+    size_t const row = (sw->sy > 0 ? j0 + jj : j0 + nj - 1 - jj) * pp->nx;
+    for (ii = 0; ii < ni; ++ii) {
+      size_t const idx = row + (sw->sx > 0 ? i0 + ii : i0 + ni - 1 - ii);
+      double const speed = speed_at (pp, idx);
+      double tnew;
+      if (sw->fixed[idx] || ! (speed > 0.0)) {
+	continue;
+      }
+      tnew = solve (sw->tt, idx, pp->nx, speed);
+      if (tnew < sw->tt[idx]) {
+	if (isinf (sw->tt[idx]) || sw->tt[idx] - tnew > change) {
+	  change = isinf (sw->tt[idx]) ? INFINITY : sw->tt[idx] - tnew;
+	}
+	sw->tt[idx] = tnew;
+      }
+    }
+  }
+  return change;
+}
+
+
+/**
+   Blocks on one anti-diagonal only touch blocks on the neighboring
+   anti-diagonals, which are either completely done (upstream) or not
+   yet started (downstream), exactly as in a serial sweep.
+*/
+static void sweep_task (void * arg, size_t iw, size_t nw)
+{
+  struct sweep_s const * sw = arg;
+  size_t const ndiag = sw->nbx + sw->nby - 1;
+  size_t dd, b0, b1, kk;
+  
+  sw->change[iw] = 0.0;
+  for (dd = 0; dd < ndiag; ++dd) {
+    size_t const bi0 = dd < sw->nby ? 0 : dd - sw->nby + 1;
+    size_t const bi1 = dd < sw->nbx ? dd : sw->nbx - 1;
+    _pfolsm_split (bi1 - bi0 + 1, iw, nw, &b0, &b1);
+    for (kk = b0; kk <= b1; ++kk) {
+      size_t const bi = bi0 + kk - 1;
+      double const change = sweep_block (sw, bi, dd - bi);
+      if (change > sw->change[iw]) {
+	sw->change[iw] = change;
+      }
+    }
+    if (nw > 1) {
+      _pfolsm_pool_sync (sw->pp->pool);
+    }
+  }
+}
+
+
+/**
+   Fix the seeds, or the zero level of phi when there are none, like
+   pfolsm_fmm_arrival does.
+*/
+static void seed_arrival (pfolsm_t const * pp, size_t const * seed, size_t nseed,
+			  double * tt, unsigned char * fixed)
+{
+  size_t ii, jj;
+  
+  for (ii = 0; ii < pp->ntt; ++ii) {
+    tt[ii] = INFINITY;
+  }
+  memset (fixed, 0, pp->ntt);
+  
+  if (nseed > 0) {
+    for (ii = 0; ii < nseed; ++ii) {
+      tt[seed[ii]] = 0.0;
+      fixed[seed[ii]] = 1;
+    }
+    return;
+  }
+  for (jj = 1; jj <= pp->dimy; ++jj) {
+    for (ii = 1; ii <= pp->dimx; ++ii) {
+      size_t const idx = ii + jj * pp->nx;
+      double const speed = speed_at (pp, idx);
+      double dd;
+      if (pfolsm_get (pp, ii, jj) <= 0.0) {
+	tt[idx] = 0.0;
+	fixed[idx] = 1;
+      }
+      else if (speed > 0.0 && isfinite (dd = _pfolsm_front_dist (pp, idx))) {
+	tt[idx] = dd / speed;
+	fixed[idx] = 1;
+      }
+    }
+  }
+}
+
+
+int pfolsm_sweep_arrival (pfolsm_t const * pp,
+			  size_t const * seed, size_t nseed,
+			  double * arrival,
+			  size_t maxround, double tol)
+{
+  static int const dir[4][2] = { { 1, 1 }, { -1, 1 }, { -1, -1 }, { 1, -1 } };
+  size_t const nw = pp->pool ? _pfolsm_pool_size (pp->pool) : 1;
+  struct sweep_s sw;
+  unsigned char * fixed;
+  size_t round, kk, iw;
+  double change;
+  
+  fixed = malloc (pp->ntt);
+  sw.change = malloc (nw * sizeof(double));
+  if (0 == fixed || 0 == sw.change) {
+    free (fixed);
+    free (sw.change);
+    return -1;
+  }
+  seed_arrival (pp, seed, nseed, arrival, fixed);
+  
+  sw.pp = pp;
+  sw.tt = arrival;
+  sw.fixed = fixed;
+  sw.nbx = (pp->dimx + PFOLSM_SWEEP_BLOCK - 1) / PFOLSM_SWEEP_BLOCK;
+  sw.nby = (pp->dimy + PFOLSM_SWEEP_BLOCK - 1) / PFOLSM_SWEEP_BLOCK;
+  
+  for (round = 0; round < maxround; ) {
+    change = 0.0;
+    for (kk = 0; kk < 4; ++kk) {
+      sw.sx = dir[kk][0];
+      sw.sy = dir[kk][1];
+      if (pp->pool) {
+	_pfolsm_pool_run (pp->pool, sweep_task, &sw);
+      }
+      else {
+	sweep_task (&sw, 0, 1);
+      }
+      for (iw = 0; iw < nw; ++iw) {
+	if (sw.change[iw] > change) {
+	  change = sw.change[iw];
+	}
+      }
+    }
+    ++round;
+    if (change <= tol) {
+      break;
+    }
+  }
+  
+  free (fixed);
+  free (sw.change);
+  return round;
+}
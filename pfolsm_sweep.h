@@ -0,0 +1,64 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_SWEEP_H
+#define PFOLSM_SWEEP_H
+
+#include "pfolsm.h"
+
+
+/** Side of the square blocks that threads sweep in parallel. */
+#define PFOLSM_SWEEP_BLOCK 64
+
+
+/**
+   First arrival times by fast sweeping (Zhao 2005): Gauss-Seidel
+   passes over the grid in the four diagonal directions, with the same
+   discretization, seeds, and conventions as pfolsm_fmm_arrival. A
+   round of four sweeps is repeated until no arrival time changes by
+   more than tol, or maxround rounds have been done. If pp has a
+   thread pool, each sweep proceeds as a wavefront of blocks along
+   anti-diagonals, which gives bit-identical results. Returns the
+   number of rounds, or -1 if allocation fails.
+*/
+int pfolsm_sweep_arrival (pfolsm_t const * pp,
+			  size_t const * seed, size_t nseed,
+			  double * arrival,
+			  size_t maxround, double tol);
+
+
+#endif
@@ -0,0 +1,434 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pfolsm_tile.h"
+#include "pfolsm_sched.h"
+
+#include <math.h>
+
+#define TN  (PFOLSM_TILE + 2)
+#define TNN (TN * TN)
+
+
+static pfolsm_tile_t * tile_alloc (pfolsm_tiled_t * tp, size_t kk)
+{
+  pfolsm_tile_t * tt;
+  double far;
+  size_t ii;
+  
+  if (tp->nlive >= tp->livecap) {
+    size_t const nc = tp->livecap ? 2 * tp->livecap : 64;
+    size_t * nl = realloc (tp->live, nc * sizeof(*nl));
+    if (0 == nl) {
+      return 0;
+    }
+    tp->live = nl;
+    tp->livecap = nc;
+  }
+  
+  tt = calloc (1, sizeof(*tt));
+  if (0 == tt) {
+    return 0;
+  }
+  tt->speed = malloc (3 * TNN * sizeof(double));
+  if (0 == tt->speed) {
+    free (tt);
+    return 0;
+  }
+  tt->phi = tt->speed + TNN;
+  tt->phinext = tt->phi + TNN;
+  
+  far = tp->sign[kk] * tp->clamp;
+  for (ii = 0; ii < TNN; ++ii) {
+    tt->speed[ii] = tp->fspeed;
+    tt->phi[ii] = far;
+    tt->phinext[ii] = far;
+  }
+  
+  tt->ti = kk % tp->ntx;
+  tt->tj = kk / tp->ntx;
+  tt->dimx = tp->dimx - tt->ti * PFOLSM_TILE;
+  if (tt->dimx > PFOLSM_TILE) {
+    tt->dimx = PFOLSM_TILE;
+  }
+  tt->dimy = tp->dimy - tt->tj * PFOLSM_TILE;
+  if (tt->dimy > PFOLSM_TILE) {
+    tt->dimy = PFOLSM_TILE;
+  }
+  tt->active = 0;
+  tt->uniform = tp->sign[kk];
+  tt->custom = 0;
+  
+  tp->tile[kk] = tt;
+  tp->live[tp->nlive++] = kk;
+  
+  return tt;
+}
+
+
+static void tile_free (pfolsm_tile_t * tt)
+{
+  if (tt) {
+    free (tt->speed);
+    free (tt);
+  }
+}
+
+
+int pfolsm_tiled_create (pfolsm_tiled_t * tp,
+			 size_t dimx,
+			 size_t dimy,
+			 double clamp)
+{
+  size_t ii;
+  
+  if (dimx < 2) {
+    dimx = 2;
+  }
+  if (dimy < 2) {
+    dimy = 2;
+  }
+  
+  tp->dimx   = dimx;
+  tp->dimy   = dimy;
+  tp->ntx    = (dimx + PFOLSM_TILE - 1) / PFOLSM_TILE;
+  tp->nty    = (dimy + PFOLSM_TILE - 1) / PFOLSM_TILE;
+  tp->clamp  = clamp;
+  tp->fspeed = 1.0;
+  tp->live   = 0;
+  tp->nlive  = 0;
+  tp->livecap = 0;
+  tp->row    = _pfolsm_row_kernel (_pfolsm_isa_best ());
+  tp->sched  = 0;
+  
+  tp->tile = calloc (tp->ntx * tp->nty, sizeof(*tp->tile));
+  if (0 == tp->tile) {
+    return -1;
+  }
+  tp->sign = malloc (tp->ntx * tp->nty);
+  if (0 == tp->sign) {
+    free (tp->tile);
+    return -1;
+  }
+  for (ii = 0; ii < tp->ntx * tp->nty; ++ii) {
+    tp->sign[ii] = 1;
+  }
+  
+  return 0;
+}
+
+
+void pfolsm_tiled_destroy (pfolsm_tiled_t * tp)
+{
+  size_t ii;
+  for (ii = 0; ii < tp->nlive; ++ii) {
+    tile_free (tp->tile[tp->live[ii]]);
+  }
+  free (tp->live);
+  free (tp->sign);
+  free (tp->tile);
+}
+
+
+double pfolsm_tiled_get (pfolsm_tiled_t const * tp, size_t ii, size_t jj)
+{
+  size_t const kk = (ii - 1) / PFOLSM_TILE + (jj - 1) / PFOLSM_TILE * tp->ntx;
+  pfolsm_tile_t const * tt = tp->tile[kk];
+  if (0 == tt) {
+    return tp->sign[kk] * tp->clamp;
+  }
+  return tt->phi[(ii - 1) % PFOLSM_TILE + 1 + ((jj - 1) % PFOLSM_TILE + 1) * TN];
+}
+
+
+/**
+   Like pfolsm_tiled_get, but also accepts ghost coordinates 0 and
+   dim+1, which get reflected the same way _pfolsm_cbounds does.
+*/
+static double get_ghost (pfolsm_tiled_t const * tp, size_t ii, size_t jj)
+{
+  if (0 == ii) {
+    ii = 2;
+  }
+  else if (tp->dimx + 1 == ii) {
+    ii = tp->dimx - 1;
+  }
+  if (0 == jj) {
+    jj = 2;
+  }
+  else if (tp->dimy + 1 == jj) {
+    jj = tp->dimy - 1;
+  }
+  return pfolsm_tiled_get (tp, ii, jj);
+}
+
+
+int pfolsm_tiled_set (pfolsm_tiled_t * tp, size_t ii, size_t jj, double phi)
+{
+  size_t const kk = (ii - 1) / PFOLSM_TILE + (jj - 1) / PFOLSM_TILE * tp->ntx;
+  size_t const off = (ii - 1) % PFOLSM_TILE + 1 + ((jj - 1) % PFOLSM_TILE + 1) * TN;
+  pfolsm_tile_t * tt = tp->tile[kk];
+  
+  if (phi > tp->clamp) {
+    phi = tp->clamp;
+  }
+  else if (phi < - tp->clamp) {
+    phi = - tp->clamp;
+  }
+  if (0 == tt) {
+    if (phi == tp->sign[kk] * tp->clamp) {
+      return 0;
+    }
+    tt = tile_alloc (tp, kk);
+    if (0 == tt) {
+      return -1;
+    }
+  }
+  
+  tt->phi[off] = phi;
+  tt->phinext[off] = phi;
+  if (fabs (phi) < tp->clamp) {
+    tt->active = 1;
+    tt->uniform = 0;
+  }
+  else if (phi != tt->uniform * tp->clamp) {
+    tt->uniform = 0;
+  }
+  
+  return 0;
+}
+
+
+int pfolsm_tiled_set_speed (pfolsm_tiled_t * tp, size_t ii, size_t jj, double speed)
+{
+  size_t const kk = (ii - 1) / PFOLSM_TILE + (jj - 1) / PFOLSM_TILE * tp->ntx;
+  pfolsm_tile_t * tt = tp->tile[kk];
+  
+  if (0 == tt) {
+    tt = tile_alloc (tp, kk);
+    if (0 == tt) {
+      return -1;
+    }
+  }
+  tt->speed[(ii - 1) % PFOLSM_TILE + 1 + ((jj - 1) % PFOLSM_TILE + 1) * TN] = speed;
+  tt->custom = 1;
+  
+  return 0;
+}
+
+
+static void fill_halo (pfolsm_tiled_t const * tp, pfolsm_tile_t * tt)
+{
+  size_t const gi0 = tt->ti * PFOLSM_TILE;
+  size_t const gj0 = tt->tj * PFOLSM_TILE;
+  double * const phi = tt->phi;
+  size_t ll;
+  
+  for (ll = 1; ll <= tt->dimx; ++ll) {
+    phi[ll] = get_ghost (tp, gi0 + ll, gj0);
+    phi[ll + (tt->dimy + 1) * TN] = get_ghost (tp, gi0 + ll, gj0 + tt->dimy + 1);
+  }
+  for (ll = 1; ll <= tt->dimy; ++ll) {
+    phi[ll * TN] = get_ghost (tp, gi0, gj0 + ll);
+    phi[ll * TN + tt->dimx + 1] = get_ghost (tp, gi0 + tt->dimx + 1, gj0 + ll);
+  }
+}
+
+
+static int neighbor_active (pfolsm_tiled_t const * tp, pfolsm_tile_t const * tt)
+{
+  size_t ii, jj;
+  for (jj = tt->tj ? tt->tj - 1 : 0; jj <= tt->tj + 1 && jj < tp->nty; ++jj) {
+    for (ii = tt->ti ? tt->ti - 1 : 0; ii <= tt->ti + 1 && ii < tp->ntx; ++ii) {
+      pfolsm_tile_t const * nt = tp->tile[ii + jj * tp->ntx];
+      if (nt && nt != tt && nt->active) {
+	return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+
+int pfolsm_tiled_gc (pfolsm_tiled_t * tp)
+{
+  size_t const nold = tp->nlive;
+  size_t ll, ii, jj, nkeep;
+  
+  // Tiles next to the front must exist before it gets there.
+  
+  for (ll = 0; ll < nold; ++ll) {
+    pfolsm_tile_t const * tt = tp->tile[tp->live[ll]];
+    if ( ! tt->active) {
+      continue;
+    }
+    for (jj = tt->tj ? tt->tj - 1 : 0; jj <= tt->tj + 1 && jj < tp->nty; ++jj) {
+      for (ii = tt->ti ? tt->ti - 1 : 0; ii <= tt->ti + 1 && ii < tp->ntx; ++ii) {
+	if (0 == tp->tile[ii + jj * tp->ntx]
+	    && 0 == tile_alloc (tp, ii + jj * tp->ntx)) {
+	  return -1;
+	}
+      }
+    }
+  }
+  
+  // Tiles that only hold the far value, and that no front is going to
+  // reach within the next step, can go.
+  
+  nkeep = 0;
+  for (ll = 0; ll < tp->nlive; ++ll) {
+    size_t const kk = tp->live[ll];
+    pfolsm_tile_t * tt = tp->tile[kk];
+    if (tt->uniform && ! tt->custom && ! tt->active && ! neighbor_active (tp, tt)) {
+      tp->sign[kk] = tt->uniform;
+      tp->tile[kk] = 0;
+      tile_free (tt);
+    }
+    else {
+      tp->live[nkeep++] = kk;
+    }
+  }
+  tp->nlive = nkeep;
+  
+  return 0;
+}
+
+
+static void update_tile (pfolsm_tiled_t const * tp, pfolsm_tile_t * tt, double dt)
+{
+  double const clamp = tp->clamp;
+  size_t ii, jj;
+  int allpos, allneg;
+  
+  fill_halo (tp, tt);
+  
+  tt->active = 0;
+  allpos = 1;
+  allneg = 1;
+  for (jj = 1; jj <= tt->dimy; ++jj) {
+    double * next = tt->phinext + jj * TN + 1;
+    tp->row (tt->phi + jj * TN + 1, tt->speed + jj * TN + 1, next, tt->dimx, TN, dt);
+    for (ii = 0; ii < tt->dimx; ++ii) {
+      if (next[ii] >= clamp) {
+	next[ii] = clamp;
+	allneg = 0;
+      }
+      else if (next[ii] <= - clamp) {
+	next[ii] = - clamp;
+	allpos = 0;
+      }
+      else {
+	tt->active = 1;
+	allpos = 0;
+	allneg = 0;
+      }
+    }
+  }
+  tt->uniform = allpos ? 1 : (allneg ? -1 : 0);
+}
+
+
+struct update_s {
+  pfolsm_tiled_t const * tp;
+  double dt;
+};
+
+
+static double update_job (void * arg, size_t ijob, size_t iw)
+{
+  struct update_s const * up = arg;
+  update_tile (up->tp, up->tp->tile[up->tp->live[ijob]], up->dt);
+  return 0.0;
+}
+
+
+int pfolsm_tiled_update (pfolsm_tiled_t * tp, double dt)
+{
+  size_t ll;
+  
+  // All tiles read the current phi of their neighbors, so the swap
+  // has to wait until every tile is done.
+  
+  if (tp->sched) {
+    struct update_s arg;
+    arg.tp = tp;
+    arg.dt = dt;
+    if (0 != pfolsm_sched_run (tp->sched, tp->nlive, update_job, &arg, 0)) {
+      return -1;
+    }
+  }
+  else {
+    for (ll = 0; ll < tp->nlive; ++ll) {
+      update_tile (tp, tp->tile[tp->live[ll]], dt);
+    }
+  }
+  for (ll = 0; ll < tp->nlive; ++ll) {
+    pfolsm_tile_t * tt = tp->tile[tp->live[ll]];
+    double * tmp = tt->phi;
+    tt->phi = tt->phinext;
+    tt->phinext = tmp;
+  }
+  
+  return pfolsm_tiled_gc (tp);
+}
+
+
+void pfolsm_tiled_sched (pfolsm_tiled_t * tp, struct pfolsm_sched_s * ps)
+{
+  tp->sched = ps;
+}
+
+
+void pfolsm_tiled_dump (pfolsm_tiled_t const * tp,
+			FILE * fp)
+{
+  size_t ii, jj;
+  
+  fprintf (fp, "==================================================\n");
+  fprintf (fp, "phi\n");
+  for (jj = tp->dimy + 1; jj <= tp->dimy + 1 /* until overflow */; --jj) {
+    for (ii = 0; ii <= tp->dimx + 1; ++ii) {
+      if ((0 == ii || tp->dimx + 1 == ii) && (0 == jj || tp->dimy + 1 == jj)) {
+	_pfolsm_pnum6 (fp, NAN);
+      }
+      else {
+	_pfolsm_pnum6 (fp, get_ghost (tp, ii, jj));
+      }
+    }
+    fprintf (fp, "\n");
+  }
+}
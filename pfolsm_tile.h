@@ -0,0 +1,131 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PFOLSM_TILE_H
+#define PFOLSM_TILE_H
+
+#include "pfolsm.h"
+
+
+/** Number of interior cells along each side of a tile. */
+#define PFOLSM_TILE 64
+
+
+/**
+   One allocated tile: PFOLSM_TILE x PFOLSM_TILE cells plus a one
+   cell halo, stored like the planes of pfolsm_t with stride
+   PFOLSM_TILE + 2.
+*/
+struct pfolsm_tile_s {
+  double * speed;
+  double * phi;
+  double * phinext;
+  size_t ti, tj;		/* tile coordinates */
+  size_t dimx, dimy;		/* cells actually inside the domain */
+  int active;			/* some |phi| is below the clamp value */
+  int uniform;			/* +1 or -1 if phi is the far value everywhere */
+  int custom;			/* speed was set explicitly */
+};
+
+typedef struct pfolsm_tile_s pfolsm_tile_t;
+
+
+/**
+   Sparse tiled level set. The domain is split into tiles, which are
+   only allocated near the zero level of phi. Everywhere else, phi is
+   a constant far value of +/- clamp (with a per-tile sign) and speed
+   is fspeed. The update, the reflective boundary, and the dump behave
+   like those of a dense pfolsm_t whose phi is clamped to
+   [-clamp, clamp] after each step. Cells within a few cells of the
+   front therefore evolve exactly like in the dense engine.
+*/
+struct pfolsm_tiled_s {
+  size_t dimx, dimy;
+  size_t ntx, nty;		/* number of tiles along x and y */
+  double clamp;
+  double fspeed;
+  pfolsm_tile_t ** tile;	/* ntx * nty entries, 0 for far tiles */
+  signed char * sign;		/* sign of the far value of each tile */
+  size_t * live;		/* indices of allocated tiles */
+  size_t nlive, livecap;
+  pfolsm_row_t row;
+  struct pfolsm_sched_s * sched; /* not owned, see pfolsm_tiled_sched */
+};
+
+typedef struct pfolsm_tiled_s pfolsm_tiled_t;
+
+
+int pfolsm_tiled_create (pfolsm_tiled_t * tp,
+			 size_t dimx,
+			 size_t dimy,
+			 double clamp);
+
+void pfolsm_tiled_destroy (pfolsm_tiled_t * tp);
+
+/** Cell coordinates are 1-based, like the interior of pfolsm_t. */
+double pfolsm_tiled_get (pfolsm_tiled_t const * tp, size_t ii, size_t jj);
+
+/**
+   Set phi at a cell, clamped to [-clamp, clamp]. Only allocates the
+   tile if the value differs from the tile's far value, so setting
+   far values is cheap. Returns -1 if allocation fails.
+*/
+int pfolsm_tiled_set (pfolsm_tiled_t * tp, size_t ii, size_t jj, double phi);
+
+/** Set speed at a cell, which always allocates its tile. */
+int pfolsm_tiled_set_speed (pfolsm_tiled_t * tp, size_t ii, size_t jj, double speed);
+
+/**
+   Allocate tiles around the front and release tiles that hold
+   nothing but the far value. Called by pfolsm_tiled_update, but
+   useful after setting phi from the outside.
+*/
+int pfolsm_tiled_gc (pfolsm_tiled_t * tp);
+
+int pfolsm_tiled_update (pfolsm_tiled_t * tp, double dt);
+
+/**
+   Update the live tiles as jobs of ps from now on, or serially again
+   if ps is null. The tiles come out the same either way.
+*/
+void pfolsm_tiled_sched (pfolsm_tiled_t * tp, struct pfolsm_sched_s * ps);
+
+void pfolsm_tiled_dump (pfolsm_tiled_t const * tp,
+			FILE * fp);
+
+
+#endif
@@ -0,0 +1,388 @@
+/*
+ * Planar First-Order Level Set Method.
+ * 
+ * Copyright (C) 2012 Roland Philippsen. All rights reserved.
+ *
+ * Released under the BSD 3-Clause License.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in
+ *   the documentation and/or other materials provided with the
+ *   distribution.
+ * 
+ * - Neither the name of the copyright holder nor the names of
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Higher order engine: fifth order WENO differences (Jiang and Peng
+ * 2000) with a Godunov Hamiltonian, and third order TVD Runge-Kutta
+ * in time (Shu and Osher 1988), following Osher and Fedkiw, "Level
+ * Set Methods and Dynamic Implicit Surfaces", chapter 3. The AVX2
+ * kernel uses the same operations in the same order as the scalar
+ * one, so both give identical results.
+ */
+
+#include "pfolsm.h"
+
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# define PFOLSM_HAVE_X86
+# include <immintrin.h>
+#endif
+
+
+/**
+   WENO5 approximation of a one-sided derivative from the five
+   differences v1 to v5, ordered in the upwind direction.
+*/
+static double weno5 (double v1, double v2, double v3, double v4, double v5)
+{
+  double const t1 = (v1 - 2.0 * v2) + v3;
+  double const u1 = (v1 - 4.0 * v2) + 3.0 * v3;
+  double const t2 = (v2 - 2.0 * v3) + v4;
+  double const u2 = v2 - v4;
+  double const t3 = (v3 - 2.0 * v4) + v5;
+  double const u3 = (3.0 * v3 - 4.0 * v4) + v5;
+  double const s1 = (13.0 / 12.0) * (t1 * t1) + 0.25 * (u1 * u1);
+  double const s2 = (13.0 / 12.0) * (t2 * t2) + 0.25 * (u2 * u2);
+  double const s3 = (13.0 / 12.0) * (t3 * t3) + 0.25 * (u3 * u3);
+  double mm = v1 * v1;
+  double eps, e1, e2, e3, a1, a2, a3, p1, p2, p3;
+  
+  mm = v2 * v2 > mm ? v2 * v2 : mm;
+  mm = v3 * v3 > mm ? v3 * v3 : mm;
+  mm = v4 * v4 > mm ? v4 * v4 : mm;
+  mm = v5 * v5 > mm ? v5 * v5 : mm;
+  eps = 1e-6 * mm + 1e-99;
+  e1 = s1 + eps;
+  e2 = s2 + eps;
+  e3 = s3 + eps;
+  a1 = 0.1 / (e1 * e1);
+  a2 = 0.6 / (e2 * e2);
+  a3 = 0.3 / (e3 * e3);
+  p1 = ((2.0 * v1 - 7.0 * v2) + 11.0 * v3) / 6.0;
+  p2 = ((5.0 * v3 - v2) + 2.0 * v4) / 6.0;
+  p3 = ((2.0 * v3 + 5.0 * v4) - v5) / 6.0;
+  return ((a1 * p1 + a2 * p2) + a3 * p3) / ((a1 + a2) + a3);
+}
+
+
+static double max3 (double aa, double bb, double cc)
+{
+  if (aa > bb) {
+    return aa > cc ? aa : cc;
+  }
+  return bb > cc ? bb : cc;
+}
+
+
+/**
+   Godunov gradient magnitude from the WENO5 one-sided derivatives
+   around cc, upwind for the sign of speed.
+*/
+static double weno_nabla (double const * cc, ptrdiff_t ss, double speed)
+{
+  double dx[6], dy[6];
+  double dxm, dxp, dym, dyp, gx, gy;
+  int kk;
+  
+  // dx[kk] is the forward difference at offset kk-3
+  
+  for (kk = 0; kk < 6; ++kk) {
+    dx[kk] = cc[kk - 2] - cc[kk - 3];
+    dy[kk] = cc[(kk - 2) * ss] - cc[(kk - 3) * ss];
+  }
+  dxm = weno5 (dx[0], dx[1], dx[2], dx[3], dx[4]);
+  dxp = weno5 (dx[5], dx[4], dx[3], dx[2], dx[1]);
+  dym = weno5 (dy[0], dy[1], dy[2], dy[3], dy[4]);
+  dyp = weno5 (dy[5], dy[4], dy[3], dy[2], dy[1]);
+  
+  // same Godunov selection as the first order kernels
+  
+  if (speed > 0.0) {
+    gx = max3 (dxm, - dxp, 0.0);
+    gy = max3 (dym, - dyp, 0.0);
+  }
+  else {
+    gx = max3 (- dxm, dxp, 0.0);
+    gy = max3 (- dym, dyp, 0.0);
+  }
+  return sqrt (gx * gx + gy * gy);
+}
+
+
+void _pfolsm_weno_scalar (double const * src,
+			  double const * base,
+			  double const * speed,
+			  double * dst,
+			  size_t nn,
+			  size_t stride,
+			  double dt,
+			  double aa,
+			  double bb)
+{
+  ptrdiff_t const ss = stride;
+  size_t ii;
+  
+  for (ii = 0; ii < nn; ++ii) {
+    double const * cc = src + ii;
+    dst[ii] = aa * base[ii] + bb * (cc[0] - dt * (speed[ii] * weno_nabla (cc, ss, speed[ii])));
+  }
+}
+
+
+double _pfolsm_weno_rate_span (pfolsm_t const * pp, size_t idx, size_t nn)
+{
+  double rmax = 0.0;
+  size_t ii;
+  
+  for (ii = idx; ii < idx + nn; ++ii) {
+    double const rr = fabs (pp->speed[ii]) * weno_nabla (pp->phi + ii, pp->nx, pp->speed[ii]);
+    if (rr > rmax) {
+      rmax = rr;
+    }
+  }
+  return rmax;
+}
+
+
+#ifdef PFOLSM_HAVE_X86
+
+
+__attribute__((target("avx2")))
+static __m256d vmax (__m256d aa, __m256d bb)
+{
+  // returns bb unless aa is strictly greater, like the ternaries above
+  return _mm256_max_pd (aa, bb);
+}
+
+
+__attribute__((target("avx2")))
+static __m256d weno5_avx2 (__m256d v1, __m256d v2, __m256d v3, __m256d v4, __m256d v5)
+{
+  __m256d const c2 = _mm256_set1_pd (2.0);
+  __m256d const c3 = _mm256_set1_pd (3.0);
+  __m256d const c4 = _mm256_set1_pd (4.0);
+  __m256d const c5 = _mm256_set1_pd (5.0);
+  __m256d const c6 = _mm256_set1_pd (6.0);
+  __m256d const c7 = _mm256_set1_pd (7.0);
+  __m256d const c11 = _mm256_set1_pd (11.0);
+  __m256d const c13 = _mm256_set1_pd (13.0 / 12.0);
+  __m256d const cq = _mm256_set1_pd (0.25);
+  __m256d const t1 = _mm256_add_pd (_mm256_sub_pd (v1, _mm256_mul_pd (c2, v2)), v3);
+  __m256d const u1 = _mm256_add_pd (_mm256_sub_pd (v1, _mm256_mul_pd (c4, v2)), _mm256_mul_pd (c3, v3));
+  __m256d const t2 = _mm256_add_pd (_mm256_sub_pd (v2, _mm256_mul_pd (c2, v3)), v4);
+  __m256d const u2 = _mm256_sub_pd (v2, v4);
+  __m256d const t3 = _mm256_add_pd (_mm256_sub_pd (v3, _mm256_mul_pd (c2, v4)), v5);
+  __m256d const u3 = _mm256_add_pd (_mm256_sub_pd (_mm256_mul_pd (c3, v3), _mm256_mul_pd (c4, v4)), v5);
+  __m256d const s1 = _mm256_add_pd (_mm256_mul_pd (c13, _mm256_mul_pd (t1, t1)),
+				    _mm256_mul_pd (cq, _mm256_mul_pd (u1, u1)));
+  __m256d const s2 = _mm256_add_pd (_mm256_mul_pd (c13, _mm256_mul_pd (t2, t2)),
+				    _mm256_mul_pd (cq, _mm256_mul_pd (u2, u2)));
+  __m256d const s3 = _mm256_add_pd (_mm256_mul_pd (c13, _mm256_mul_pd (t3, t3)),
+				    _mm256_mul_pd (cq, _mm256_mul_pd (u3, u3)));
+  __m256d mm = _mm256_mul_pd (v1, v1);
+  __m256d eps, e1, e2, e3, a1, a2, a3, p1, p2, p3;
+  
+  mm = vmax (_mm256_mul_pd (v2, v2), mm);
+  mm = vmax (_mm256_mul_pd (v3, v3), mm);
+  mm = vmax (_mm256_mul_pd (v4, v4), mm);
+  mm = vmax (_mm256_mul_pd (v5, v5), mm);
+  eps = _mm256_add_pd (_mm256_mul_pd (_mm256_set1_pd (1e-6), mm), _mm256_set1_pd (1e-99));
+  e1 = _mm256_add_pd (s1, eps);
+  e2 = _mm256_add_pd (s2, eps);
+  e3 = _mm256_add_pd (s3, eps);
+  a1 = _mm256_div_pd (_mm256_set1_pd (0.1), _mm256_mul_pd (e1, e1));
+  a2 = _mm256_div_pd (_mm256_set1_pd (0.6), _mm256_mul_pd (e2, e2));
+  a3 = _mm256_div_pd (_mm256_set1_pd (0.3), _mm256_mul_pd (e3, e3));
+  p1 = _mm256_div_pd (_mm256_add_pd (_mm256_sub_pd (_mm256_mul_pd (c2, v1), _mm256_mul_pd (c7, v2)),
+				     _mm256_mul_pd (c11, v3)), c6);
+  p2 = _mm256_div_pd (_mm256_add_pd (_mm256_sub_pd (_mm256_mul_pd (c5, v3), v2),
+				     _mm256_mul_pd (c2, v4)), c6);
+  p3 = _mm256_div_pd (_mm256_sub_pd (_mm256_add_pd (_mm256_mul_pd (c2, v3), _mm256_mul_pd (c5, v4)),
+				     v5), c6);
+  return _mm256_div_pd (_mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (a1, p1), _mm256_mul_pd (a2, p2)),
+				       _mm256_mul_pd (a3, p3)),
+			_mm256_add_pd (_mm256_add_pd (a1, a2), a3));
+}
+
+
+__attribute__((target("avx2")))
+void _pfolsm_weno_avx2 (double const * src,
+			double const * base,
+			double const * speed,
+			double * dst,
+			size_t nn,
+			size_t stride,
+			double dt,
+			double aa,
+			double bb)
+{
+  ptrdiff_t const ss = stride;
+  __m256d const zero = _mm256_setzero_pd ();
+  __m256d const sign = _mm256_set1_pd (-0.0);
+  __m256d const vdt = _mm256_set1_pd (dt);
+  __m256d const vaa = _mm256_set1_pd (aa);
+  __m256d const vbb = _mm256_set1_pd (bb);
+  size_t ii;
+  
+  for (ii = 0; ii + 4 <= nn; ii += 4) {
+    double const * cc = src + ii;
+    __m256d dx[6], dy[6];
+    __m256d dxm, dxp, dym, dyp, sp, flip, gx, gy, nabla;
+    int kk;
+    
+    for (kk = 0; kk < 6; ++kk) {
+      dx[kk] = _mm256_sub_pd (_mm256_loadu_pd (cc + kk - 2), _mm256_loadu_pd (cc + kk - 3));
+      dy[kk] = _mm256_sub_pd (_mm256_loadu_pd (cc + (kk - 2) * ss), _mm256_loadu_pd (cc + (kk - 3) * ss));
+    }
+    dxm = weno5_avx2 (dx[0], dx[1], dx[2], dx[3], dx[4]);
+    dxp = weno5_avx2 (dx[5], dx[4], dx[3], dx[2], dx[1]);
+    dym = weno5_avx2 (dy[0], dy[1], dy[2], dy[3], dy[4]);
+    dyp = weno5_avx2 (dy[5], dy[4], dy[3], dy[2], dy[1]);
+    
+    sp = _mm256_loadu_pd (speed + ii);
+    flip = _mm256_andnot_pd (_mm256_cmp_pd (sp, zero, _CMP_GT_OQ), sign);
+    gx = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dxm, flip),
+				       _mm256_xor_pd (dxp, _mm256_xor_pd (flip, sign))),
+			zero);
+    gy = _mm256_max_pd (_mm256_max_pd (_mm256_xor_pd (dym, flip),
+				       _mm256_xor_pd (dyp, _mm256_xor_pd (flip, sign))),
+			zero);
+    nabla = _mm256_sqrt_pd (_mm256_add_pd (_mm256_mul_pd (gx, gx), _mm256_mul_pd (gy, gy)));
+    _mm256_storeu_pd (dst + ii,
+		      _mm256_add_pd (_mm256_mul_pd (vaa, _mm256_loadu_pd (base + ii)),
+				     _mm256_mul_pd (vbb, _mm256_sub_pd (_mm256_loadu_pd (cc),
+									_mm256_mul_pd (vdt, _mm256_mul_pd (sp, nabla))))));
+  }
+  
+  _pfolsm_weno_scalar (src + ii, base + ii, speed + ii, dst + ii, nn - ii, stride, dt, aa, bb);
+}
+
+
+#endif // PFOLSM_HAVE_X86
+
+
+pfolsm_weno_t _pfolsm_weno_kernel (int isa)
+{
+#ifdef PFOLSM_HAVE_X86
+  if (isa >= PFOLSM_ISA_AVX2 && _pfolsm_isa_best () >= PFOLSM_ISA_AVX2) {
+    return _pfolsm_weno_avx2;
+  }
+#endif
+  return _pfolsm_weno_scalar;
+}
+
+
+struct weno_s {
+  pfolsm_t * pp;
+  double dt;
+  int prepared;
+};
+
+
+static void stage_rows (pfolsm_t * pp, double const * src, double * dst,
+			size_t j0, size_t j1, double dt, double aa, double bb)
+{
+  size_t jj;
+  for (jj = j0; jj <= j1; ++jj) {
+    size_t const off = jj * pp->nx + 1;
+    pp->weno (src + off, pp->phi + off, pp->speed + off, dst + off, pp->dimx, pp->nx, dt, aa, bb);
+  }
+}
+
+
+/**
+   Each stage reads up to three rows into the neighboring bands and
+   the ghost rows filled by the first and last band, so the threads
+   meet after filling ghost cells and after each stage.
+*/
+static void weno_task (void * arg, size_t iw, size_t nw)
+{
+  struct weno_s const * ws = arg;
+  pfolsm_t * pp = ws->pp;
+  double const dt = ws->dt;
+  size_t j0, j1, jj;
+  
+  _pfolsm_split (pp->dimy, iw, nw, &j0, &j1);
+  
+  if ( ! ws->prepared && j0 <= j1) {
+    _pfolsm_cbounds_plane (pp, pp->phi, j0, j1);
+    if (pp->speedfn) {
+      _pfolsm_speed_rows (pp, j0, j1, pp->speedbuf + 3 * pp->dimx * iw);
+    }
+  }
+  if (nw > 1) {
+    _pfolsm_pool_sync (pp->pool);
+  }
+  if (j0 <= j1) {
+    stage_rows (pp, pp->phi, pp->phinext, j0, j1, dt, 0.0, 1.0);
+    if (pp->driftbuf) {
+      for (jj = j0; jj <= j1; ++jj) {
+	_pfolsm_drift_span (pp, jj * pp->nx + 1, pp->dimx, pp->driftbuf + 2 * iw);
+      }
+    }
+  }
+  if (nw > 1) {
+    _pfolsm_pool_sync (pp->pool);
+  }
+  if (j0 <= j1) {
+    _pfolsm_cbounds_plane (pp, pp->phinext, j0, j1);
+  }
+  if (nw > 1) {
+    _pfolsm_pool_sync (pp->pool);
+  }
+  if (j0 <= j1) {
+    stage_rows (pp, pp->phinext, pp->phistage, j0, j1, dt, 0.75, 0.25);
+  }
+  if (nw > 1) {
+    _pfolsm_pool_sync (pp->pool);
+  }
+  if (j0 <= j1) {
+    _pfolsm_cbounds_plane (pp, pp->phistage, j0, j1);
+  }
+  if (nw > 1) {
+    _pfolsm_pool_sync (pp->pool);
+  }
+  if (j0 <= j1) {
+    stage_rows (pp, pp->phistage, pp->phinext, j0, j1, dt, 1.0 / 3.0, 2.0 / 3.0);
+  }
+}
+
+
+void _pfolsm_weno_update (pfolsm_t * pp, double dt, int prepared)
+{
+  struct weno_s ws;
+  ws.pp = pp;
+  ws.dt = dt;
+  ws.prepared = prepared;
+  if (pp->pool) {
+    _pfolsm_pool_run (pp->pool, weno_task, &ws);
+  }
+  else {
+    weno_task (&ws, 0, 1);
+  }
+}
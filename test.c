@@ -36,8 +36,24 @@
  */
 
 #include "pfolsm.h"
+#include "pfolsm_tile.h"
+#include "pfolsm_fmm.h"
+#include "pfolsm_sweep.h"
+#include "pfolsm_profile.h"
+#include "pfolsm_oum.h"
+#include "pfolsm_contour.h"
+#include "pfolsm_ckpt.h"
+#include "pfolsm_stats.h"
+#include "pfolsm_batch.h"
+#include "pfolsm_sched.h"
+#ifdef PFOLSM_MPI
+# include "pfolsm_mpi.h"
+#endif
 
 #include <err.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
 
 
 static void init (pfolsm_t * pp)
@@ -56,19 +72,1768 @@ static void init (pfolsm_t * pp)
 }
 
 
+static void check_fused (void)
+{
+  pfolsm_t ref, fus;
+  size_t ii, jj, kk;
+  
+  if (0 != pfolsm_create_flags (&ref, 37, 23, PFOLSM_DEBUG)
+      || 0 != pfolsm_create (&fus, 37, 23)) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  for (jj = 1; jj <= ref.dimy; ++jj) {
+    for (ii = 1; ii <= ref.dimx; ++ii) {
+      size_t const idx = ii + jj * ref.nx;
+      ref.phi[idx] = fus.phi[idx] = sqrt(pow(ii - 12.0, 2.0) + pow(jj - 9.0, 2.0)) - 5.0;
+      ref.speed[idx] = fus.speed[idx] = (ii + jj) % 3 ? 1.0 : -1.0;
+    }
+  }
+  for (kk = 0; kk < 50; ++kk) {
+    pfolsm_update (&ref, 0.1);
+    pfolsm_update (&fus, 0.1);
+    for (jj = 1; jj <= ref.dimy; ++jj) {
+      size_t const off = 1 + jj * ref.nx;
+      if (0 != memcmp (ref.phi + off, fus.phi + off, ref.dimx * sizeof(double))) {
+	errx (EXIT_FAILURE, "fused update differs from multi-pass in row %zu step %zu", jj, kk);
+      }
+    }
+  }
+  pfolsm_destroy (&ref);
+  pfolsm_destroy (&fus);
+}
+
+
+static void check_threads (void)
+{
+  pfolsm_t ref, par;
+  size_t nthreads, ii, jj, kk;
+  
+  for (nthreads = 2; nthreads <= 5; ++nthreads) {
+    if (0 != pfolsm_create (&ref, 31, 17)
+	|| 0 != pfolsm_create (&par, 31, 17)
+	|| 0 != pfolsm_threads (&par, nthreads)) {
+      errx (EXIT_FAILURE, "failed to create LSM data structure");
+    }
+    for (jj = 1; jj <= ref.dimy; ++jj) {
+      for (ii = 1; ii <= ref.dimx; ++ii) {
+	size_t const idx = ii + jj * ref.nx;
+	ref.phi[idx] = par.phi[idx] = sqrt(pow(ii - 3.0, 2.0) + pow(jj - 14.0, 2.0)) - 2.5;
+	ref.speed[idx] = par.speed[idx] = 1.0;
+      }
+    }
+    for (kk = 0; kk < 40; ++kk) {
+      pfolsm_update (&ref, 0.2);
+      pfolsm_update (&par, 0.2);
+    }
+    for (jj = 1; jj <= ref.dimy; ++jj) {
+      size_t const off = 1 + jj * ref.nx;
+      if (0 != memcmp (ref.phi + off, par.phi + off, ref.dimx * sizeof(double))) {
+	errx (EXIT_FAILURE, "%zu-thread update differs from serial in row %zu", nthreads, jj);
+      }
+    }
+    pfolsm_destroy (&ref);
+    pfolsm_destroy (&par);
+  }
+}
+
+
+static void check_nband (void)
+{
+  pfolsm_t ref, nb;
+  size_t ii, jj, kk;
+  double dmax;
+  
+  if (0 != pfolsm_create (&ref, 100, 80)
+      || 0 != pfolsm_create (&nb, 100, 80)) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  for (jj = 1; jj <= ref.dimy; ++jj) {
+    for (ii = 1; ii <= ref.dimx; ++ii) {
+      size_t const idx = ii + jj * ref.nx;
+      ref.phi[idx] = nb.phi[idx] = sqrt(pow(ii - 30.0, 2.0) + pow(jj - 40.0, 2.0)) - 8.0;
+      ref.speed[idx] = nb.speed[idx] = 1.0;
+    }
+  }
+  if (0 != pfolsm_nband (&nb, 6.0)) {
+    errx (EXIT_FAILURE, "failed to set up narrow band");
+  }
+  for (kk = 0; kk < 80; ++kk) {
+    pfolsm_update (&ref, 0.5);
+    pfolsm_update (&nb, 0.5);
+  }
+  if (nb.nband->nbuild < 2) {
+    errx (EXIT_FAILURE, "narrow band was never rebuilt");
+  }
+  
+  // Only the vicinity of the front is expected to agree.
+  
+  dmax = 0.0;
+  for (jj = 1; jj <= ref.dimy; ++jj) {
+    for (ii = 1; ii <= ref.dimx; ++ii) {
+      size_t const idx = ii + jj * ref.nx;
+      if (fabs (ref.phi[idx]) < 1.0 && fabs (ref.phi[idx] - nb.phi[idx]) > dmax) {
+	dmax = fabs (ref.phi[idx] - nb.phi[idx]);
+      }
+    }
+  }
+  if (dmax > 0.5) {
+    errx (EXIT_FAILURE, "narrow band front is off by %g", dmax);
+  }
+  pfolsm_destroy (&ref);
+  pfolsm_destroy (&nb);
+}
+
+
+static void check_tiled (void)
+{
+  pfolsm_t ref;
+  pfolsm_tiled_t tt;
+  size_t ii, jj, kk;
+  
+  if (0 != pfolsm_create (&ref, 150, 130)
+      || 0 != pfolsm_tiled_create (&tt, 150, 130, 8.0)) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  for (jj = 1; jj <= ref.dimy; ++jj) {
+    for (ii = 1; ii <= ref.dimx; ++ii) {
+      size_t const idx = ii + jj * ref.nx;
+      ref.phi[idx] = fmax (-8.0, fmin (8.0, sqrt(pow(ii - 40.0, 2.0) + pow(jj - 60.0, 2.0)) - 6.0));
+      ref.speed[idx] = 1.0;
+      if (0 != pfolsm_tiled_set (&tt, ii, jj, ref.phi[idx])) {
+	errx (EXIT_FAILURE, "failed to set tiled phi");
+      }
+    }
+  }
+  pfolsm_tiled_gc (&tt);
+  
+  // The front crosses into tiles that were far when it started.
+  
+  for (kk = 0; kk < 120; ++kk) {
+    pfolsm_update (&ref, 0.5);
+    if (0 != pfolsm_tiled_update (&tt, 0.5)) {
+      errx (EXIT_FAILURE, "failed to update tiled LSM");
+    }
+  }
+  for (jj = 1; jj <= ref.dimy; ++jj) {
+    for (ii = 1; ii <= ref.dimx; ++ii) {
+      double const phi = ref.phi[ii + jj * ref.nx];
+      if (fabs (phi) < 2.0 && phi != pfolsm_tiled_get (&tt, ii, jj)) {
+	errx (EXIT_FAILURE, "tiled phi differs from dense at %zu %zu", ii, jj);
+      }
+    }
+  }
+  pfolsm_destroy (&ref);
+  pfolsm_tiled_destroy (&tt);
+}
+
+
+static void check_advance_n (void)
+{
+  pfolsm_t ref, blk;
+  size_t ii, jj, kk, nthreads;
+  
+  // Several tiles in each direction, the last ones partial, and a step
+  // count that is not a multiple of the blocking depth.
+  
+  for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+    if (0 != pfolsm_create (&ref, 300, 150)
+	|| 0 != pfolsm_create (&blk, 300, 150)
+	|| 0 != pfolsm_threads (&blk, nthreads)) {
+      errx (EXIT_FAILURE, "failed to create LSM data structure");
+    }
+    for (jj = 1; jj <= ref.dimy; ++jj) {
+      for (ii = 1; ii <= ref.dimx; ++ii) {
+	size_t const idx = ii + jj * ref.nx;
+	ref.phi[idx] = blk.phi[idx] = sqrt(pow(ii - 140.0, 2.0) + pow(jj - 60.0, 2.0)) - 30.0;
+	ref.speed[idx] = blk.speed[idx] = (ii + 2 * jj) % 7 ? 1.0 : -1.0;
+      }
+    }
+    for (kk = 0; kk < 21; ++kk) {
+      pfolsm_update (&ref, 0.4);
+    }
+    if (0 != pfolsm_advance_n (&blk, 0.4, 21)) {
+      errx (EXIT_FAILURE, "failed to advance LSM");
+    }
+    for (jj = 1; jj <= ref.dimy; ++jj) {
+      size_t const off = 1 + jj * ref.nx;
+      if (0 != memcmp (ref.phi + off, blk.phi + off, ref.dimx * sizeof(double))) {
+	errx (EXIT_FAILURE, "temporal blocking differs from update in row %zu", jj);
+      }
+    }
+    pfolsm_destroy (&ref);
+    pfolsm_destroy (&blk);
+  }
+}
+
+
+/**
+   Sub-cell position of the first sign change of phi along row jj,
+   starting at column i0.
+*/
+static double front_x (pfolsm_t const * pp, size_t i0, size_t jj)
+{
+  size_t ii;
+  for (ii = i0; ii < pp->dimx; ++ii) {
+    double const p0 = pfolsm_get (pp, ii, jj);
+    double const p1 = pfolsm_get (pp, ii + 1, jj);
+    if ((p0 > 0.0) != (p1 > 0.0)) {
+      return ii + p0 / (p0 - p1);
+    }
+  }
+  return NAN;
+}
+
+
+static void check_precision (void)
+{
+  static char const * name[] = { "double", "float", "mixed" };
+  static unsigned const flags[] = { 0, PFOLSM_FLOAT, PFOLSM_MIXED };
+  pfolsm_t obj[3];
+  size_t ii, jj, kk, ll;
+  double xref, err;
+  
+  for (ll = 0; ll < 3; ++ll) {
+    if (0 != pfolsm_create_flags (obj + ll, 120, 90, flags[ll])) {
+      errx (EXIT_FAILURE, "failed to create %s LSM data structure", name[ll]);
+    }
+    for (jj = 1; jj <= obj[ll].dimy; ++jj) {
+      for (ii = 1; ii <= obj[ll].dimx; ++ii) {
+	pfolsm_set (obj + ll, ii, jj, sqrt(pow(ii - 30.0, 2.0) + pow(jj - 45.0, 2.0)) - 10.0);
+	pfolsm_set_speed (obj + ll, ii, jj, 1.0);
+      }
+    }
+    for (kk = 0; kk < 400; ++kk) {
+      pfolsm_update (obj + ll, 0.1);
+    }
+  }
+  
+  xref = front_x (obj, 30, 45);
+  for (ll = 1; ll < 3; ++ll) {
+    err = front_x (obj + ll, 30, 45) - xref;
+    printf ("front position error of %s engine: %g cells\n", name[ll], err);
+    if ( ! (fabs (err) < 1e-3)) {
+      errx (EXIT_FAILURE, "%s engine front is off by %g", name[ll], err);
+    }
+  }
+  for (ll = 0; ll < 3; ++ll) {
+    pfolsm_destroy (obj + ll);
+  }
+}
+
+
+/**
+   Faster towards +x than towards -x.
+*/
+static void lopsided_speed (void * arg, size_t i0, size_t jj, size_t nn,
+			    double const * gx, double const * gy, double * speed)
+{
+  size_t ii;
+  if (arg) {
+    ++*(size_t *) arg;
+  }
+  for (ii = 0; ii < nn; ++ii) {
+    speed[ii] = gx[ii] > 0.0 ? 1.0 : 0.5;
+  }
+}
+
+
+static void check_speed_fn (void)
+{
+  pfolsm_t ser, par;
+  size_t ii, jj, kk, ncalls;
+  double right, left;
+  
+  ncalls = 0;
+  if (0 != pfolsm_create (&ser, 120, 60)
+      || 0 != pfolsm_create (&par, 120, 60)
+      || 0 != pfolsm_threads (&par, 3)
+      || 0 != pfolsm_speed_fn (&ser, lopsided_speed, &ncalls)
+      || 0 != pfolsm_speed_fn (&par, lopsided_speed, 0)) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  for (jj = 1; jj <= ser.dimy; ++jj) {
+    for (ii = 1; ii <= ser.dimx; ++ii) {
+      pfolsm_set (&ser, ii, jj, sqrt(pow(ii - 60.0, 2.0) + pow(jj - 30.0, 2.0)) - 10.0);
+      pfolsm_set (&par, ii, jj, pfolsm_get (&ser, ii, jj));
+    }
+  }
+  for (kk = 0; kk < 80; ++kk) {
+    pfolsm_update (&ser, 0.25);
+    pfolsm_update (&par, 0.25);
+  }
+  if (ncalls != 80 * ser.dimy) {
+    errx (EXIT_FAILURE, "speed model was called only %zu times", ncalls);
+  }
+  for (jj = 1; jj <= ser.dimy; ++jj) {
+    size_t const off = 1 + jj * ser.nx;
+    if (0 != memcmp (ser.phi + off, par.phi + off, ser.dimx * sizeof(double))) {
+      errx (EXIT_FAILURE, "threaded speed model differs from serial in row %zu", jj);
+    }
+  }
+  
+  // After t=20 the front should be 20 cells out on the right and 10
+  // cells out on the left.
+  
+  right = front_x (&ser, 60, 30) - 60.0;
+  for (ii = 60; ii > 1 && pfolsm_get (&ser, ii, 30) < 0.0; --ii);
+  left = 60.0 - ii - pfolsm_get (&ser, ii, 30) / (pfolsm_get (&ser, ii, 30) - pfolsm_get (&ser, ii + 1, 30));
+  if (fabs (right - 30.0) > 1.0 || fabs (left - 20.0) > 1.0) {
+    errx (EXIT_FAILURE, "speed model front at -%g +%g instead of -20 +30", left, right);
+  }
+  pfolsm_destroy (&ser);
+  pfolsm_destroy (&par);
+}
+
+
+static void check_update_cfl (void)
+{
+  static unsigned const flags[] = { 0, PFOLSM_WENO };
+  pfolsm_t cfl, ref;
+  double * stage;
+  size_t ii, jj, kk, ll, nthreads;
+  double dt, dmax;
+  
+  for (ll = 0; ll < 2; ++ll) {
+    for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+      if (0 != pfolsm_create_flags (&cfl, 90, 70, flags[ll])
+	  || 0 != pfolsm_create_flags (&ref, 90, 70, flags[ll])
+	  || 0 != pfolsm_threads (&cfl, nthreads)
+	  || 0 == (stage = malloc (cfl.dimx * sizeof(double)))) {
+	errx (EXIT_FAILURE, "failed to create LSM data structure");
+      }
+      for (jj = 1; jj <= cfl.dimy; ++jj) {
+	for (ii = 1; ii <= cfl.dimx; ++ii) {
+	  size_t const idx = ii + jj * cfl.nx;
+	  cfl.phi[idx] = ref.phi[idx] = sqrt(pow(ii - 45.0, 2.0) + pow(jj - 35.0, 2.0)) - 12.0;
+	  cfl.speed[idx] = ref.speed[idx] = ii < 45 ? 2.0 : -0.5;
+	}
+      }
+      for (kk = 0; kk < 10; ++kk) {
+	if (0 != pfolsm_update_cfl (&cfl, 0.5, &dt)) {
+	  errx (EXIT_FAILURE, "failed to update LSM");
+	}
+	if (dt < 0.2 || dt > 0.3) {
+	  errx (EXIT_FAILURE, "CFL step %g for a speed of 2 and a CFL of 0.5", dt);
+	}
+	dmax = 0.0;
+	if (flags[ll] & PFOLSM_WENO) {
+	  // phinext still holds the previous phi with its ghost cells,
+	  // from which the first stage changes by exactly the CFL number
+	  for (jj = 1; jj <= cfl.dimy; ++jj) {
+	    size_t const off = 1 + jj * cfl.nx;
+	    _pfolsm_weno_scalar (cfl.phinext + off, cfl.phinext + off, cfl.speed + off, stage,
+				 cfl.dimx, cfl.nx, dt, 0.0, 1.0);
+	    for (ii = 0; ii < cfl.dimx; ++ii) {
+	      if (fabs (stage[ii] - cfl.phinext[off + ii]) > dmax) {
+		dmax = fabs (stage[ii] - cfl.phinext[off + ii]);
+	      }
+	    }
+	  }
+	  if (fabs (dmax - 0.5) > 1e-9) {
+	    errx (EXIT_FAILURE, "first WENO stage changed phi by %g", dmax);
+	  }
+	}
+	else {
+	  for (jj = 1; jj <= cfl.dimy; ++jj) {
+	    for (ii = 1; ii <= cfl.dimx; ++ii) {
+	      size_t const idx = ii + jj * cfl.nx;
+	      if (fabs (cfl.phi[idx] - ref.phi[idx]) > dmax) {
+		dmax = fabs (cfl.phi[idx] - ref.phi[idx]);
+	      }
+	    }
+	  }
+	  if (dmax > 0.5) {
+	    errx (EXIT_FAILURE, "CFL step changed phi by %g", dmax);
+	  }
+	}
+	pfolsm_update (&ref, dt);
+	for (jj = 1; jj <= cfl.dimy; ++jj) {
+	  size_t const off = 1 + jj * cfl.nx;
+	  if (0 != memcmp (ref.phi + off, cfl.phi + off, cfl.dimx * sizeof(double))) {
+	    errx (EXIT_FAILURE, "CFL update differs from update with the same dt in row %zu", jj);
+	  }
+	}
+      }
+      free (stage);
+      pfolsm_destroy (&cfl);
+      pfolsm_destroy (&ref);
+    }
+  }
+}
+
+
+static void check_fmm (void)
+{
+  pfolsm_t pp;
+  pfolsm_fmm_t fm;
+  double * arrival;
+  size_t ii, jj, kk, seed;
+  double xfront, tfront;
+  
+  if (0 != pfolsm_create (&pp, 100, 80)
+      || 0 != pfolsm_fmm_create (&fm, &pp)
+      || 0 == (arrival = malloc (pp.ntt * sizeof(double)))) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  
+  // point source at twice the unit speed
+  
+  for (jj = 1; jj <= pp.dimy; ++jj) {
+    for (ii = 1; ii <= pp.dimx; ++ii) {
+      pfolsm_set_speed (&pp, ii, jj, 2.0);
+    }
+  }
+  seed = 30 + 40 * pp.nx;
+  if (0 != pfolsm_fmm_arrival (&fm, &pp, &seed, 1, arrival)) {
+    errx (EXIT_FAILURE, "fast marching failed");
+  }
+  for (jj = 1; jj <= pp.dimy; ++jj) {
+    for (ii = 1; ii <= pp.dimx; ++ii) {
+      double const rr = sqrt(pow(ii - 30.0, 2.0) + pow(jj - 40.0, 2.0));
+      if (fabs (2.0 * arrival[ii + jj * pp.nx] - rr) > 0.05 * rr + 1.0) {
+	errx (EXIT_FAILURE, "arrival time %g at distance %g", arrival[ii + jj * pp.nx], rr);
+      }
+    }
+  }
+  
+  // The explicit update should put the front where the arrival time
+  // from the initial front says it is.
+  
+  for (jj = 1; jj <= pp.dimy; ++jj) {
+    for (ii = 1; ii <= pp.dimx; ++ii) {
+      pfolsm_set (&pp, ii, jj, 3.0 * (sqrt(pow(ii - 30.0, 2.0) + pow(jj - 40.0, 2.0)) - 5.0));
+      pfolsm_set_speed (&pp, ii, jj, 1.0);
+    }
+  }
+  if (0 != pfolsm_fmm_arrival (&fm, &pp, 0, 0, arrival)) {
+    errx (EXIT_FAILURE, "fast marching failed");
+  }
+  if (0 != pfolsm_fmm_reinit (&fm, &pp, 0.0)) {
+    errx (EXIT_FAILURE, "reinitialization failed");
+  }
+  // First order marching is least accurate where the fronts from
+  // both sides of the center collide.
+  
+  if (fabs (front_x (&pp, 30, 40) - 35.0) > 0.01
+      || fabs (pfolsm_get (&pp, 45, 40) - 10.0) > 0.01
+      || fabs (pfolsm_get (&pp, 30, 40) + 5.0) > 0.6) {
+    errx (EXIT_FAILURE, "reinitialization is not a signed distance");
+  }
+  for (kk = 0; kk < 100; ++kk) {
+    pfolsm_update (&pp, 0.1);
+  }
+  xfront = front_x (&pp, 30, 40);
+  for (ii = 31; arrival[ii + 1 + 40 * pp.nx] < 10.0; ++ii);
+  tfront = ii + (10.0 - arrival[ii + 40 * pp.nx])
+    / (arrival[ii + 1 + 40 * pp.nx] - arrival[ii + 40 * pp.nx]);
+  if (fabs (xfront - tfront) > 0.5) {
+    errx (EXIT_FAILURE, "front at %g after t=10 but arrival says %g", xfront, tfront);
+  }
+  
+  // Limited width reinitialization clamps far cells.
+  
+  if (0 != pfolsm_fmm_reinit (&fm, &pp, 4.0)) {
+    errx (EXIT_FAILURE, "reinitialization failed");
+  }
+  if (4.0 != pfolsm_get (&pp, 100, 1) || -4.0 != pfolsm_get (&pp, 30, 40)) {
+    errx (EXIT_FAILURE, "limited reinitialization does not clamp");
+  }
+  
+  free (arrival);
+  pfolsm_fmm_destroy (&fm);
+  pfolsm_destroy (&pp);
+}
+
+
+static void check_sweep (void)
+{
+  pfolsm_t pp;
+  pfolsm_fmm_t fm;
+  double * tfmm, * tser, * tpar;
+  size_t ii, jj;
+  int nround;
+  
+  if (0 != pfolsm_create (&pp, 150, 130)
+      || 0 != pfolsm_fmm_create (&fm, &pp)
+      || 0 == (tfmm = malloc (3 * pp.ntt * sizeof(double)))) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  tser = tfmm + pp.ntt;
+  tpar = tser + pp.ntt;
+  
+  // smooth speed, with a wall that has to be walked around
+  
+  for (jj = 1; jj <= pp.dimy; ++jj) {
+    for (ii = 1; ii <= pp.dimx; ++ii) {
+      pfolsm_set (&pp, ii, jj, sqrt(pow(ii - 40.0, 2.0) + pow(jj - 50.0, 2.0)) - 6.5);
+      pfolsm_set_speed (&pp, ii, jj, (ii == 80 && jj > 20) ? 0.0 : 1.0 + 0.5 * sin (0.05 * jj));
+    }
+  }
+  if (0 != pfolsm_fmm_arrival (&fm, &pp, 0, 0, tfmm)) {
+    errx (EXIT_FAILURE, "fast marching failed");
+  }
+  nround = pfolsm_sweep_arrival (&pp, 0, 0, tser, 50, 0.0);
+  if (nround < 1 || nround >= 50) {
+    errx (EXIT_FAILURE, "fast sweeping did not converge (%d rounds)", nround);
+  }
+  if (0 != pfolsm_threads (&pp, 3)
+      || nround != pfolsm_sweep_arrival (&pp, 0, 0, tpar, 50, 0.0)) {
+    errx (EXIT_FAILURE, "parallel fast sweeping failed");
+  }
+  if (0 != memcmp (tser, tpar, pp.ntt * sizeof(double))) {
+    errx (EXIT_FAILURE, "parallel fast sweeping differs from serial");
+  }
+  
+  // Both solve the same discrete equations.
+  
+  for (ii = 0; ii < pp.ntt; ++ii) {
+    if (tfmm[ii] != tser[ii] && ! (fabs (tfmm[ii] - tser[ii]) < 1e-9)) {
+      errx (EXIT_FAILURE, "fast sweeping %g differs from fast marching %g at %zu",
+	    tser[ii], tfmm[ii], ii);
+    }
+  }
+  
+  free (tfmm);
+  pfolsm_fmm_destroy (&fm);
+  pfolsm_destroy (&pp);
+}
+
+
+static void check_reinit_lazy (void)
+{
+  pfolsm_t pp;
+  size_t ii, jj, kk, nthreads;
+  double front;
+  
+  for (nthreads = 1; nthreads <= 2; ++nthreads) {
+    if (0 != pfolsm_create (&pp, 80, 80)
+	|| 0 != pfolsm_threads (&pp, nthreads)
+	|| 0 != pfolsm_reinit_lazy (&pp, 0.2, 0.0)) {
+      errx (EXIT_FAILURE, "failed to create LSM data structure");
+    }
+    for (jj = 1; jj <= pp.dimy; ++jj) {
+      for (ii = 1; ii <= pp.dimx; ++ii) {
+	pfolsm_set (&pp, ii, jj, 3.0 * (sqrt(pow(ii - 30.0, 2.0) + pow(jj - 40.0, 2.0)) - 10.0));
+      }
+    }
+    
+    // The steep initial phi gets fixed after the first update, and
+    // then stays close enough to a distance for a while.
+    
+    pfolsm_update (&pp, 0.2);
+    if (1 != pp.nreinit || pp.drift < 1.0) {
+      errx (EXIT_FAILURE, "drift %g did not trigger reinitialization", pp.drift);
+    }
+    for (kk = 1; kk < 20; ++kk) {
+      pfolsm_update (&pp, 0.2);
+    }
+    if (pp.nreinit > 2 || pp.drift > 0.2) {
+      errx (EXIT_FAILURE, "%zu reinitializations, drift %g", pp.nreinit, pp.drift);
+    }
+    front = front_x (&pp, 30, 40);
+    if (fabs (front - 44.0) > 0.5) {
+      errx (EXIT_FAILURE, "front at %g instead of 44 after reinitialization", front);
+    }
+    pfolsm_destroy (&pp);
+  }
+}
+
+
+static void check_weno (void)
+{
+  static size_t const stride = 70;
+  double src[7 * 70], base[7 * 70], speed[7 * 70], ref[70], out[70];
+  pfolsm_t obj[4];
+  size_t ii, jj, kk, ll;
+  double err[2];
+  
+  // AVX2 and scalar kernels
+  
+  srand (17);
+  for (ii = 0; ii < 7 * stride; ++ii) {
+    src[ii] = (rand () % 4) ? (rand () % 2001 - 1000) * 1e-3 : rand () % 3;
+    base[ii] = (rand () % 2001 - 1000) * 1e-3;
+    speed[ii] = ((rand () % 5) - 2) * 0.75;
+  }
+  _pfolsm_weno_scalar (src + 3 * stride + 3, base + 3 * stride + 3, speed + 3 * stride + 3,
+		       ref, 61, stride, 0.3, 0.75, 0.25);
+  for (ii = 0; ii <= 61; ++ii) {
+    memset (out, 0, sizeof(out));
+    _pfolsm_weno_kernel (PFOLSM_NISA) (src + 3 * stride + 3, base + 3 * stride + 3,
+				       speed + 3 * stride + 3, out, ii, stride, 0.3, 0.75, 0.25);
+    if (0 != memcmp (ref, out, ii * sizeof(double))) {
+      errx (EXIT_FAILURE, "WENO kernel differs from scalar for %zu cells", ii);
+    }
+  }
+  
+  // the WENO5 stencil needs three ghost layers
+  
+  for (ll = 1; ll <= 3; ++ll) {
+    if ((0 == pfolsm_create_ng (obj, 8, 8, PFOLSM_WENO, ll)) != (3 == ll)) {
+      errx (EXIT_FAILURE, "WENO with %zu ghost layers", ll);
+    }
+  }
+  pfolsm_update (obj, 0.3);
+  pfolsm_destroy (obj);
+  
+  // first order with one and with two ghost layers, WENO serial and
+  // with threads
+  
+  if (0 != pfolsm_create (obj, 60, 50)
+      || 0 != pfolsm_create_ng (obj + 1, 60, 50, 0, 2)
+      || 0 != pfolsm_create_flags (obj + 2, 60, 50, PFOLSM_WENO)
+      || 0 != pfolsm_create_flags (obj + 3, 60, 50, PFOLSM_WENO)
+      || 0 != pfolsm_threads (obj + 3, 3)) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  for (ll = 0; ll < 4; ++ll) {
+    for (jj = 1; jj <= obj[ll].dimy; ++jj) {
+      for (ii = 1; ii <= obj[ll].dimx; ++ii) {
+	pfolsm_set (obj + ll, ii, jj, sqrt(pow(ii - 20.0, 2.0) + pow(jj - 22.0, 2.0)) - 8.0);
+      }
+    }
+    for (kk = 0; kk < 40; ++kk) {
+      pfolsm_update (obj + ll, 0.3);
+    }
+  }
+  for (jj = 1; jj <= obj[0].dimy; ++jj) {
+    for (ii = 1; ii <= obj[0].dimx; ++ii) {
+      if (pfolsm_get (obj, ii, jj) != pfolsm_get (obj + 1, ii, jj)) {
+	errx (EXIT_FAILURE, "two ghost layers change the first order result");
+      }
+      if (pfolsm_get (obj + 2, ii, jj) != pfolsm_get (obj + 3, ii, jj)) {
+	errx (EXIT_FAILURE, "threaded WENO differs from serial");
+      }
+    }
+  }
+  
+  // The front should be at radius 8 + 12 = 20, which is hardest to
+  // get right along the diagonal.
+  
+  for (ll = 0; ll < 2; ++ll) {
+    pfolsm_t const * pp = obj + 2 * ll;
+    for (kk = 0; pfolsm_get (pp, 21 + kk, 23 + kk) <= 0.0; ++kk);
+    err[ll] = sqrt (2.0) * (kk + pfolsm_get (pp, 20 + kk, 22 + kk)
+			    / (pfolsm_get (pp, 20 + kk, 22 + kk) - pfolsm_get (pp, 21 + kk, 23 + kk)))
+      - 20.0;
+  }
+  printf ("front position error of first order engine: %g cells\n", err[0]);
+  printf ("front position error of WENO engine: %g cells\n", err[1]);
+  if ( ! (fabs (err[1]) < 0.05 && fabs (err[1]) < 0.25 * fabs (err[0]))) {
+    errx (EXIT_FAILURE, "WENO front is off by %g", err[1]);
+  }
+  for (ll = 0; ll < 4; ++ll) {
+    pfolsm_destroy (obj + ll);
+  }
+  
+  // CFL steps with threads, also with more threads than rows, against
+  // the serial ones
+  
+  for (ll = 6; ll <= 12; ll += 6) {
+    double dt[2];
+    if (0 != pfolsm_create_flags (obj, 40, 8, PFOLSM_WENO)
+	|| 0 != pfolsm_create_flags (obj + 1, 40, 8, PFOLSM_WENO)
+	|| 0 != pfolsm_threads (obj + 1, ll)) {
+      errx (EXIT_FAILURE, "failed to create LSM data structure");
+    }
+    for (kk = 0; kk < 2; ++kk) {
+      for (jj = 1; jj <= obj[kk].dimy; ++jj) {
+	for (ii = 1; ii <= obj[kk].dimx; ++ii) {
+	  pfolsm_set (obj + kk, ii, jj, sqrt(pow(ii - 12.0, 2.0) + pow(jj - 4.0, 2.0)) - 3.0);
+	  pfolsm_set_speed (obj + kk, ii, jj, 0.5 + 0.05 * ii);
+	}
+      }
+    }
+    for (kk = 0; kk < 5; ++kk) {
+      if (0 != pfolsm_update_cfl (obj, 0.4, dt)
+	  || 0 != pfolsm_update_cfl (obj + 1, 0.4, dt + 1)) {
+	errx (EXIT_FAILURE, "failed to update LSM");
+      }
+      if (dt[0] != dt[1]) {
+	errx (EXIT_FAILURE, "WENO CFL step %g with %zu threads instead of %g", dt[1], ll, dt[0]);
+      }
+    }
+    for (jj = 1; jj <= obj[0].dimy; ++jj) {
+      for (ii = 1; ii <= obj[0].dimx; ++ii) {
+	if (pfolsm_get (obj, ii, jj) != pfolsm_get (obj + 1, ii, jj)) {
+	  errx (EXIT_FAILURE, "threaded WENO CFL update differs from serial");
+	}
+      }
+    }
+    pfolsm_destroy (obj);
+    pfolsm_destroy (obj + 1);
+  }
+}
+
+
+static void check_profile (void)
+{
+  static double const atab[] = { 0.0, M_PI/2, M_PI };
+  static double const vtab[] = { 0.4,    1.0, 0.95 };
+  double gx[103], gy[103], ref[103], out[103];
+  pfolsm_profile_t pf;
+  pfolsm_t obj;
+  size_t ii, nn;
+  
+  if (0 != pfolsm_profile_create_spline (&pf, 256, atab, vtab, 3)) {
+    errx (EXIT_FAILURE, "failed to create speed profile");
+  }
+  
+  // against the spline evaluated at the actual angle
+  
+  for (ii = 0; ii <= 3600; ++ii) {
+    double const angle = (ii - 1800.0) * M_PI / 1800.0;
+    double const aa = fabs (angle);
+    double const tt = aa < M_PI/2 ? aa / (M_PI/2) : (aa - M_PI/2) / (M_PI/2);
+    double const p0 = aa < M_PI/2 ? vtab[0] : vtab[1];
+    double const p1 = aa < M_PI/2 ? vtab[1] : vtab[2];
+    double const want = (2 * tt - 3) * (p0 - p1) * tt * tt + p0;
+    double const got = pfolsm_profile_eval (&pf, 3.0 * cos (angle), 3.0 * sin (angle));
+    if (fabs (got - want) > 1e-6) {
+      errx (EXIT_FAILURE, "speed profile off by %g at angle %g", got - want, angle);
+    }
+  }
+  if (0.0 != pfolsm_profile_eval (&pf, 5e-5, -5e-5)
+      || 0.0 != pfolsm_profile_eval (&pf, NAN, 1.0)) {
+    errx (EXIT_FAILURE, "speed profile should vanish for tiny or invalid gradients");
+  }
+  
+  // vectorized evaluation, including tiny and invalid gradients
+  
+  srand (23);
+  for (ii = 0; ii < 103; ++ii) {
+    gx[ii] = (rand () % 2001 - 1000) * ((rand () % 7) ? 1e-3 : 1e-7);
+    gy[ii] = (rand () % 2001 - 1000) * ((rand () % 7) ? 1e-3 : 1e-7);
+    ref[ii] = pfolsm_profile_eval (&pf, gx[ii], gy[ii]);
+  }
+  gx[5] = NAN;
+  ref[5] = 0.0;
+  for (nn = 0; nn <= 103; ++nn) {
+    memset (out, 0, sizeof(out));
+    pfolsm_profile_eval_n (&pf, nn, gx, gy, out);
+    if (0 != memcmp (ref, out, nn * sizeof(double))) {
+      errx (EXIT_FAILURE, "vectorized speed profile differs for %zu gradients", nn);
+    }
+  }
+  
+  // as a speed model
+  
+  if (0 != pfolsm_create (&obj, 40, 30)) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  for (nn = 1; nn <= obj.dimy; ++nn) {
+    for (ii = 1; ii <= obj.dimx; ++ii) {
+      pfolsm_set (&obj, ii, nn, sqrt(pow(ii - 20.0, 2.0) + pow(nn - 15.0, 2.0)) - 6.0);
+    }
+  }
+  pfolsm_speed_fn (&obj, pfolsm_profile_speedfn, &pf);
+  for (ii = 0; ii < 10; ++ii) {
+    pfolsm_update (&obj, 0.5);
+  }
+  
+  // the front moves slower to the right (0.4) than to the left (0.95)
+  
+  if ( ! (front_x (&obj, 20, 15) < 20.0 + 6.0 + 0.4 * 5.0 + 0.5
+	  && front_x (&obj, 20, 15) > 20.0 + 6.0 + 0.4 * 5.0 - 0.5)) {
+    errx (EXIT_FAILURE, "speed profile front at %g", front_x (&obj, 20, 15));
+  }
+  
+  pfolsm_destroy (&obj);
+  pfolsm_profile_destroy (&pf);
+}
+
+
+static double unit_polar (void * arg, double angle)
+{
+  return 1.0;
+}
+
+
+static void check_wulff (void)
+{
+  static double const atab_vel[] = { M_PI/4, 5*M_PI/9, 5*M_PI/6, M_PI };
+  static double const vtab_vel[] = {    0.0,      1.0,      0.8,  0.3 };
+  static double const atab_pen[] = { M_PI/12, 5*M_PI/9 };
+  static double const vtab_pen[] = {     1.0,      0.0 };
+  pfolsm_spline_t vel, pen;
+  pfolsm_wulff_t wulff, fine;
+  pfolsm_profile_t pf;
+  double heading;
+  size_t ii;
+  
+  // isotropic closed form: the best heading is along the gradient
+  
+  wulff.vel = unit_polar;
+  wulff.velarg = 0;
+  wulff.pen = unit_polar;
+  wulff.penarg = 0;
+  wulff.nheading = 36;
+  for (ii = 0; ii < 100; ++ii) {
+    double const alpha = (ii - 50.0) * M_PI / 50.0;
+    if (fabs (pfolsm_wulff_eval (&wulff, alpha, &heading) - 1.0) > 1e-12
+	|| fabs (cos (heading - alpha) - 1.0) > 1e-12) {
+      errx (EXIT_FAILURE, "isotropic Wulff speed wrong at angle %g", alpha);
+    }
+  }
+  
+  // the table against a fine maximization, with the model of dbgpln
+  
+  vel.atab = atab_vel;
+  vel.vtab = vtab_vel;
+  vel.tablen = 4;
+  pen.atab = atab_pen;
+  pen.vtab = vtab_pen;
+  pen.tablen = 2;
+  wulff.vel = pfolsm_spline_polar;
+  wulff.velarg = &vel;
+  wulff.pen = pfolsm_spline_polar;
+  wulff.penarg = &pen;
+  fine = wulff;
+  fine.nheading = 3600;
+  if (0 != pfolsm_profile_create_wulff (&pf, 512, &wulff)) {
+    errx (EXIT_FAILURE, "failed to create Wulff profile");
+  }
+  for (ii = 0; ii <= 720; ++ii) {
+    double const alpha = (ii - 360.0) * M_PI / 360.0;
+    double const want = pfolsm_wulff_eval (&fine, alpha, &heading);
+    double const got = pfolsm_profile_eval (&pf, cos (alpha), sin (alpha));
+    if (fabs (got - want) > 1e-3) {
+      errx (EXIT_FAILURE, "Wulff profile off by %g at angle %g", got - want, alpha);
+    }
+    if (fabs (pfolsm_wulff_eval (&fine, alpha + 2 * M_PI, 0) - want) > 1e-9) {
+      errx (EXIT_FAILURE, "Wulff speed not periodic at angle %g", alpha);
+    }
+  }
+  
+  pfolsm_profile_destroy (&pf);
+}
+
+
+static double ellipse_polar (void * arg, double angle)
+{
+  // heading speeds whose reachable set is an ellipse with semi-axes 2
+  // and 1
+  return 2.0 / sqrt (pow (cos (angle), 2.0) + 4.0 * pow (sin (angle), 2.0));
+}
+
+
+static void check_oum (void)
+{
+  pfolsm_t obj;
+  pfolsm_fmm_t fm;
+  pfolsm_profile_t pf[2];
+  double * arrival;
+  size_t ii, jj, ll, seed;
+  
+  if (0 != pfolsm_create (&obj, 60, 60)
+      || 0 != pfolsm_fmm_create (&fm, &obj)
+      || 0 != pfolsm_profile_create (pf, 256, unit_polar, 0)
+      || 0 != pfolsm_profile_create (pf + 1, 256, ellipse_polar, 0)
+      || 0 == (arrival = malloc (obj.ntt * sizeof(double)))) {
+    errx (EXIT_FAILURE, "failed to create OUM data structures");
+  }
+  seed = 30 + 30 * obj.nx;
+  
+  // isotropic and elliptic point sources against the exact times
+  
+  for (ll = 0; ll < 2; ++ll) {
+    if (0 != pfolsm_oum_arrival (&fm, &obj, pf + ll, 0.0, &seed, 1, arrival)) {
+      errx (EXIT_FAILURE, "pfolsm_oum_arrival failed");
+    }
+    for (jj = 1; jj <= obj.dimy; ++jj) {
+      for (ii = 1; ii <= obj.dimx; ++ii) {
+	double const dx = ii - 30.0;
+	double const dy = jj - 30.0;
+	double const want = ll ? sqrt (dx * dx / 4.0 + dy * dy) : sqrt (dx * dx + dy * dy);
+	double const got = arrival[ii + jj * obj.nx];
+	if (fabs (got - want) > 0.03 * want) {
+	  errx (EXIT_FAILURE, "OUM profile %zu: arrival %g instead of %g at %zu %zu",
+		ll, got, want, ii, jj);
+	}
+      }
+    }
+  }
+  
+  // a wall with a gap: the wall is never reached, and cells right
+  // behind it have to go around, also with the longer updates of the
+  // elliptic profile and the largest radius across a thicker wall
+  
+  for (ll = 0; ll < 3; ++ll) {
+    size_t const thick = ll < 2 ? 1 : 5;
+    for (jj = 1; jj < 50; ++jj) {
+      for (ii = 40; ii < 40 + thick; ++ii) {
+	pfolsm_set_speed (&obj, ii, jj, 0.0);
+      }
+    }
+    if (0 != pfolsm_oum_arrival (&fm, &obj, pf + (ll > 0), ll < 2 ? 0.0 : PFOLSM_OUM_MAXRADIUS,
+				 &seed, 1, arrival)) {
+      errx (EXIT_FAILURE, "pfolsm_oum_arrival failed");
+    }
+    for (ii = 40; ii < 40 + thick; ++ii) {
+      if ( ! isinf (arrival[ii + 30 * obj.nx])) {
+	errx (EXIT_FAILURE, "OUM case %zu reached a cell with zero speed", ll);
+      }
+    }
+    if ( ! (arrival[40 + thick + 30 * obj.nx] > 40.0)) {
+      errx (EXIT_FAILURE, "OUM case %zu went through the wall: %g",
+	    ll, arrival[40 + thick + 30 * obj.nx]);
+    }
+  }
+  
+  // seeds from the zero level
+  
+  for (jj = 1; jj <= obj.dimy; ++jj) {
+    for (ii = 1; ii <= obj.dimx; ++ii) {
+      pfolsm_set (&obj, ii, jj, ii - 10.5);
+    }
+  }
+  if (0 != pfolsm_oum_arrival (&fm, &obj, pf, 0.0, 0, 0, arrival)) {
+    errx (EXIT_FAILURE, "pfolsm_oum_arrival failed");
+  }
+  if (0.0 != arrival[10 + 5 * obj.nx] || fabs (arrival[30 + 5 * obj.nx] - 20.0) > 1e-9) {
+    errx (EXIT_FAILURE, "OUM from the zero level: %g %g",
+	  arrival[10 + 5 * obj.nx], arrival[30 + 5 * obj.nx]);
+  }
+  
+  free (arrival);
+  pfolsm_profile_destroy (pf);
+  pfolsm_profile_destroy (pf + 1);
+  pfolsm_fmm_destroy (&fm);
+  pfolsm_destroy (&obj);
+}
+
+static void check_contour (void)
+{
+  pfolsm_t obj;
+  pfolsm_contour_t ct;
+  pfolsm_point_t point[400], band[400];
+  size_t line[4], bline[4];
+  size_t ii, jj, np, nl, nb;
+  
+  if (0 != pfolsm_create (&obj, 60, 50) || 0 != pfolsm_contour_create (&ct, &obj)) {
+    errx (EXIT_FAILURE, "failed to create contour data structures");
+  }
+  for (jj = 1; jj <= obj.dimy; ++jj) {
+    for (ii = 1; ii <= obj.dimx; ++ii) {
+      pfolsm_set (&obj, ii, jj, sqrt(pow(ii - 30.2, 2.0) + pow(jj - 25.7, 2.0)) - 10.3);
+    }
+  }
+  
+  // one closed polyline close to the circle, twice in a row
+  
+  for (ii = 0; ii < 2; ++ii) {
+    np = pfolsm_contour (&ct, &obj, 1, obj.dimy, point, 400, line, 4, &nl);
+    if (1 != nl || 0 != line[0] || np < 60 || np > 400
+	|| point[0].x != point[np-1].x || point[0].y != point[np-1].y) {
+      errx (EXIT_FAILURE, "contour of a circle: %zu points in %zu lines", np, nl);
+    }
+  }
+  for (ii = 0; ii < np; ++ii) {
+    double const rr = sqrt(pow(point[ii].x - 30.2, 2.0) + pow(point[ii].y - 25.7, 2.0));
+    if (fabs (rr - 10.3) > 0.05) {
+      errx (EXIT_FAILURE, "contour point %zu at radius %g", ii, rr);
+    }
+  }
+  
+  // the same within the narrow band
+  
+  if (0 != pfolsm_nband (&obj, 4)) {
+    errx (EXIT_FAILURE, "pfolsm_nband failed");
+  }
+  nb = pfolsm_contour (&ct, &obj, 1, obj.dimy, band, 400, bline, 4, &nl);
+  if (nb != np || 1 != nl || 0 != memcmp (band, point, np * sizeof(*point))) {
+    errx (EXIT_FAILURE, "narrow band contour differs");
+  }
+  pfolsm_nband (&obj, 0);
+  
+  // lower rows only give an open arc, and short buffers get the
+  // needed sizes
+  
+  nb = pfolsm_contour (&ct, &obj, 1, 25, band, 400, bline, 4, &nl);
+  if (1 != nl || nb >= np || band[0].y != 25.0 || band[nb-1].y != 25.0) {
+    errx (EXIT_FAILURE, "contour of the lower rows: %zu points in %zu lines", nb, nl);
+  }
+  nb = pfolsm_contour (&ct, &obj, 1, obj.dimy, band, 10, bline, 0, &nl);
+  if (nb != np || 1 != nl || 0 != memcmp (band, point, 10 * sizeof(*point))) {
+    errx (EXIT_FAILURE, "truncated contour");
+  }
+  
+  pfolsm_contour_destroy (&ct);
+  pfolsm_destroy (&obj);
+}
+
+static void check_ckpt (void)
+{
+  static unsigned const flags[] = { 0, PFOLSM_WENO, PFOLSM_FLOAT };
+  char path[64];
+  pfolsm_t obj[2];
+  pfolsm_fmm_t fm;
+  double * arrival;
+  double * loaded;
+  FILE * fp;
+  size_t ii, jj, ll, kk;
+  
+  snprintf (path, sizeof(path), "/tmp/pfolsm-test-%d.ckpt", (int) getpid ());
+  
+  for (ll = 0; ll < 3; ++ll) {
+    if (0 != pfolsm_create_flags (obj, 37, 29, flags[ll])
+	|| 0 != pfolsm_fmm_create (&fm, obj)
+	|| 0 == (arrival = malloc (obj[0].ntt * sizeof(double)))) {
+      errx (EXIT_FAILURE, "failed to create LSM data structure");
+    }
+    for (jj = 1; jj <= obj[0].dimy; ++jj) {
+      for (ii = 1; ii <= obj[0].dimx; ++ii) {
+	pfolsm_set (obj, ii, jj, sqrt(pow(ii - 15.0, 2.0) + pow(jj - 12.0, 2.0)) - 6.0);
+	pfolsm_set_speed (obj, ii, jj, 0.5 + 0.01 * ii);
+      }
+    }
+    for (kk = 0; kk < 3; ++kk) {
+      pfolsm_update (obj, 0.4);
+    }
+    if (0 != pfolsm_fmm_arrival (&fm, obj, 0, 0, arrival)
+	|| 0 != pfolsm_ckpt_save (obj, path, 1 != ll ? arrival : 0)
+	|| 0 != pfolsm_ckpt_load (obj + 1, path, &loaded)) {
+      errx (EXIT_FAILURE, "checkpoint %zu failed", ll);
+    }
+    if (obj[1].time != obj[0].time || obj[1].dt != 0.4 || obj[1].flags != flags[ll]
+	|| obj[1].dimx != 37 || obj[1].dimy != 29 || obj[1].ng != obj[0].ng
+	|| (1 != ll && 0 != memcmp (loaded, arrival, obj[0].ntt * sizeof(double)))
+	|| (1 == ll && 0 != loaded)) {
+      errx (EXIT_FAILURE, "checkpoint %zu header or arrival times differ", ll);
+    }
+    
+    // the restarted run continues exactly like the original one
+    
+    for (kk = 0; kk < 3; ++kk) {
+      for (jj = 0; jj <= obj[0].dimy + 1; ++jj) {
+	for (ii = 0; ii <= obj[0].dimx + 1; ++ii) {
+	  double const p0 = pfolsm_get (obj, ii, jj);
+	  double const p1 = pfolsm_get (obj + 1, ii, jj);
+	  if (p0 != p1 && ! (isnan (p0) && isnan (p1))) {
+	    errx (EXIT_FAILURE, "checkpoint %zu: phi %g instead of %g after %zu steps",
+		  ll, p1, p0, kk);
+	  }
+	}
+      }
+      pfolsm_update (obj, 0.4);
+      pfolsm_update (obj + 1, 0.4);
+    }
+    
+    free (arrival);
+    pfolsm_fmm_destroy (&fm);
+    pfolsm_destroy (obj);
+    pfolsm_destroy (obj + 1);
+  }
+  
+  // something that is not a checkpoint
+  
+  if (0 == (fp = fopen (path, "w"))) {
+    err (EXIT_FAILURE, "%s", path);
+  }
+  for (ii = 0; ii < 10000; ++ii) {
+    fputc ('x', fp);
+  }
+  fclose (fp);
+  if (0 == pfolsm_ckpt_load (obj, path, 0)) {
+    errx (EXIT_FAILURE, "loaded a file that is not a checkpoint");
+  }
+  unlink (path);
+}
+
+static void check_dump (void)
+{
+  static double const special[] = {
+    0.0, -0.0, 0.05, 0.15, 0.25, -0.25, 0.35, 2.5, 3.5, -2.5, 0.125, 1.375,
+    9.95, 99.95, -9.96, 0.04, -0.04, 1e-7, 123456.75, 999999999.5, 1e9, -1e12,
+    1e300, INFINITY, -INFINITY, NAN, 2.999999999, -3.0000004
+  };
+  size_t const nspecial = sizeof(special) / sizeof(*special);
+  char buf[PFOLSM_FMT_MAX], ref[PFOLSM_FMT_MAX];
+  pfolsm_t obj;
+  FILE * fp;
+  char * text;
+  size_t ii, jj, len, size;
+  int prec, width;
+  
+  // the formatter against printf, including exact ties
+  
+  srand (29);
+  for (ii = 0; ii < 20000 + nspecial; ++ii) {
+    double const num = ii < nspecial ? special[ii]
+      : (rand () % 2 ? 1 : -1) * (rand () % 100000) * pow (10.0, rand () % 9 - 6) / (1 + rand () % 8);
+    for (prec = 0; prec <= 9; prec += 1 + (ii >= nspecial) * 2) {
+      for (width = 0; width <= 12; width += 6) {
+	len = _pfolsm_fmt_fixed (buf, num, width, prec, ii % 2);
+	snprintf (ref, sizeof(ref), ii % 2 ? "% *.*f" : "%*.*f", width, prec, num);
+	if (len != strlen (ref) || 0 != memcmp (buf, ref, len)) {
+	  errx (EXIT_FAILURE, "formatted %.17g as '%.*s' instead of '%s'", num, (int) len, buf, ref);
+	}
+      }
+    }
+    len = _pfolsm_fmt_num (buf, num, 5);
+    if (isinf(num)) {
+      snprintf (ref, sizeof(ref), "   inf");
+    }
+    else if (isnan(num)) {
+      snprintf (ref, sizeof(ref), "   nan");
+    }
+    else if (fabs(fmod(num, 1)) < 1e-6) {
+      snprintf (ref, sizeof(ref), " % 3d  ", (int) rint(num));
+    }
+    else {
+      snprintf (ref, sizeof(ref), " % 5.1f", num);
+    }
+    if (fabs(num) < 1e9 && (len != strlen (ref) || 0 != memcmp (buf, ref, len))) {
+      errx (EXIT_FAILURE, "dumped %.17g as '%.*s' instead of '%s'", num, (int) len, buf, ref);
+    }
+  }
+  
+  // CSV reads back to within the precision
+  
+  if (0 != pfolsm_create (&obj, 23, 17)) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  for (jj = 1; jj <= obj.dimy; ++jj) {
+    for (ii = 1; ii <= obj.dimx; ++ii) {
+      pfolsm_set (&obj, ii, jj, sqrt(pow(ii - 11.3, 2.0) + pow(jj - 8.1, 2.0)) - 5.0);
+    }
+  }
+  text = 0;
+  size = 0;
+  if (0 == (fp = open_memstream (&text, &size))
+      || 0 != pfolsm_dump_phi (&obj, fp, PFOLSM_DUMP_CSV, 4)) {
+    errx (EXIT_FAILURE, "CSV dump failed");
+  }
+  fclose (fp);
+  {
+    char * pos = text;
+    for (jj = 1; jj <= obj.dimy; ++jj) {
+      for (ii = 1; ii <= obj.dimx; ++ii) {
+	double const val = strtod (pos, &pos);
+	if (fabs (val - pfolsm_get (&obj, ii, jj)) > 0.5e-4
+	    || *pos != (ii < obj.dimx ? ',' : '\n')) {
+	  errx (EXIT_FAILURE, "CSV cell %zu %zu reads back as %g", ii, jj, val);
+	}
+	++pos;
+      }
+    }
+    if ('\0' != *pos) {
+      errx (EXIT_FAILURE, "trailing characters after CSV dump");
+    }
+  }
+  free (text);
+  pfolsm_destroy (&obj);
+}
+
+static void check_stats (void)
+{
+  struct pfolsm_stage_s st;
+  pfolsm_t dbg, par;
+  FILE * fp;
+  char * text, * pos;
+  size_t ii, jj, kk, ncell, nevent, ntrace, ndropped;
+  
+  if (0 != pfolsm_create_flags (&dbg, 37, 23, PFOLSM_DEBUG)
+      || 0 != pfolsm_create (&par, 37, 23)
+      || 0 != pfolsm_threads (&par, 3)) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  if (0 != pfolsm_stats_enable (&dbg, 0)) {
+    // built without PFOLSM_STATS, which test_stats defines
+#ifdef PFOLSM_STATS
+    errx (EXIT_FAILURE, "failed to enable statistics");
+#endif
+    if (dbg.stats || par.stats) {
+      errx (EXIT_FAILURE, "statistics without PFOLSM_STATS");
+    }
+    pfolsm_destroy (&dbg);
+    pfolsm_destroy (&par);
+    return;
+  }
+  if (0 != pfolsm_stats_enable (&par, 4)) {
+    errx (EXIT_FAILURE, "failed to enable statistics");
+  }
+  ncell = dbg.dimx * dbg.dimy;
+  for (jj = 1; jj <= dbg.dimy; ++jj) {
+    for (ii = 1; ii <= dbg.dimx; ++ii) {
+      size_t const idx = ii + jj * dbg.nx;
+      dbg.phi[idx] = par.phi[idx] = sqrt(pow(ii - 9.0, 2.0) + pow(jj - 11.0, 2.0)) - 4.5;
+      dbg.speed[idx] = par.speed[idx] = 1.0;
+    }
+  }
+  for (kk = 0; kk < 5; ++kk) {
+    pfolsm_update (&dbg, 0.2);
+    pfolsm_update (&par, 0.2);
+  }
+  
+  // every stage of the multi-pass update, once per step
+  
+  pfolsm_stats_total (&dbg, PFOLSM_STAGE_UPDATE, &st);
+  if (5 != st.ncall || 5 * ncell != st.cells || st.seconds <= 0.0) {
+    errx (EXIT_FAILURE, "counted %llu updates of %llu cells",
+	  (unsigned long long) st.ncall, (unsigned long long) st.cells);
+  }
+  for (kk = PFOLSM_STAGE_DIFF; kk <= PFOLSM_STAGE_CPHINEXT; ++kk) {
+    pfolsm_stats_total (&dbg, kk, &st);
+    if (5 != st.ncall || 5 * ncell != st.cells) {
+      errx (EXIT_FAILURE, "counted %llu %s calls", (unsigned long long) st.ncall,
+	    pfolsm_stats_name (kk));
+    }
+  }
+  pfolsm_stats_total (&dbg, PFOLSM_STAGE_FUSED, &st);
+  if (0 != st.ncall) {
+    errx (EXIT_FAILURE, "fused rows in the multi-pass update");
+  }
+  
+  // each thread does its own band, and the trace keeps what fits
+  
+  pfolsm_stats_total (&par, PFOLSM_STAGE_FUSED, &st);
+  if (15 != st.ncall || 5 * ncell != st.cells) {
+    errx (EXIT_FAILURE, "counted %llu fused calls of %llu cells",
+	  (unsigned long long) st.ncall, (unsigned long long) st.cells);
+  }
+  if (5 != par.stats->nparallel || par.stats->imbalance < 0.0
+      || par.stats->imbalance_max > 2.0 + 1e-9) {
+    errx (EXIT_FAILURE, "imbalance %g over %zu runs", par.stats->imbalance,
+	  par.stats->nparallel);
+  }
+  ntrace = ndropped = 0;
+  for (ii = 0; ii < par.stats->nthreads; ++ii) {
+    ntrace += par.stats->thread[ii].ntrace;
+    ndropped += par.stats->thread[ii].ndropped;
+  }
+  if (12 != ntrace || 23 != ndropped) {
+    errx (EXIT_FAILURE, "traced %zu and dropped %zu sections", ntrace, ndropped);
+  }
+  text = 0;
+  if (0 == (fp = open_memstream (&text, &ii))
+      || 0 != pfolsm_stats_trace (&par, fp)) {
+    errx (EXIT_FAILURE, "trace export failed");
+  }
+  fclose (fp);
+  nevent = 0;
+  for (pos = text; (pos = strstr (pos, "\"ph\": \"X\"")); ++pos) {
+    ++nevent;
+  }
+  if (0 != strncmp (text, "{\"displayTimeUnit\"", 18) || ntrace != nevent
+      || 0 != strcmp (text + strlen (text) - 4, "\n]}\n")) {
+    errx (EXIT_FAILURE, "trace holds %zu events", nevent);
+  }
+  free (text);
+  
+  // a new pool starts over, and temporal blocking counts its passes
+  
+  if (0 != pfolsm_threads (&par, 2) || 2 != par.stats->nthreads) {
+    errx (EXIT_FAILURE, "statistics did not follow the pool");
+  }
+  pfolsm_advance_n (&par, 0.2, 10);
+  pfolsm_stats_total (&par, PFOLSM_STAGE_UPDATE, &st);
+  if (2 != st.ncall || 10 * ncell != st.cells) {
+    errx (EXIT_FAILURE, "counted %llu blocked passes", (unsigned long long) st.ncall);
+  }
+  pfolsm_stats_total (&par, PFOLSM_STAGE_FUSED, &st);
+  if (4 != st.ncall || 10 * ncell != st.cells || 2 != par.stats->nparallel) {
+    errx (EXIT_FAILURE, "counted %llu blocked cells", (unsigned long long) st.cells);
+  }
+  
+  // reinitializing after every step is serial work of thread 0 that
+  // must not count as imbalance of the next parallel run
+  
+  pfolsm_destroy (&dbg);
+  if (0 != pfolsm_create (&dbg, 150, 150)
+      || 0 != pfolsm_threads (&dbg, 3)
+      || 0 != pfolsm_reinit_lazy (&dbg, 1e-12, 5.0)
+      || 0 != pfolsm_stats_enable (&dbg, 0)) {
+    errx (EXIT_FAILURE, "failed to create LSM data structure");
+  }
+  for (jj = 1; jj <= dbg.dimy; ++jj) {
+    for (ii = 1; ii <= dbg.dimx; ++ii) {
+      pfolsm_set (&dbg, ii, jj, sqrt(pow(ii - 75.0, 2.0) + pow(jj - 75.0, 2.0)) - 40.5);
+      pfolsm_set_speed (&dbg, ii, jj, 1.0);
+    }
+  }
+  for (kk = 0; kk < 10; ++kk) {
+    pfolsm_update (&dbg, 0.2);
+  }
+  pfolsm_stats_total (&dbg, PFOLSM_STAGE_REINIT, &st);
+  if (st.ncall < 9 || 10 != dbg.stats->nparallel
+      || dbg.stats->imbalance / dbg.stats->nparallel > 0.5) {
+    errx (EXIT_FAILURE, "imbalance %g over %zu runs with %llu reinitializations",
+	  dbg.stats->imbalance, dbg.stats->nparallel, (unsigned long long) st.ncall);
+  }
+  
+  pfolsm_stats_disable (&par);
+  pfolsm_destroy (&dbg);
+  pfolsm_destroy (&par);
+}
+
+
+static void check_batch (void)
+{
+  enum { NINST = 11 };
+  pfolsm_t ref[NINST], out;
+  pfolsm_batch_t batch;
+  double dt[NINST];
+  size_t ii, jj, kk, step;
+  int isa, nthreads;
+  
+  for (isa = 0; isa <= _pfolsm_isa_best (); ++isa) {
+    for (nthreads = 1; nthreads <= 3; nthreads += 2) {
+      if (0 == _pfolsm_lanes_kernel (isa)) {
+	continue;
+      }
+      if (0 != pfolsm_batch_create (&batch, 29, 19, NINST)
+	  || 0 != pfolsm_batch_threads (&batch, nthreads)
+	  || 0 != pfolsm_create (&out, 29, 19)) {
+	errx (EXIT_FAILURE, "failed to create batch");
+      }
+      batch.lanes = _pfolsm_lanes_kernel (isa);
+      
+      // every instance has its own front, speeds, and time step
+      
+      for (kk = 0; kk < NINST; ++kk) {
+	if (0 != pfolsm_create (ref + kk, 29, 19)) {
+	  errx (EXIT_FAILURE, "failed to create LSM data structure");
+	}
+	for (jj = 1; jj <= out.dimy; ++jj) {
+	  for (ii = 1; ii <= out.dimx; ++ii) {
+	    size_t const idx = ii + jj * out.nx;
+	    ref[kk].phi[idx] = sqrt(pow(ii - 3.0 - 2.0 * kk, 2.0) + pow(jj - 9.5, 2.0)) - 1.5 - 0.3 * kk;
+	    ref[kk].speed[idx] = (ii * (kk + 1) + jj) % 5 ? 1.0 + 0.1 * kk : -0.5;
+	  }
+	}
+	if (0 != pfolsm_batch_load (&batch, kk, ref + kk)) {
+	  errx (EXIT_FAILURE, "failed to load instance %zu", kk);
+	}
+	dt[kk] = 0.05 + 0.02 * kk;
+      }
+      if (0 == pfolsm_batch_load (&batch, NINST, ref)) {
+	errx (EXIT_FAILURE, "loaded an instance past the end");
+      }
+      
+      for (step = 0; step < 17; ++step) {
+	pfolsm_batch_update (&batch, dt);
+	for (kk = 0; kk < NINST; ++kk) {
+	  pfolsm_update (ref + kk, dt[kk]);
+	}
+      }
+      
+      for (kk = 0; kk < NINST; ++kk) {
+	pfolsm_batch_store (&batch, kk, &out);
+	for (jj = 1; jj <= out.dimy; ++jj) {
+	  size_t const off = 1 + jj * out.nx;
+	  if (0 != memcmp (ref[kk].phi + off, out.phi + off, out.dimx * sizeof(double))) {
+	    errx (EXIT_FAILURE, "batch instance %zu differs in row %zu (isa %d, %d threads)",
+		  kk, jj, isa, nthreads);
+	  }
+	}
+	if (pfolsm_batch_get (&batch, kk, 5, 7) != pfolsm_get (ref + kk, 5, 7)) {
+	  errx (EXIT_FAILURE, "batch get differs");
+	}
+	pfolsm_destroy (ref + kk);
+      }
+      for (jj = 0; jj < batch.ntt; ++jj) {
+	for (kk = NINST; kk < batch.nlane; ++kk) {
+	  if (0.0 != batch.phi[jj * batch.nlane + kk]) {
+	    errx (EXIT_FAILURE, "padding lane %zu changed", kk);
+	  }
+	}
+      }
+      pfolsm_destroy (&out);
+      pfolsm_batch_destroy (&batch);
+    }
+  }
+}
+
+
+struct uneven_s {
+  size_t * count;		/* runs of each job */
+};
+
+
+static double uneven_job (void * arg, size_t ijob, size_t iw)
+{
+  struct uneven_s const * un = arg;
+  double acc = 0.0;
+  size_t ii;
+  
+  // the last jobs cost a lot more than the first
+  
+  for (ii = 0; ii < ijob * ijob / 512; ++ii) {
+    acc += 1e-9 * sin (ii);
+  }
+  __atomic_fetch_add (un->count + ijob, 1, __ATOMIC_RELAXED);
+  return 1.0 / (ijob + 3.0) + acc;
+}
+
+
+static void check_sched (void)
+{
+  enum { NJOB = 701, NINST = 7 };
+  static size_t count[NJOB];
+  struct uneven_s un;
+  pfolsm_sched_t ps;
+  pfolsm_t ref[NINST], par[NINST];
+  pfolsm_t * inst[NINST];
+  pfolsm_tiled_t serial, tiled;
+  double sum, first = 0.0;
+  size_t ii, jj, kk, nthreads;
+  unsigned flags;
+  
+  // every job runs exactly once, and the deterministic sum does not
+  // depend on the number of threads
+  
+  un.count = count;
+  for (flags = 0; flags <= PFOLSM_SCHED_DETERMINISTIC; ++flags) {
+    for (nthreads = 1; nthreads <= 4; ++nthreads) {
+      memset (count, 0, sizeof(count));
+      if (0 != pfolsm_sched_create (&ps, nthreads, flags)
+	  || 0 != pfolsm_sched_run (&ps, NJOB, uneven_job, &un, &sum)) {
+	errx (EXIT_FAILURE, "failed to run %zu-thread scheduler", nthreads);
+      }
+      if (0 != (uintptr_t) ps.deque % PFOLSM_ALIGN
+	  || PFOLSM_ALIGN != sizeof(struct pfolsm_deque_s)) {
+	errx (EXIT_FAILURE, "deques do not have cache lines of their own");
+      }
+      for (ii = 0; ii < NJOB; ++ii) {
+	if (1 != count[ii]) {
+	  errx (EXIT_FAILURE, "job %zu ran %zu times", ii, count[ii]);
+	}
+      }
+      if (1 == nthreads) {
+	first = sum;
+      }
+      else if (flags ? sum != first : fabs (sum - first) > 1e-12) {
+	errx (EXIT_FAILURE, "%zu-thread sum %.17g instead of %.17g", nthreads, sum, first);
+      }
+      if (0 != pfolsm_sched_run (&ps, 0, uneven_job, &un, &sum) || 0.0 != sum) {
+	errx (EXIT_FAILURE, "empty run summed to %g", sum);
+      }
+      pfolsm_sched_destroy (&ps);
+    }
+  }
+  
+  // whole runs of an ensemble, with fronts that stall early or late
+  
+  if (0 != pfolsm_sched_create (&ps, 3, PFOLSM_SCHED_DETERMINISTIC)) {
+    errx (EXIT_FAILURE, "failed to create scheduler");
+  }
+  for (kk = 0; kk < NINST; ++kk) {
+    if (0 != pfolsm_create (ref + kk, 20 + 9 * kk, 31)
+	|| 0 != pfolsm_create (par + kk, 20 + 9 * kk, 31)) {
+      errx (EXIT_FAILURE, "failed to create LSM data structure");
+    }
+    for (jj = 1; jj <= ref[kk].dimy; ++jj) {
+      for (ii = 1; ii <= ref[kk].dimx; ++ii) {
+	size_t const idx = ii + jj * ref[kk].nx;
+	ref[kk].phi[idx] = par[kk].phi[idx] = sqrt(pow(ii - 4.0, 2.0) + pow(jj - 15.0, 2.0)) - 2.0;
+	ref[kk].speed[idx] = par[kk].speed[idx] = ii < 6 + 3 * kk ? 1.0 : 0.0;
+      }
+    }
+    pfolsm_advance_n (ref + kk, 0.3, 25);
+    inst[kk] = par + kk;
+  }
+  if (0 != pfolsm_sched_advance (&ps, inst, NINST, 0.3, 25)) {
+    errx (EXIT_FAILURE, "scheduled ensemble failed");
+  }
+  for (kk = 0; kk < NINST; ++kk) {
+    if (0 != memcmp (ref[kk].phi, par[kk].phi, ref[kk].ntt * sizeof(double))
+	|| par[kk].time != ref[kk].time) {
+      errx (EXIT_FAILURE, "scheduled instance %zu differs", kk);
+    }
+    pfolsm_destroy (ref + kk);
+    pfolsm_destroy (par + kk);
+  }
+  
+  // tiles as jobs give the same sparse level set as the serial loop
+  
+  if (0 != pfolsm_tiled_create (&serial, 300, 170, 6.0)
+      || 0 != pfolsm_tiled_create (&tiled, 300, 170, 6.0)) {
+    errx (EXIT_FAILURE, "failed to create tiled LSM");
+  }
+  pfolsm_tiled_sched (&tiled, &ps);
+  for (jj = 1; jj <= serial.dimy; ++jj) {
+    for (ii = 1; ii <= serial.dimx; ++ii) {
+      double const phi = fmin (sqrt(pow(ii - 50.0, 2.0) + pow(jj - 80.0, 2.0)) - 7.0,
+			       sqrt(pow(ii - 220.0, 2.0) + pow(jj - 40.0, 2.0)) - 3.0);
+      if (0 != pfolsm_tiled_set (&serial, ii, jj, phi)
+	  || 0 != pfolsm_tiled_set (&tiled, ii, jj, phi)) {
+	errx (EXIT_FAILURE, "failed to set tiled phi");
+      }
+    }
+  }
+  pfolsm_tiled_gc (&serial);
+  pfolsm_tiled_gc (&tiled);
+  for (kk = 0; kk < 60; ++kk) {
+    if (0 != pfolsm_tiled_update (&serial, 0.5)
+	|| 0 != pfolsm_tiled_update (&tiled, 0.5)) {
+      errx (EXIT_FAILURE, "failed to update tiled LSM");
+    }
+  }
+  if (serial.nlive != tiled.nlive) {
+    errx (EXIT_FAILURE, "%zu scheduled tiles live instead of %zu", tiled.nlive, serial.nlive);
+  }
+  for (jj = 1; jj <= serial.dimy; ++jj) {
+    for (ii = 1; ii <= serial.dimx; ++ii) {
+      if (pfolsm_tiled_get (&serial, ii, jj) != pfolsm_tiled_get (&tiled, ii, jj)) {
+	errx (EXIT_FAILURE, "scheduled tiles differ at %zu %zu", ii, jj);
+      }
+    }
+  }
+  pfolsm_tiled_destroy (&serial);
+  pfolsm_tiled_destroy (&tiled);
+  pfolsm_sched_destroy (&ps);
+}
+
+
+#ifdef PFOLSM_MPI
+
+
+/**
+   Decomposed runs against a dense grid of the global size, which
+   every rank computes on its own. Run with mpirun -np N for any N
+   that leaves each block at least 4 cells per side.
+*/
+static void check_mpi (void)
+{
+  size_t const gdimx = 41, gdimy = 29;
+  pfolsm_mpi_t pm;
+  pfolsm_t ref;
+  double * global;
+  double dt, dtref;
+  size_t depth, ii, jj, kk;
+  
+  global = malloc (gdimx * gdimy * sizeof(double));
+  if (0 == global) {
+    errx (EXIT_FAILURE, "out of memory");
+  }
+  
+  for (depth = 1; depth <= 3; ++depth) {
+    if (0 != pfolsm_mpi_create (&pm, MPI_COMM_WORLD, gdimx, gdimy, depth)
+	|| 0 != pfolsm_create (&ref, gdimx, gdimy)) {
+      errx (EXIT_FAILURE, "failed to create decomposed LSM with depth %zu", depth);
+    }
+    for (jj = 1; jj <= gdimy; ++jj) {
+      for (ii = 1; ii <= gdimx; ++ii) {
+	double const phi = sqrt(pow(ii - 12.0, 2.0) + pow(jj - 19.0, 2.0)) - 7.5;
+	double const speed = (ii * 3 + jj) % 11 ? 1.0 + 0.01 * ii : -0.5;
+	size_t const idx = ii + jj * ref.nx;
+	ref.phi[idx] = phi;
+	ref.speed[idx] = speed;
+	if ((0 == pfolsm_mpi_set (&pm, ii, jj, phi, speed)) != pfolsm_mpi_owns (&pm, ii, jj)) {
+	  errx (EXIT_FAILURE, "rank %d ownership of %zu %zu", pm.rank, ii, jj);
+	}
+      }
+    }
+    
+    // fixed steps with a tail shorter than the halo, then CFL steps
+    
+    if (0 != pfolsm_mpi_advance (&pm, 0.2, 11)) {
+      errx (EXIT_FAILURE, "decomposed advance failed");
+    }
+    for (kk = 0; kk < 11; ++kk) {
+      pfolsm_update (&ref, 0.2);
+    }
+    for (kk = 0; kk < 3; ++kk) {
+      if (0 != pfolsm_mpi_update_cfl (&pm, 0.4, &dt)
+	  || 0 != pfolsm_update_cfl (&ref, 0.4, &dtref) || dt != dtref) {
+	errx (EXIT_FAILURE, "rank %d CFL step %.17g instead of %.17g", pm.rank, dt, dtref);
+      }
+    }
+    
+    if (0 != pfolsm_mpi_gather (&pm, global, 0)) {
+      errx (EXIT_FAILURE, "gather failed");
+    }
+    if (0 == pm.rank) {
+      for (jj = 1; jj <= gdimy; ++jj) {
+	for (ii = 1; ii <= gdimx; ++ii) {
+	  if (global[ii - 1 + (jj - 1) * gdimx] != ref.phi[ii + jj * ref.nx]) {
+	    errx (EXIT_FAILURE, "%d ranks with depth %zu differ from dense at %zu %zu",
+		  pm.nrank, depth, ii, jj);
+	  }
+	}
+      }
+    }
+    if (pm.local.time != ref.time) {
+      errx (EXIT_FAILURE, "rank %d time %g instead of %g", pm.rank, pm.local.time, ref.time);
+    }
+    pfolsm_mpi_destroy (&pm);
+    pfolsm_destroy (&ref);
+  }
+  
+  // blocks too narrow for the halo fail everywhere
+  
+  if (0 == pfolsm_mpi_create (&pm, MPI_COMM_WORLD, 2, 2, 4)) {
+    errx (EXIT_FAILURE, "created blocks narrower than the halo");
+  }
+  free (global);
+}
+
+
+#endif // PFOLSM_MPI
+
+
+static void check_layout (void)
+{
+  static unsigned const flags[] = {
+    0, PFOLSM_FLOAT, PFOLSM_MIXED, PFOLSM_WENO, PFOLSM_DEBUG, PFOLSM_HUGETLB
+  };
+  static size_t const dims[] = { 5, 60, 62, 126, 510, 700 };
+  pfolsm_t obj;
+  size_t ff, dd, ng, jj;
+  
+  for (ff = 0; ff < sizeof(flags) / sizeof(*flags); ++ff) {
+    for (dd = 0; dd < sizeof(dims) / sizeof(*dims); ++dd) {
+      for (ng = (flags[ff] & PFOLSM_WENO) ? 3 : 1; ng <= 3; ++ng) {
+	size_t const elsize = (flags[ff] & (PFOLSM_FLOAT | PFOLSM_MIXED)) ? sizeof(float) : sizeof(double);
+	if (0 != pfolsm_create_ng (&obj, dims[dd], dims[(dd + 1) % 6], flags[ff], ng)) {
+	  errx (EXIT_FAILURE, "failed to create LSM data structure");
+	}
+	
+	// padded rows and planes that do not alias in the cache
+	
+	if (obj.nx < obj.dimx + 2 * ng || obj.ny < obj.dimy + 2 * ng
+	    || 0 != obj.nx * elsize % PFOLSM_ALIGN || 0 == obj.nx * elsize % 512
+	    || 0 == obj.ntt * elsize % 4096 || obj.ntt != obj.nx * obj.ny) {
+	  errx (EXIT_FAILURE, "%zux%zu grid padded to %zux%zu", obj.dimx, obj.dimy, obj.nx, obj.ny);
+	}
+	
+	// the first interior cell of every row is aligned
+	
+	for (jj = 1; jj <= obj.dimy; ++jj) {
+	  size_t const off = 1 + jj * obj.nx;
+	  uintptr_t const addr = obj.fdata
+	    ? (uintptr_t) (obj.fphi + off) | (uintptr_t) (obj.fspeed + off)
+	    : (uintptr_t) (obj.phi + off) | (uintptr_t) (obj.speed + off)
+	    | (uintptr_t) (obj.phinext + off);
+	  if (0 != addr % PFOLSM_ALIGN) {
+	    errx (EXIT_FAILURE, "row %zu of flags 0x%x with %zu ghost layers is not aligned",
+		  jj, flags[ff], ng);
+	  }
+	}
+	
+	// large grids and explicit huge pages get mapped
+	
+	if ((obj.ntt * elsize * 3 >= PFOLSM_HUGE_PAGE || (flags[ff] & PFOLSM_HUGETLB))
+	    && (0 == obj.mapbase || 0 != obj.maplen % PFOLSM_HUGE_PAGE)) {
+	  errx (EXIT_FAILURE, "%zux%zu grid is not on huge pages", obj.dimx, obj.dimy);
+	}
+	pfolsm_set (&obj, 2, 2, -1.0);
+	pfolsm_update (&obj, 0.1);
+	pfolsm_destroy (&obj);
+      }
+    }
+  }
+}
+
+
+static void check_row_kernels (void)
+{
+  static size_t const nn = 67, stride = 70;
+  double phi[3 * 70], speed[3 * 70], ref[70], out[70];
+  float fphi[3 * 70], fspeed[3 * 70], fref[70], fout[70];
+  int isa;
+  size_t ii;
+  
+  srand (42);
+  for (ii = 0; ii < 3 * stride; ++ii) {
+    // integers give plenty of ties and exact zero differences
+    phi[ii] = (rand () % 4) ? (rand () % 2001 - 1000) * 1e-3 : rand () % 3;
+    speed[ii] = ((rand () % 5) - 2) * 0.75;
+    fphi[ii] = phi[ii];
+    fspeed[ii] = speed[ii];
+  }
+  _pfolsm_row_scalar (phi + stride + 1, speed + stride + 1, ref, nn, stride, 0.3);
+  
+  for (isa = PFOLSM_ISA_SCALAR + 1; isa < PFOLSM_NISA; ++isa) {
+    pfolsm_row_t const row = _pfolsm_row_kernel (isa);
+    if ( ! row) {
+      printf ("row kernel ISA %d not available\n", isa);
+      continue;
+    }
+    for (ii = 0; ii <= nn; ++ii) {
+      memset (out, 0, sizeof(out));
+      row (phi + stride + 1, speed + stride + 1, out, ii, stride, 0.3);
+      if (0 != memcmp (ref, out, ii * sizeof(double))) {
+	errx (EXIT_FAILURE, "row kernel ISA %d differs from scalar for %zu cells", isa, ii);
+      }
+    }
+  }
+  
+  for (ii = 0; ii <= nn; ++ii) {
+    if (_pfolsm_rate_scalar (phi + stride + 1, speed + stride + 1, ii, stride)
+	!= _pfolsm_rate_kernel (PFOLSM_NISA) (phi + stride + 1, speed + stride + 1, ii, stride)) {
+      errx (EXIT_FAILURE, "rate kernel differs from scalar for %zu cells", ii);
+    }
+  }
+  
+  _pfolsm_rowf_scalar (fphi + stride + 1, fspeed + stride + 1, fref, nn, stride, 0.3);
+  for (isa = PFOLSM_ISA_SCALAR + 1; isa < PFOLSM_NISA; ++isa) {
+    pfolsm_rowf_t const row = _pfolsm_rowf_kernel (isa);
+    if ( ! row) {
+      continue;
+    }
+    for (ii = 0; ii <= nn; ++ii) {
+      memset (fout, 0, sizeof(fout));
+      row (fphi + stride + 1, fspeed + stride + 1, fout, ii, stride, 0.3);
+      if (0 != memcmp (fref, fout, ii * sizeof(float))) {
+	errx (EXIT_FAILURE, "float row kernel ISA %d differs from scalar for %zu cells", isa, ii);
+      }
+    }
+  }
+  
+  _pfolsm_rowm_scalar (fphi + stride + 1, fspeed + stride + 1, fref, nn, stride, 0.3);
+  _pfolsm_rowm_kernel (PFOLSM_NISA) (fphi + stride + 1, fspeed + stride + 1, fout, nn, stride, 0.3);
+  if (0 != memcmp (fref, fout, nn * sizeof(float))) {
+    errx (EXIT_FAILURE, "mixed row kernel differs from scalar");
+  }
+}
+
+
 int main(int argc, char ** argv)
 {
   size_t ii;
   
   pfolsm_t obj;
-  if (0 != pfolsm_create (&obj, 12, 12)) {
+  
+#ifdef PFOLSM_MPI
+  MPI_Init (&argc, &argv);
+  check_mpi ();
+  MPI_Finalize ();
+  return 0;
+#endif
+  
+  check_fused ();
+  check_row_kernels ();
+  check_threads ();
+  check_nband ();
+  check_tiled ();
+  check_precision ();
+  check_advance_n ();
+  check_speed_fn ();
+  check_update_cfl ();
+  check_fmm ();
+  check_sweep ();
+  check_reinit_lazy ();
+  check_weno ();
+  check_profile ();
+  check_wulff ();
+  check_oum ();
+  check_contour ();
+  check_ckpt ();
+  check_dump ();
+  check_stats ();
+  check_batch ();
+  check_sched ();
+  check_layout ();
+  
+  if (0 != pfolsm_create_flags (&obj, 12, 12, PFOLSM_DEBUG)) {
     errx (EXIT_FAILURE, "failed to create LSM data structure");
   }
   init (&obj);
   _pfolsm_diff (&obj);
   _pfolsm_nabla (&obj);
   pfolsm_dump (&obj, stdout);
-  pfolsm_destroy (&obj);
   
   printf ("**************************************************\n");
   for (ii = 0; ii < 200; ++ii) {
@@ -78,5 +1843,7 @@ int main(int argc, char ** argv)
     printf ("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
   }
   
+  pfolsm_destroy (&obj);
+  
   return 0;
 }